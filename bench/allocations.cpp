@@ -0,0 +1,48 @@
+#include "allocations.h"
+#include <stdlib.h>
+
+namespace {
+/// Allocations made so far, updated atomically.
+quint64 volatile allocations = 0;
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_malloc(size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *calloc(size_t count, size_t size)
+{
+    __sync_fetch_and_add(&allocations, 1);
+    return __libc_calloc(count, size);
+}
+
+void *malloc(size_t size)
+{
+    __sync_fetch_and_add(&allocations, 1);
+    return __libc_malloc(size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    __sync_fetch_and_add(&allocations, 1);
+    return __libc_realloc(pointer, size);
+}
+}
+
+bool Allocations::available()
+{
+    return true;
+}
+#else
+bool Allocations::available()
+{
+    return false;
+}
+#endif
+
+quint64 Allocations::count()
+{
+    return allocations;
+}
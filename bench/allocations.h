@@ -0,0 +1,19 @@
+#pragma once
+#include <QtGlobal>
+
+/// Process-wide count of heap allocations.
+///
+/// Where the C library allows it (glibc) malloc, calloc and realloc are
+/// interposed for the whole process, Qt included, and every call is counted.
+/// Elsewhere nothing is counted and available() is false.
+class Allocations
+{
+public:
+    /// Whether allocations are being counted.
+    /// @return false if count() will always be 0.
+    static bool available();
+
+    /// Number of allocations made so far.
+    /// @return allocations since the process started.
+    static quint64 count();
+};
@@ -0,0 +1,28 @@
+TEMPLATE = app
+TARGET = benchmarks
+DESTDIR = ../bin/
+CONFIG += console release
+CONFIG -= app_bundle
+
+include(../com/com.pri)
+
+SOURCES += main.cpp \
+    allocations.cpp \
+    benchmark.cpp \
+    ../gui/framecache.cpp \
+    ../gui/messagemodel.cpp \
+    ../gui/monitorwidget.cpp
+
+HEADERS += \
+    allocations.h \
+    benchmark.h \
+    ../gui/framecache.h \
+    ../gui/messagemodel.h \
+    ../gui/monitorwidget.h
+
+# The emulated vehicle answers the connection benchmark over a
+# pseudo-terminal.
+unix:SOURCES += ../emulator/vehicleemulator.cpp
+unix:HEADERS += ../emulator/vehicleemulator.h
+
+QMAKE_CXXFLAGS += -pedantic -Werror -Wextra -Wno-long-long
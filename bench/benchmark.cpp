@@ -0,0 +1,179 @@
+#include "benchmark.h"
+#include "allocations.h"
+#include <stdio.h>
+#include <time.h>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+
+#ifndef __GNUC__
+void const *volatile Benchmark::sink = 0;
+#endif
+
+namespace {
+/// Measured result of one benchmark.
+struct Result
+{
+    double allocations;   ///< Heap allocations per iteration.
+    quint64 bytes;        ///< Bytes per iteration.
+    double cpuNs;         ///< CPU time per iteration.
+    quint64 items;        ///< Items per iteration.
+    quint64 iterations;   ///< Iterations timed.
+    QString name;         ///< Benchmark name.
+    double realNs;        ///< Wall-clock time per iteration.
+};
+
+/// CPU time consumed by the process.
+/// @return nanoseconds, or 0 where unavailable.
+qint64 cpuTime()
+{
+#ifdef CLOCK_PROCESS_CPUTIME_ID
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (qint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return (qint64)clock() * (1000000000 / CLOCKS_PER_SEC);
+#endif
+}
+
+/// Get the value of a --name=value option.
+QString option(QStringList const &arguments, QString const &name,
+               QString const &fallback = QString())
+{
+    foreach (QString argument, arguments)
+        if (argument.startsWith("--" + name + "="))
+            return argument.mid(name.length() + 3);
+    return fallback;
+}
+
+/// Escape a string for a JSON string literal.
+QByteArray quoted(QString const &text)
+{
+    QByteArray bytes = text.toUtf8();
+    QByteArray result("\"");
+    for (int i = 0; i < bytes.length(); i++) {
+        if (bytes[i] == '"' || bytes[i] == '\\')
+            result += '\\';
+        result += bytes[i];
+    }
+    return result + "\"";
+}
+
+/// Format results as Google Benchmark JSON.
+QByteArray json(QList<Result> const &results, QString const &executable)
+{
+    QByteArray out("{\n  \"context\": {\n");
+    out += "    \"date\": " + quoted(QDateTime::currentDateTime()
+                                     .toString(Qt::ISODate)) + ",\n";
+    out += "    \"executable\": " + quoted(executable) + ",\n";
+    out += "    \"num_cpus\": " +
+            QByteArray::number(QThread::idealThreadCount()) + ",\n";
+#ifdef QT_NO_DEBUG
+    out += "    \"library_build_type\": \"release\"\n  },\n";
+#else
+    out += "    \"library_build_type\": \"debug\"\n  },\n";
+#endif
+    out += "  \"benchmarks\": [\n";
+    for (int i = 0; i < results.length(); i++) {
+        Result const &r = results[i];
+        out += "    {\n";
+        out += "      \"name\": " + quoted(r.name) + ",\n";
+        out += "      \"run_name\": " + quoted(r.name) + ",\n";
+        out += "      \"run_type\": \"iteration\",\n";
+        out += "      \"iterations\": " + QByteArray::number(r.iterations)
+                + ",\n";
+        out += "      \"real_time\": " + QByteArray::number(r.realNs, 'f', 3)
+                + ",\n";
+        out += "      \"cpu_time\": " + QByteArray::number(r.cpuNs, 'f', 3)
+                + ",\n";
+        out += "      \"time_unit\": \"ns\"";
+        if (Allocations::available())
+            out += ",\n      \"allocs_per_iter\": " + QByteArray::number(
+                        r.allocations, 'f', 3);
+        if (r.bytes)
+            out += ",\n      \"bytes_per_second\": " + QByteArray::number(
+                        r.bytes * 1e9 / r.realNs, 'f', 0);
+        if (r.items)
+            out += ",\n      \"items_per_second\": " + QByteArray::number(
+                        r.items * 1e9 / r.realNs, 'f', 0);
+        out += i + 1 < results.length()? "\n    },\n" : "\n    }\n";
+    }
+    out += "  ]\n}\n";
+    return out;
+}
+}
+
+void Benchmark::add(QString const &name, Function function)
+{
+    Entry entry;
+    entry.function = function;
+    entry.name = name;
+    entries().append(entry);
+}
+
+QList<Benchmark::Entry> &Benchmark::entries()
+{
+    static QList<Entry> list;
+    return list;
+}
+
+int Benchmark::run(QStringList const &arguments)
+{
+    QString filter = option(arguments, "benchmark_filter");
+    double minTime = option(arguments, "benchmark_min_time", "0.5")
+            .toDouble();
+    QString outName = option(arguments, "benchmark_out");
+
+    QList<Result> results;
+    printf("%-44s %14s %14s %12s %8s\n", "Benchmark", "Time (ns)",
+           "CPU (ns)", "Iterations", Allocations::available()? "Allocs" : "");
+    foreach (Entry entry, entries()) {
+        if (!filter.isEmpty() && !entry.name.contains(filter))
+            continue;
+        quint64 iterations = 1;
+        for (;;) {
+            State state(iterations);
+            QElapsedTimer timer;
+            quint64 allocStart = Allocations::count();
+            qint64 cpuStart = cpuTime();
+            timer.start();
+            entry.function(state);
+            qint64 realNs = timer.nsecsElapsed();
+            qint64 cpuNs = cpuTime() - cpuStart;
+            quint64 allocs = Allocations::count() - allocStart;
+            if (realNs >= minTime * 1e9 || iterations >= (1ULL << 40)) {
+                Result result;
+                result.allocations = (double)allocs / iterations;
+                result.bytes = state.bytes;
+                result.cpuNs = (double)cpuNs / iterations;
+                result.items = state.items;
+                result.iterations = iterations;
+                result.name = entry.name;
+                result.realNs = (double)realNs / iterations;
+                results.append(result);
+                printf("%-44s %14.1f %14.1f %12llu", entry.name.toLocal8Bit()
+                       .constData(), result.realNs, result.cpuNs,
+                       (unsigned long long)iterations);
+                if (Allocations::available())
+                    printf(" %8.2f", result.allocations);
+                printf("\n");
+                break;
+            }
+            // Aim for 1.4x the minimum time, growing at most tenfold.
+            double scale = realNs > 0? minTime * 1.4e9 / realNs : 10;
+            iterations = (quint64)(iterations * qBound(2.0, scale, 10.0));
+        }
+    }
+
+    if (!outName.isEmpty()) {
+        QFile file(outName);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+                file.write(json(results, arguments.value(0))) < 0) {
+            fprintf(stderr, "Could not write %s\n",
+                    outName.toLocal8Bit().constData());
+            return 1;
+        }
+    }
+    return 0;
+}
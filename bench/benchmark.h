@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+#include <QList>
+#include <QStringList>
+
+/// Minimal micro-benchmark harness.
+///
+/// Each benchmark is a function running its body once per State::next().
+/// The harness grows the iteration count until a run lasts at least the
+/// minimum time, then reports the mean wall-clock and CPU time per
+/// iteration, and the heap allocations per iteration where these can be
+/// counted (see Allocations). Results are printed as a table and can be
+/// written as JSON in the layout used by Google Benchmark
+/// (--benchmark_out=file), so existing comparison tooling can be pointed at
+/// successive runs.<BR>
+/// Recognised options: --benchmark_filter=substring,
+/// --benchmark_min_time=seconds, --benchmark_out=file.
+class Benchmark
+{
+public:
+    /// Iteration state handed to each benchmark function.
+    class State
+    {
+    public:
+        /// Constructor.
+        /// @param iterations number of times next() returns true.
+        explicit State(quint64 iterations) :
+            bytes(0), items(0), iterations(iterations), remaining(iterations)
+        {}
+
+        /// Advance to the next iteration.
+        /// @return false once all iterations have run.
+        bool next() { return remaining-- > 0; }
+
+        /// Report bytes handled by each iteration, for a throughput column.
+        void setBytesPerIteration(quint64 count) { bytes = count; }
+
+        /// Report items handled by each iteration, for a rate column.
+        void setItemsPerIteration(quint64 count) { items = count; }
+
+        /// Bytes per iteration, 0 if not reported.
+        quint64 bytes;
+
+        /// Items per iteration, 0 if not reported.
+        quint64 items;
+
+        /// Total iterations of this run.
+        quint64 iterations;
+
+    private:
+        /// Iterations left.
+        quint64 remaining;
+    };
+
+    /// Benchmark body.
+    typedef void (*Function)(State &state);
+
+    /// Register a benchmark.
+    /// @param name unique name, by convention "Subject/variant/size".
+    /// @param function body.
+    static void add(QString const &name, Function function);
+
+    /// Run all benchmarks selected by the command line.
+    /// @return process exit status.
+    static int run(QStringList const &arguments);
+
+    /// Keep the compiler from discarding a computed value.
+    template <typename T>
+    static void keep(T const &value)
+    {
+#ifdef __GNUC__
+        __asm__ __volatile__("" : : "g"(&value) : "memory");
+#else
+        sink = (void const *)&value;
+#endif
+    }
+
+private:
+    /// One registered benchmark.
+    struct Entry
+    {
+        Function function;
+        QString name;
+    };
+
+    /// Registered benchmarks in registration order.
+    static QList<Entry> &entries();
+
+#ifndef __GNUC__
+    /// Escape hatch for keep() where inline assembly is unavailable.
+    static void const *volatile sink;
+#endif
+};
@@ -0,0 +1,1041 @@
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QIODevice>
+#include <QThread>
+#include <QTimer>
+#include <QtEndian>
+#include "allocations.h"
+#include "benchmark.h"
+#include "com/controlpacket.h"
+#include "com/controlscheduler.h"
+#include "com/crc16.h"
+#include "com/hexformat.h"
+#include "com/messagehistory.h"
+#include "com/remotecontroller.h"
+#include "com/spscqueue.h"
+#include "com/tea.h"
+#include "com/telemetry.h"
+#include "com/trafficlog.h"
+#include "com/txqueue.h"
+#include "com/vehicle.h"
+#include "gui/framecache.h"
+#include "gui/messagemodel.h"
+#include "gui/monitorwidget.h"
+#ifdef Q_OS_UNIX
+#include "emulator/vehicleemulator.h"
+#endif
+
+namespace {
+/// MAC of the vehicle in all XBee fixtures.
+uint64_t const vehicleMac = 0x0013A20040A1B2C3ULL;
+
+/// Write-only device which discards everything.
+class NullDevice : public QIODevice
+{
+public:
+    NullDevice() { open(QIODevice::WriteOnly); }
+
+protected:
+    qint64 readData(char * /*data*/, qint64 /*maxlen*/) { return 0; }
+    qint64 writeData(const char * /*data*/, qint64 len) { return len; }
+};
+
+/// Vehicle connected to a NullDevice, exposing the internals benchmarked.
+class BenchVehicle : public Vehicle
+{
+public:
+    /// Constructor.
+    /// @param zigbee true for an XBee link, false for a wired one.
+    /// @param gather true to have frames gathered as for a serial port.
+    explicit BenchVehicle(bool zigbee, bool gather = false)
+    {
+        // Wired controls are only sent in bypass-mode.
+        bypassMode = !zigbee;
+        this->zigbee = zigbee;
+        remoteMac = vehicleMac;
+        serialPort = &sink;
+        txQueue->setDevice(&sink, 0, gather);
+        state = CONNECTED;
+        streamingTelemetry = true;
+    }
+
+    ~BenchVehicle()
+    {
+        // Not to be deleted by close().
+        serialPort = 0;
+        txQueue->setDevice(0, 0);
+    }
+
+    using Vehicle::buffer;
+    using Vehicle::controlScheduler;
+    using Vehicle::parseConfigMessage;
+    using Vehicle::scanBuffer;
+    using Vehicle::sendControl;
+    using Vehicle::sendMessage;
+
+    /// Receives all output.
+    NullDevice sink;
+};
+
+/// Vehicle running the real connection procedure, telling when it is done.
+class HandshakeVehicle : public Vehicle
+{
+public:
+    /// Check whether controls can be sent.
+    /// @return true once connected with the throttle mode known.
+    bool ready() const { return state == CONNECTED && throttleMode >= 0; }
+};
+
+/// Exposes MonitorWidget::convertToHex().
+class BenchMonitor : public MonitorWidget
+{
+public:
+    using MonitorWidget::convertToHex;
+};
+
+/// Exposes RemoteController::parseDatagram().
+class BenchRemote : public RemoteController
+{
+public:
+    using RemoteController::parseDatagram;
+};
+
+/// Build a config message as a vehicle would send it.
+/// @param body bytes from offset 5 onwards.
+QByteArray configMessage(uint8_t type, uint8_t subType,
+                         QByteArray const &body)
+{
+    uint16_t length = body.length() + 1;
+    length = ((length % 8) == 0)? length : ((length >> 3) + 1) << 3;
+    QByteArray message(length + 6, 0);
+    unsigned char *bytes = (unsigned char *)message.data();
+    bytes[0] = 0xFF;
+    bytes[1] = type;
+    qToBigEndian<uint16_t>(length, bytes + 2);
+    bytes[4] = subType;
+    memcpy(bytes + 5, body.constData(), body.length());
+    qToLittleEndian(Vehicle::crc(bytes + 1, length + 3), bytes + length + 4);
+    if (type != 6)
+        Vehicle::encrypt(bytes, bytes, teaKey, 4, length);
+    return message;
+}
+
+/// Deterministic filler bytes.
+QByteArray pattern(int length)
+{
+    QByteArray bytes(length, 0);
+    uint32_t x = 0x2545F491;
+    for (int i = 0; i < length; i++) {
+        x = x * 1103515245 + 12345;
+        bytes[i] = x >> 24;
+    }
+    return bytes;
+}
+
+/// EEPROM throttle-mode response.
+QByteArray eeprom16()
+{
+    return configMessage(2, 16, QByteArray(1, 1));
+}
+
+/// Bypass-mode IMU message.
+QByteArray imu()
+{
+    return configMessage(6, 0, pattern(12));
+}
+
+/// Telemetry #22 message with plausible contents.
+QByteArray telemetry22()
+{
+    unsigned char message[6 + Telemetry1Frame::Length] = { 0 };
+    Telemetry1Frame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.roll = 12.3f;
+    frame.pitch = -4.5f;
+    frame.yaw = 90;
+    frame.altPre = 25.5f;
+    frame.battHeli = 14.8f;
+    frame.svs = 9;
+    frame.encode(message);
+    return configMessage(1, 22, QByteArray((char const *)message + 5,
+                                           Telemetry1Frame::Length - 1));
+}
+
+/// Telemetry #23 message with plausible contents.
+QByteArray telemetry23()
+{
+    unsigned char message[6 + Telemetry2Frame::Length] = { 0 };
+    Telemetry2Frame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.lat = 52.13;
+    frame.lng = -106.63;
+    frame.pdop = 1.2f;
+    frame.temperature = 21.5f;
+    frame.encode(message);
+    return configMessage(1, 23, QByteArray((char const *)message + 5,
+                                           Telemetry2Frame::Length - 1));
+}
+
+/// Wrap a config message in an XBee receive frame from the vehicle.
+QByteArray xbeeReceive(QByteArray const &message)
+{
+    QByteArray frame(14, 0);
+    frame[0] = 0x7E;
+    qToBigEndian<uint16_t>(message.length() + 11, (uchar *)frame.data() + 1);
+    frame[3] = (char)0x80;
+    qToBigEndian<quint64>(vehicleMac, (uchar *)frame.data() + 4);
+    frame.append(message);
+    frame.append(Vehicle::checksum((uchar const *)frame.constData() + 3,
+                                   frame.length() - 3));
+    return frame;
+}
+
+template <unsigned int Length>
+void checksum(Benchmark::State &state)
+{
+    QByteArray data = pattern(Length);
+    while (state.next())
+        Benchmark::keep(Vehicle::checksum((uchar const *)data.constData(),
+                                          Length));
+    state.setBytesPerIteration(Length);
+}
+
+template <uint16_t (*Crc)(unsigned char const *, unsigned int),
+          unsigned int Length>
+void crc(Benchmark::State &state)
+{
+    QByteArray data = pattern(Length);
+    while (state.next())
+        Benchmark::keep(Crc((uchar const *)data.constData(), Length));
+    state.setBytesPerIteration(Length);
+}
+
+/// Register a CRC engine at each power of two from 4 B to 1 KB, and at the
+/// 206 B of the longest wired message.
+template <uint16_t (*Crc)(unsigned char const *, unsigned int)>
+void addCrc(QString const &name)
+{
+    Benchmark::add(name + "/4", crc<Crc, 4>);
+    Benchmark::add(name + "/8", crc<Crc, 8>);
+    Benchmark::add(name + "/16", crc<Crc, 16>);
+    Benchmark::add(name + "/32", crc<Crc, 32>);
+    Benchmark::add(name + "/64", crc<Crc, 64>);
+    Benchmark::add(name + "/128", crc<Crc, 128>);
+    Benchmark::add(name + "/206", crc<Crc, 206>);
+    Benchmark::add(name + "/256", crc<Crc, 256>);
+    Benchmark::add(name + "/512", crc<Crc, 512>);
+    Benchmark::add(name + "/1024", crc<Crc, 1024>);
+}
+
+template <unsigned int Length>
+void decrypt(Benchmark::State &state)
+{
+    QByteArray data = pattern(Length);
+    uchar *bytes = (uchar *)data.data();
+    while (state.next()) {
+        Vehicle::decrypt(bytes, bytes, teaKey, 0, Length);
+        Benchmark::keep(bytes[0]);
+    }
+    state.setBytesPerIteration(Length);
+}
+
+template <unsigned int Length>
+void encrypt(Benchmark::State &state)
+{
+    QByteArray data = pattern(Length);
+    uchar *bytes = (uchar *)data.data();
+    while (state.next()) {
+        Vehicle::encrypt(bytes, bytes, teaKey, 0, Length);
+        Benchmark::keep(bytes[0]);
+    }
+    state.setBytesPerIteration(Length);
+}
+
+void controlPacket(Benchmark::State &state)
+{
+    // A stick moving on two channels, the rest held.
+    ControlPacket packet;
+    int16_t value = 0;
+    while (state.next()) {
+        value = (value + 7) & 0x1FF;
+        packet.setChannel(0, value);
+        packet.setChannel(3, -value);
+        for (int i = 0; i < ControlPacket::Channels; i++)
+            if (i != 0 && i != 3)
+                packet.setChannel(i, 100);
+        Benchmark::keep(packet.data(0)[2]);
+    }
+    state.setItemsPerIteration(ControlPacket::Channels);
+}
+
+template <unsigned int Length>
+void convertToHex(Benchmark::State &state)
+{
+    QByteArray data = pattern(Length);
+    while (state.next())
+        Benchmark::keep(BenchMonitor::convertToHex(
+                            (uchar const *)data.constData(), Length));
+    state.setBytesPerIteration(Length);
+}
+
+template <void (*Format)(unsigned char const *, int, char *, bool),
+          unsigned int Length, bool Spaced>
+void hexFormat(Benchmark::State &state)
+{
+    QByteArray data = pattern(Length);
+    QByteArray out(HexFormat::length(Length, Spaced), 0);
+    while (state.next()) {
+        Format((uchar const *)data.constData(), Length, out.data(), Spaced);
+        Benchmark::keep(out.at(0));
+    }
+    state.setBytesPerIteration(Length);
+}
+
+template <QByteArray (*Message)()>
+void parseConfigMessage(Benchmark::State &state)
+{
+    QByteArray message = Message();
+    BenchVehicle vehicle(Message != imu);
+    while (state.next())
+        Benchmark::keep(vehicle.parseConfigMessage(message));
+    state.setBytesPerIteration(message.length());
+}
+
+template <bool Frames>
+void telemetryQueued(Benchmark::State &state)
+{
+    // Telemetry #22 handed to another thread's object through a queued
+    // connection, either as one Telemetry1Frame or, as before the frame
+    // signals, as the 22 arguments of telemetry1Changed. The receiving
+    // signal has nothing connected, so the difference between the two is
+    // what the queued delivery costs.
+    QByteArray message = telemetry22();
+    BenchVehicle vehicle(true);
+    Vehicle receiver;
+    if (Frames)
+        QObject::connect(&vehicle,
+                         SIGNAL(telemetry1Received(Telemetry1Frame)),
+                         &receiver,
+                         SIGNAL(telemetry1Received(Telemetry1Frame)),
+                         Qt::QueuedConnection);
+    else
+        QObject::connect(&vehicle,
+                         SIGNAL(telemetry1Changed(float,float,float,int,int,
+                                uint,float,int,int,int,float,float,float,
+                                float,float,float,float,uint,int,int,int,
+                                float)),
+                         &receiver,
+                         SIGNAL(telemetry1Changed(float,float,float,int,int,
+                                uint,float,int,int,int,float,float,float,
+                                float,float,float,float,uint,int,int,int,
+                                float)),
+                         Qt::QueuedConnection);
+    while (state.next()) {
+        vehicle.parseConfigMessage(message);
+        QCoreApplication::sendPostedEvents(&receiver, QEvent::MetaCall);
+    }
+}
+
+/// Traffic of a flight as logged: telemetry received at 5 Hz each and
+/// controls sent at 50 Hz, as XBee frames.
+QList<QByteArray> flight()
+{
+    QList<QByteArray> frames;
+    for (int i = 0; i < 10; i++)
+        frames.append(pattern(i % 5 < 2? 31 : 33));
+    frames.append(xbeeReceive(telemetry22()));
+    frames.append(xbeeReceive(telemetry23()));
+    return frames;
+}
+
+void trafficLog(Benchmark::State &state)
+{
+    QList<QByteArray> frames = flight();
+    QString path = QDir::temp().absoluteFilePath("benchmarks.dftl");
+    TrafficLog log;
+    log.open(path);
+    quint64 bytes = 0;
+    for (quint64 i = 0; state.next(); i++) {
+        QByteArray const &frame = frames[i % frames.length()];
+        log.append(frame, i % 12 >= 10);
+        bytes += frame.length();
+    }
+    log.close();
+    QFile::remove(path);
+    state.setBytesPerIteration(bytes / state.iterations);
+}
+
+void messageHistory(Benchmark::State &state)
+{
+    // Apart from the occasional growth of the stride offsets, which are
+    // bounded, this should not allocate, so memory stays flat however long
+    // the session.
+    QList<QByteArray> frames = flight();
+    QString path = QDir::temp().absoluteFilePath("benchmarks.dftl");
+    MessageHistory history;
+    history.open(path);
+    quint64 bytes = 0;
+    for (quint64 i = 0; state.next(); i++) {
+        QByteArray const &frame = frames[i % frames.length()];
+        history.append(frame, i % 12 >= 10);
+        bytes += frame.length();
+    }
+    QFile::remove(path);
+    state.setBytesPerIteration(bytes / state.iterations);
+}
+
+void messageModel(Benchmark::State &state)
+{
+    // A flight at 5000 frames/s: the monitor lists new frames once per
+    // display frame and the view then asks for the rows it shows.
+    QList<QByteArray> frames = flight();
+    QString path = QDir::temp().absoluteFilePath("benchmarks.dftl");
+    MessageModel model;
+    model.open(path);
+    quint64 bytes = 0;
+    for (quint64 i = 0; state.next(); i++) {
+        QByteArray const &frame = frames[i % frames.length()];
+        model.append(frame, i % 12 >= 10);
+        bytes += frame.length();
+        if (i % 83 == 82 && model.refresh()) {
+            int rows = model.rowCount();
+            for (int row = qMax(rows - 40, 0); row < rows; row++)
+                for (int column = 0; column < MessageModel::Columns; column++)
+                    Benchmark::keep(model.data(model.index(row, column)));
+        }
+    }
+    QFile::remove(path);
+    state.setBytesPerIteration(bytes / state.iterations);
+}
+
+void messageScrub(Benchmark::State &state)
+{
+    // Dragging the scroll bar across a 100k frame session: each iteration
+    // renders a page of 40 rows somewhere else in it, most of them long
+    // gone from memory and read back from the log.
+    QList<QByteArray> frames = flight();
+    QString path = QDir::temp().absoluteFilePath("benchmarks.dftl");
+    MessageModel model;
+    model.open(path);
+    for (int i = 0; i < 100000; i++) {
+        model.append(frames[i % frames.length()], i % 12 >= 10);
+        // Let the log's writer keep up, so nothing is dropped.
+        if (i % 1024 == 1023)
+            QThread::yieldCurrentThread();
+    }
+    model.refresh();
+    int pages = model.rowCount() / 40;
+    for (quint64 i = 0; state.next(); i++) {
+        int first = (i * 7919 % pages) * 40;
+        model.setDecrypt(i & 1);
+        for (int row = first; row < first + 40; row++)
+            for (int column = 0; column < MessageModel::Columns; column++)
+                Benchmark::keep(model.data(model.index(row, column)));
+    }
+    QFile::remove(path);
+    state.setItemsPerIteration(40);
+}
+
+void trafficLogText(Benchmark::State &state)
+{
+    // The text log MonitorWidget wrote before TrafficLog, for comparison.
+    QList<QByteArray> frames = flight();
+    QString path = QDir::temp().absoluteFilePath("benchmarks.log");
+    QFile log(path);
+    log.open(QFile::ReadWrite | QFile::Truncate);
+    quint64 bytes = 0;
+    for (quint64 i = 0; state.next(); i++) {
+        QByteArray const &frame = frames[i % frames.length()];
+        QDateTime current = QDateTime::currentDateTime();
+        QString timestamp = QString::number(current.toTime_t() * 1000 +
+                current.time().msec());
+        timestamp.append(":");
+        log.write(timestamp.toAscii() + frame.toHex().toUpper() + '\n');
+        bytes += frame.length();
+    }
+    log.close();
+    QFile::remove(path);
+    state.setBytesPerIteration(bytes / state.iterations);
+}
+
+#ifdef Q_OS_UNIX
+void handshake(Benchmark::State &state)
+{
+    // The emulated vehicle and its XBee module answer over a pseudo-terminal
+    // paced to 57600 baud. Time runs from open() until controls can be
+    // sent, with the local MAC cached after the first iteration as it is for
+    // any reconnection through the same port.
+    VehicleEmulator emulator;
+    emulator.setReporting(false);
+    emulator.setMac(vehicleMac);
+    emulator.setChannel(0xC);
+    if (!emulator.open()) {
+        fprintf(stderr, "Could not create pseudo-terminal\n");
+        return;
+    }
+    HandshakeVehicle vehicle;
+    QElapsedTimer timeout;
+    while (state.next()) {
+        vehicle.open(emulator.portName(), vehicleMac, 0xC);
+        timeout.start();
+        while (!vehicle.ready() && !timeout.hasExpired(5000))
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        if (!vehicle.ready())
+            fprintf(stderr, "Handshake timed out\n");
+        vehicle.close();
+        // Let the port go before it is opened again.
+        QCoreApplication::processEvents();
+        QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+    }
+}
+
+template <bool Gather>
+void txPass(Benchmark::State &state)
+{
+    // One pass of the event loop: two bulk fragments ahead of a control
+    // frame, written to /dev/null so that every write() is a system call.
+    QFile null("/dev/null");
+    null.open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+    TxQueue queue;
+    queue.setDevice(&null, 0, Gather);
+    QByteArray fragment = pattern(99);
+    QByteArray control = pattern(34);
+    while (state.next()) {
+        queue.write(TxQueue::Bulk, (uchar const *)fragment.constData(), 99);
+        queue.write(TxQueue::Bulk, (uchar const *)fragment.constData(), 99);
+        queue.write(TxQueue::Control, (uchar const *)control.constData(),
+                    34);
+        queue.flush();
+    }
+    queue.setDevice(0, 0);
+    state.setItemsPerIteration(3);
+}
+#endif
+
+void parseDatagram(Benchmark::State &state)
+{
+    // Dragan View echoing a telemetry message it received.
+    QByteArray inner = xbeeReceive(telemetry22());
+    QByteArray datagram(4, 0);
+    datagram[0] = (char)0xDF;
+    qToBigEndian<uint16_t>(inner.length() + 1, (uchar *)datagram.data() + 1);
+    datagram[3] = 0x11;
+    datagram.append(inner);
+    datagram.append(Vehicle::checksum((uchar const *)datagram.constData() + 3,
+                                      inner.length() + 1));
+    BenchRemote remote;
+    while (state.next())
+        Benchmark::keep(remote.parseDatagram(datagram));
+    state.setBytesPerIteration(datagram.length());
+}
+
+template <unsigned int CorruptPercent>
+void scanBuffer(Benchmark::State &state)
+{
+    // Sixteen frames alternating between the two telemetry messages, as a
+    // single read would deliver them, with a share of the bytes replaced
+    // as a noisy link would.
+    QByteArray stream;
+    for (int i = 0; i < 16; i++)
+        stream.append(xbeeReceive(i % 2? telemetry23() : telemetry22()));
+    uint32_t x = 1;
+    for (int i = 0; i < stream.length(); i++) {
+        x = x * 1103515245 + 12345;
+        if ((x >> 16) % 100 < CorruptPercent)
+            stream[i] = (char)(x >> 8);
+    }
+    BenchVehicle vehicle(true);
+    while (state.next()) {
+        vehicle.buffer.append(stream.constData(), stream.length());
+        vehicle.scanBuffer();
+    }
+    state.setBytesPerIteration(stream.length());
+    state.setItemsPerIteration(16);
+}
+
+template <bool Zigbee>
+void sendControl(Benchmark::State &state)
+{
+    BenchVehicle vehicle(Zigbee);
+    while (state.next())
+        vehicle.sendControl();
+}
+
+template <unsigned int Length, bool Zigbee>
+void sendMessage(Benchmark::State &state)
+{
+    QByteArray payload = pattern(Length);
+    BenchVehicle vehicle(Zigbee);
+    while (state.next())
+        vehicle.sendMessage(5, 0, 1, payload);
+    state.setBytesPerIteration(Length);
+}
+
+void spscQueue(Benchmark::State &state)
+{
+    static SpscQueue<Telemetry1Frame, 1024> queue;
+    Telemetry1Frame frame;
+    memset(&frame, 0, sizeof(frame));
+    while (state.next()) {
+        queue.push(frame);
+        queue.pop(&frame);
+    }
+    Benchmark::keep(frame);
+}
+
+template <QByteArray (*Message)()>
+void telemetryDecode(Benchmark::State &state)
+{
+    QByteArray message = Message();
+    uchar *bytes = (uchar *)message.data();
+    Vehicle::decrypt(bytes, bytes, teaKey, 4, message.length() - 6);
+    while (state.next()) {
+        if (bytes[4] == 22)
+            Benchmark::keep(Telemetry1Frame::decode(bytes));
+        else
+            Benchmark::keep(Telemetry2Frame::decode(bytes));
+    }
+}
+
+/// Hex as the monitor formatted it before HexFormat, the expected output.
+QByteArray legacyHex(QByteArray const &message, bool spaced)
+{
+    QByteArray hexBytes = message.toHex().toUpper();
+    if (!spaced)
+        return hexBytes;
+    QByteArray paddedBytes(qMax(3 * message.length() - 1, 0), ' ');
+    for (int i = 0; i < message.length(); ++i) {
+        paddedBytes[3 * i] = hexBytes[2 * i];
+        paddedBytes[3 * i + 1] = hexBytes[2 * i + 1];
+    }
+    return paddedBytes;
+}
+
+/// Sign-extend the low bits of a field, as the hand-written decoder did.
+int16_t legacyExtend(int16_t value, int16_t sign)
+{
+    return (value & sign)? (int16_t)(value | -sign) : value;
+}
+
+/// Telemetry #22 as Vehicle decoded it before BitField, the expected output.
+Telemetry1Frame legacyTelemetry1(uchar const *data)
+{
+    int32_t itemp;
+    int16_t stemp;
+    Telemetry1Frame frame;
+    itemp = qFromLittleEndian<int32_t>(data + 5);
+    frame.roll = legacyExtend(itemp & 0x7FF, 0x400) / 10.0f;
+    frame.pitch = legacyExtend((itemp & 0x3FF800) >> 11, 0x400) / 10.0f;
+    frame.yaw = legacyExtend((itemp & 0xFFC00000U) >> 22, 0x200);
+    frame.packetLoss = data[9];
+    frame.rssi = data[10];
+    frame.throttle = qFromLittleEndian<uint16_t>(data + 11);
+    frame.altPre = qFromLittleEndian<int16_t>(data + 13) / 10.0f;
+    itemp = qFromLittleEndian<int32_t>(data + 15);
+    frame.magX = legacyExtend(itemp & 0x1FFF, 0x1000);
+    frame.magY = legacyExtend((itemp & 0x3FFE000) >> 13, 0x1000);
+    // All of byte 19 was taken, its unused top bit included.
+    stemp = (itemp & 0xFC000000U) >> 26;
+    stemp |= data[19] << 6;
+    frame.magZ = legacyExtend(stemp, 0x1000);
+    itemp = qFromLittleEndian<int32_t>(data + 20);
+    frame.velN = legacyExtend(itemp & 0x3FF, 0x200) / 10.0f;
+    frame.velE = legacyExtend((itemp & 0xFFC00) >> 10, 0x200) / 10.0f;
+    frame.velD = legacyExtend((itemp & 0x3FF00000) >> 20, 0x200) / 10.0f;
+    itemp = qFromLittleEndian<int32_t>(data + 24);
+    frame.errN = legacyExtend(itemp & 0x3FF, 0x200);
+    frame.errE = legacyExtend((itemp & 0xFFC00) >> 10, 0x200);
+    frame.errD = legacyExtend((itemp & 0x3FF00000) >> 20, 0x200);
+    if ((itemp & 1 << 30) == 0) {
+        frame.errN /= 10;
+        frame.errE /= 10;
+    }
+    if ((itemp & 1U << 31) == 0)
+        frame.errD /= 10;
+    frame.battHeli = data[28] / 10.0f;
+    frame.flightTime = qFromLittleEndian<uint16_t>(data + 29) * 40;
+    frame.svs = data[31] & 0x1F;
+    frame.holdMode = (data[31] & 0xE0) >> 5;
+    frame.current = data[32] / 10.0f;
+    frame.picture = data[33];
+    return frame;
+}
+
+/// Telemetry #23 as Vehicle decoded it before BitField, the expected output.
+Telemetry2Frame legacyTelemetry2(uchar const *data)
+{
+    int32_t itemp;
+    int16_t stemp;
+    double dtemp;
+    Telemetry2Frame frame;
+    itemp = qFromLittleEndian<int32_t>(data + 5);
+    frame.roll = legacyExtend(itemp & 0x7FF, 0x400) / 10.0f;
+    frame.pitch = legacyExtend((itemp & 0x3FF800) >> 11, 0x400) / 10.0f;
+    frame.yaw = legacyExtend((itemp & 0xFFC00000U) >> 22, 0x200);
+    frame.packetLoss = data[9];
+    frame.rssi = data[10];
+    frame.throttle = qFromLittleEndian<uint16_t>(data + 11);
+    frame.altPre = qFromLittleEndian<int16_t>(data + 13) / 10.0f;
+    frame.altGps = qFromLittleEndian<int16_t>(data + 15);
+    for (int i = 0; i < 2; i++) {
+        itemp = qFromLittleEndian<int32_t>(data + 17 + 4 * i);
+        dtemp = legacyExtend((itemp & 0xFF800000U) >> 23, 0x100);
+        if (dtemp < 0)
+            dtemp -= (itemp & 0x7FFFFF) / 1000000.0;
+        else
+            dtemp += (itemp & 0x7FFFFF) / 1000000.0;
+        (i? frame.lng : frame.lat) = dtemp;
+    }
+    itemp = qFromLittleEndian<int32_t>(data + 25);
+    frame.pdop = (itemp & 0x3FF) / 10.0f;
+    frame.hacc = (itemp >> 10 & 0x7FF) / 10.0f;
+    frame.vacc = (itemp >> 21 & 0x7FF) / 10.0f;
+    itemp = qFromLittleEndian<int32_t>(data + 29);
+    frame.gpsTime = (itemp & 0xFFFFF) * 1000;
+    frame.temperature = -1000000;
+    stemp = legacyExtend(itemp >> 20 & 0xFFF, 0x800);
+    if (stemp != 0x7FF)
+        frame.temperature = stemp * 0.0625f;
+    frame.tilt = data[33];
+    return frame;
+}
+
+/// Check that every accelerated path agrees with its reference before
+/// timing anything, a wrong answer is never a speed-up.
+bool verify()
+{
+    for (unsigned int length = 0; length <= 1024; length++) {
+        QByteArray data = pattern(length);
+        uchar const *bytes = (uchar const *)data.constData();
+        uint16_t expected = Crc16::bitwise(bytes, length);
+        if (Crc16::table(bytes, length) != expected ||
+                Crc16::slicing8(bytes, length) != expected ||
+                Crc16::clmul(bytes, length) != expected ||
+                Crc16::compute(bytes, length) != expected) {
+            fprintf(stderr, "CRC mismatch at length %u\n", length);
+            return false;
+        }
+        QByteArray round = data;
+        Vehicle::encrypt((uchar const *)round.constData(),
+                         (uchar *)round.data(), teaKey, 0, length);
+        Vehicle::decrypt((uchar const *)round.constData(),
+                         (uchar *)round.data(), teaKey, 0, length);
+        if (round != data) {
+            fprintf(stderr, "TEA round trip failed at length %u\n", length);
+            return false;
+        }
+        for (int spaced = 0; spaced < 2; spaced++) {
+            QByteArray expected = legacyHex(data, spaced);
+            QByteArray hex(expected.length(), 0);
+            void (*formats[])(unsigned char const *, int, char *, bool) = {
+                HexFormat::scalar, HexFormat::ssse3, HexFormat::avx2,
+                HexFormat::format
+            };
+            for (unsigned int i = 0; i < sizeof(formats) / sizeof(*formats);
+                 i++) {
+                hex.fill(0);
+                formats[i](bytes, length, hex.data(), spaced);
+                if (hex != expected) {
+                    fprintf(stderr, "Hex mismatch at length %u\n", length);
+                    return false;
+                }
+            }
+            HexFormat::format(data, hex, spaced);
+            if (hex != expected) {
+                fprintf(stderr, "Hex mismatch at length %u\n", length);
+                return false;
+            }
+        }
+    }
+    ControlPacket packet;
+    uint32_t x = 1;
+    for (int i = 0; i < 10000; i++) {
+        x = x * 1103515245 + 12345;
+        packet.setChannel((x >> 16) % ControlPacket::Channels,
+                          (int16_t)((x >> 4) & 0x3FF) - 511);
+        // Both cycles, the reduced one adds a four channel layout.
+        packet.setReduced(i & 1);
+        for (unsigned int slot = 0; slot < 4; slot++) {
+            uchar const *bytes = packet.data(slot);
+            unsigned int length = packet.length(slot);
+            if (qFromLittleEndian<quint16>(bytes + length - 2) !=
+                    Crc16::bitwise(bytes, length - 2)) {
+                fprintf(stderr, "Control packet CRC mismatch\n");
+                return false;
+            }
+        }
+    }
+    // The bitfield decoders must match the hand-written ones bit for bit,
+    // on the fixtures and on random payloads. The one intended difference:
+    // the old magZ took the unused top bit of byte 19, reading 8192 too
+    // high when it was set on a positive value.
+    QList<QByteArray> telemetry;
+    telemetry << telemetry22() << telemetry23();
+    for (int i = 0; i < 20000; i++) {
+        QByteArray message(6 + Telemetry1Frame::Length, 0);
+        for (int j = 0; j < message.length(); j++) {
+            x = x * 1103515245 + 12345;
+            message[j] = (char)(x >> 16);
+        }
+        message[0] = (char)0xFF;
+        message[4] = i & 1? 23 : 22;
+        telemetry << message;
+    }
+    for (int i = 0; i < telemetry.length(); i++) {
+        QByteArray message = telemetry[i];
+        uchar *bytes = (uchar *)message.data();
+        if (i < 2)
+            Vehicle::decrypt(bytes, bytes, teaKey, 4, message.length() - 6);
+        // Neither frame has padding, so equal fields mean equal bytes.
+        bool same;
+        if (bytes[4] == 22) {
+            Telemetry1Frame expected = legacyTelemetry1(bytes);
+            if ((bytes[19] & 0xC0) == 0x80)
+                expected.magZ -= 1 << 13;
+            Telemetry1Frame frame = Telemetry1Frame::decode(bytes);
+            same = !memcmp(&expected, &frame, sizeof(frame));
+        } else {
+            Telemetry2Frame expected = legacyTelemetry2(bytes);
+            Telemetry2Frame frame = Telemetry2Frame::decode(bytes);
+            same = !memcmp(&expected, &frame, sizeof(frame));
+        }
+        if (!same) {
+            fprintf(stderr, "Telemetry #%d decoded differently\n", bytes[4]);
+            return false;
+        }
+    }
+    // Cached views must match decoding from scratch, whichever options.
+    QList<QByteArray> frames = flight();
+    frames << telemetry22() << eeprom16() << imu() << QByteArray(1, 0x7E);
+    for (int i = 0; i < frames.length(); i++) {
+        FrameCache::Frame frame;
+        FrameCache::decode(frames[i], frame);
+        for (int option = 0; option < 4; option++) {
+            bool decrypting = option & 1;
+            bool stripping = option & 2;
+            QByteArray whole = decrypting?
+                        FrameCache::decryptMessage(frames[i]) : frames[i];
+            QByteArray expected = stripping?
+                        FrameCache::stripMessage(whole) : whole;
+            if (frame.bytes(decrypting, stripping) != expected ||
+                    frame.types[decrypting] !=
+                    FrameCache::typeOf(whole, decrypting)) {
+                fprintf(stderr, "Decoded frame mismatch\n");
+                return false;
+            }
+        }
+    }
+    // Messages read back from the log must be the ones asked for, however
+    // many the log did not take. Empty messages are never logged.
+    QString path = QDir::temp().absoluteFilePath("verify.dftl");
+    MessageHistory history;
+    history.open(path);
+    int const messages = 6 * MessageHistory::Window;
+    for (int i = 0; i < messages; i++) {
+        QByteArray message;
+        if (i % 7 && (i / 3) % 97)
+            message = QByteArray((char const *)&i, sizeof(i));
+        history.append(message, i % 3 == 0);
+    }
+    while (history.queueDepth() > 0)
+        QThread::yieldCurrentThread();
+    int counts[2] = { 0, 0 };
+    for (int i = 0; i < messages; i++) {
+        bool incoming = i % 3 == 0;
+        QByteArray message = history.at(counts[incoming]++, incoming);
+        bool logged = i % 7 && (i / 3) % 97;
+        bool missing = message.isEmpty() &&
+                (!logged || history.droppedCount() > 0);
+        if (!missing && message !=
+                QByteArray((char const *)&i, sizeof(i))) {
+            fprintf(stderr, "History read back the wrong message\n");
+            return false;
+        }
+    }
+    QFile::remove(path);
+    BenchVehicle wired(false);
+    BenchVehicle zigbee(true);
+    if (!zigbee.parseConfigMessage(telemetry22()) ||
+            !zigbee.parseConfigMessage(telemetry23()) ||
+            !zigbee.parseConfigMessage(eeprom16()) ||
+            !wired.parseConfigMessage(imu())) {
+        fprintf(stderr, "Fixture rejected by parseConfigMessage\n");
+        return false;
+    }
+    // Nothing is listening to Vehicle::message, so a control tick should
+    // not touch the heap at all, whether its frame is written on its own or
+    // gathered as for a serial port.
+    BenchVehicle gathered(true, true);
+    quint64 allocations = Allocations::count();
+    for (int i = 0; i < 100; i++) {
+        wired.sendControl();
+        zigbee.sendControl();
+        gathered.sendControl();
+    }
+    if (Allocations::count() != allocations) {
+        fprintf(stderr, "Control ticks allocated %llu times\n",
+                (unsigned long long)(Allocations::count() - allocations));
+        return false;
+    }
+    return true;
+}
+
+/// Get the lateness most control ticks stay within.
+/// @return upper bound in us of the bucket reaching fraction of the ticks,
+/// -1 if that is the open-ended last bucket.
+/// @param histogram see ControlScheduler::histogram().
+/// @param fraction share of the ticks, e.g. 0.99.
+int latenessBelow(QVector<quint64> const &histogram, double fraction)
+{
+    quint64 total = 0;
+    for (int i = 0; i < histogram.size(); i++)
+        total += histogram[i];
+    quint64 seen = 0;
+    for (int i = 0; i < histogram.size() - 1; i++) {
+        seen += histogram[i];
+        if (seen >= fraction * total)
+            return 1 << i;
+    }
+    return -1;
+}
+
+/// Report how late control ticks fire while the GUI thread is busy, with
+/// the Vehicle on the GUI thread as by default and on its own thread as
+/// with -t. The GUI thread alternates GuiBusy ms of work, standing in for
+/// painting and model updates, with GuiIdle ms in its event loop.
+/// @return process exit status.
+/// @param seconds time spent on each placement.
+int controlJitter(int seconds)
+{
+    enum { GuiBusy = 20, GuiIdle = 5 };
+    printf("%-10s %10s %8s %10s %10s %10s\n", "Vehicle", "Ticks", "Missed",
+           "p50 <= us", "p99 <= us", "Max us");
+    for (int threaded = 0; threaded < 2; threaded++) {
+        QThread thread;
+        BenchVehicle *vehicle = new BenchVehicle(true);
+        if (threaded) {
+            vehicle->moveToThread(&thread);
+            QObject::connect(&thread, SIGNAL(finished()),
+                             vehicle, SLOT(deleteLater()));
+            thread.start();
+        }
+        ControlScheduler *scheduler = vehicle->controlScheduler;
+        QElapsedTimer clock;
+        clock.start();
+        while (clock.elapsed() < seconds * 1000) {
+            QElapsedTimer busy;
+            busy.start();
+            while (busy.elapsed() < GuiBusy)
+                Benchmark::keep(busy);
+            QEventLoop idle;
+            QTimer::singleShot(GuiIdle, &idle, SLOT(quit()));
+            idle.exec();
+        }
+        // Stopped in its own thread, after which the counts stay put.
+        QMetaObject::invokeMethod(scheduler, "stop", threaded?
+                                      Qt::BlockingQueuedConnection :
+                                      Qt::DirectConnection);
+        QVector<quint64> histogram = scheduler->histogram();
+        quint64 ticks = 0;
+        for (int i = 0; i < histogram.size(); i++)
+            ticks += histogram[i];
+        printf("%-10s %10llu %8llu %10d %10d %10d\n",
+               threaded? "io-thread" : "gui-thread",
+               (unsigned long long)ticks,
+               (unsigned long long)scheduler->missedCount(),
+               latenessBelow(histogram, 0.5), latenessBelow(histogram, 0.99),
+               scheduler->maxLateness());
+        if (threaded) {
+            thread.quit();
+            thread.wait();
+        } else {
+            delete vehicle;
+        }
+    }
+    return 0;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    if (!verify())
+        return 1;
+    // --control_jitter[=seconds] reports tick lateness instead.
+    foreach (QString argument, a.arguments()) {
+        if (argument.startsWith("--control_jitter")) {
+            int seconds = argument.section('=', 1).toInt();
+            return controlJitter(seconds > 0? seconds : 10);
+        }
+    }
+
+    Benchmark::add("Vehicle::checksum/99", checksum<99>);
+    addCrc<Crc16::bitwise>("Crc16::bitwise");
+    addCrc<Crc16::table>("Crc16::table");
+    addCrc<Crc16::slicing8>("Crc16::slicing8");
+    addCrc<Crc16::clmul>("Crc16::clmul");
+    addCrc<Crc16::compute>("Crc16::compute");
+    Benchmark::add("Vehicle::encrypt/32", encrypt<32>);
+    Benchmark::add("Vehicle::encrypt/200", encrypt<200>);
+    Benchmark::add("Vehicle::decrypt/32", decrypt<32>);
+    Benchmark::add("Vehicle::decrypt/200", decrypt<200>);
+    Benchmark::add("Telemetry1Frame::decode", telemetryDecode<telemetry22>);
+    Benchmark::add("Telemetry2Frame::decode", telemetryDecode<telemetry23>);
+    Benchmark::add("Vehicle::parseConfigMessage/telemetry22",
+                   parseConfigMessage<telemetry22>);
+    Benchmark::add("Vehicle::parseConfigMessage/telemetry23",
+                   parseConfigMessage<telemetry23>);
+    Benchmark::add("Vehicle::parseConfigMessage/eeprom16",
+                   parseConfigMessage<eeprom16>);
+    Benchmark::add("Vehicle::parseConfigMessage/imu",
+                   parseConfigMessage<imu>);
+    Benchmark::add("Vehicle::telemetry1/queued-scalars",
+                   telemetryQueued<false>);
+    Benchmark::add("Vehicle::telemetry1/queued-frame",
+                   telemetryQueued<true>);
+    Benchmark::add("Vehicle::scanBuffer/xbee16", scanBuffer<0>);
+    Benchmark::add("Vehicle::scanBuffer/xbee16-corrupt10", scanBuffer<10>);
+    Benchmark::add("ControlPacket::setChannel", controlPacket);
+    Benchmark::add("Vehicle::sendControl/wired", sendControl<false>);
+    Benchmark::add("Vehicle::sendControl/xbee", sendControl<true>);
+    Benchmark::add("Vehicle::sendMessage/wired/8", sendMessage<8, false>);
+    Benchmark::add("Vehicle::sendMessage/xbee/8", sendMessage<8, true>);
+    Benchmark::add("Vehicle::sendMessage/xbee/80", sendMessage<80, true>);
+    Benchmark::add("Vehicle::sendMessage/xbee/200", sendMessage<200, true>);
+    Benchmark::add("HexFormat::scalar/16",
+                   hexFormat<HexFormat::scalar, 16, true>);
+    Benchmark::add("HexFormat::scalar/99",
+                   hexFormat<HexFormat::scalar, 99, true>);
+    Benchmark::add("HexFormat::ssse3/16",
+                   hexFormat<HexFormat::ssse3, 16, true>);
+    Benchmark::add("HexFormat::ssse3/99",
+                   hexFormat<HexFormat::ssse3, 99, true>);
+    Benchmark::add("HexFormat::avx2/16", hexFormat<HexFormat::avx2, 16, true>);
+    Benchmark::add("HexFormat::avx2/99", hexFormat<HexFormat::avx2, 99, true>);
+    Benchmark::add("HexFormat::format/16",
+                   hexFormat<HexFormat::format, 16, true>);
+    Benchmark::add("HexFormat::format/99",
+                   hexFormat<HexFormat::format, 99, true>);
+    Benchmark::add("HexFormat::format/plain/99",
+                   hexFormat<HexFormat::format, 99, false>);
+    Benchmark::add("MonitorWidget::convertToHex/99", convertToHex<99>);
+    Benchmark::add("RemoteController::parseDatagram/echo", parseDatagram);
+    Benchmark::add("SpscQueue::pushPop", spscQueue);
+    Benchmark::add("TrafficLog::append/flight", trafficLog);
+    Benchmark::add("MonitorWidget::textLog/flight", trafficLogText);
+    Benchmark::add("MessageHistory::append/flight", messageHistory);
+    Benchmark::add("MessageModel::append/flight", messageModel);
+    Benchmark::add("MessageModel::data/scrub100k", messageScrub);
+#ifdef Q_OS_UNIX
+    Benchmark::add("Vehicle::open/xbee-pty", handshake);
+    Benchmark::add("TxQueue::pass/separate", txPass<false>);
+    Benchmark::add("TxQueue::pass/gathered", txPass<true>);
+#endif
+
+    return Benchmark::run(a.arguments());
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <stdint.h>
+
+/// Compile-time descriptor, decoder and encoder for one field of a bit-packed
+/// message.
+///
+/// Fields are little-endian bit strings. Everything except the message
+/// address is a template parameter, so each decode() expands to a handful of
+/// straight-line loads, shifts and masks with no table walk at run time.<BR>
+/// A message layout is described by a list of typedefs, one per field, e.g.
+/// @code
+/// typedef BitField<40, 11, true, 10> Roll; // bits 40-50, signed, 0.1 deg
+/// float roll = Roll::value(data);
+/// @endcode
+/// @tparam Bit offset of the field's least significant bit from the start of
+/// the message.
+/// @tparam Width number of bits in the field, at most 32.
+/// @tparam Signed true if the field is two's complement.
+/// @tparam Divisor scale applied by value(), which returns raw() / Divisor.
+template <unsigned int Bit, unsigned int Width, bool Signed = false,
+          int Divisor = 1>
+struct BitField
+{
+    enum {
+        /// First byte containing any bit of the field.
+        FirstByte = Bit / 8,
+        /// Position of the least significant bit within FirstByte.
+        Shift = Bit % 8,
+        /// Number of bytes spanned by the field.
+        Bytes = (Shift + Width + 7) / 8
+    };
+
+    /// Extract the field.
+    /// @return field value, sign-extended if Signed.
+    /// @param data address of the first byte of the message.
+    static int32_t raw(unsigned char const *data)
+    {
+        uint64_t word = 0;
+        for (int i = Bytes - 1; i >= 0; i--)
+            word = (word << 8) | data[FirstByte + i];
+        uint32_t const mask = (uint32_t)(((uint64_t)1 << Width) - 1);
+        uint32_t value = (uint32_t)(word >> Shift) & mask;
+        if (Signed) {
+            uint32_t const sign = (uint32_t)1 << (Width - 1);
+            value = (value ^ sign) - sign;
+        }
+        return (int32_t)value;
+    }
+
+    /// Scale a value and insert it into the field.
+    ///
+    /// Inverse of value(), rounded to the nearest representable step.
+    /// @param data address of the first byte of the message.
+    /// @param value unscaled value, truncated to Width bits after scaling.
+    static void setValue(unsigned char *data, float value)
+    {
+        float scaled = value * Divisor;
+        store(data, (int32_t)(scaled + (scaled < 0? -0.5f : 0.5f)));
+    }
+
+    /// Insert the field, leaving all other bits untouched.
+    ///
+    /// Inverse of raw().
+    /// @param data address of the first byte of the message.
+    /// @param raw field value, truncated to Width bits.
+    static void store(unsigned char *data, int32_t raw)
+    {
+        uint64_t word = 0;
+        for (int i = Bytes - 1; i >= 0; i--)
+            word = (word << 8) | data[FirstByte + i];
+        uint64_t const mask = (((uint64_t)1 << Width) - 1) << Shift;
+        word = (word & ~mask) | (((uint64_t)(uint32_t)raw << Shift) & mask);
+        for (int i = 0; i < Bytes; i++, word >>= 8)
+            data[FirstByte + i] = (unsigned char)word;
+    }
+
+    /// Extract the field and scale it.
+    /// @return raw() / Divisor.
+    /// @param data address of the first byte of the message.
+    static float value(unsigned char const *data)
+    {
+        return raw(data) / (float)Divisor;
+    }
+};
@@ -0,0 +1,100 @@
+#include "channelcache.h"
+#include <QSettings>
+#include <QString>
+
+namespace {
+/// First and number of ZigBee channels.
+uint8_t const firstChannel = 0xC;
+int const channelCount = 12;
+
+/// Where the application settings are kept.
+char const organization[] = "Draganfly";
+char const application[] = "DraganflyerAPIExample";
+}
+
+ChannelCache::ChannelCache() :
+    entries()
+{
+    QSettings settings(organization, application);
+    int count = settings.beginReadArray("vehicles");
+    for (int i = 0; i < count && entries.length() < MaxVehicles; i++) {
+        settings.setArrayIndex(i);
+        bool ok;
+        Entry entry;
+        entry.mac = settings.value("mac").toString().toULongLong(&ok, 16);
+        entry.channel = settings.value("channel").toUInt();
+        if (ok && entry.channel >= firstChannel &&
+                entry.channel < firstChannel + channelCount)
+            entries.append(entry);
+    }
+    settings.endArray();
+}
+
+uint8_t ChannelCache::channel(uint64_t mac) const
+{
+    foreach (Entry entry, entries)
+        if (entry.mac == mac)
+            return entry.channel;
+    return 0;
+}
+
+QList<uint8_t> ChannelCache::order(QList<quint64> const &wanted,
+                                   int *known) const
+{
+    QList<uint8_t> channels;
+    foreach (quint64 mac, wanted) {
+        uint8_t last = channel(mac);
+        if (last && !channels.contains(last))
+            channels.append(last);
+    }
+    foreach (Entry entry, entries)
+        if (!channels.contains(entry.channel))
+            channels.append(entry.channel);
+    if (known)
+        *known = channels.length();
+    for (int i = 0; i < channelCount; i++)
+        if (!channels.contains(firstChannel + i))
+            channels.append(firstChannel + i);
+    return channels;
+}
+
+void ChannelCache::record(uint64_t mac, uint8_t channel)
+{
+    if (channel < firstChannel || channel >= firstChannel + channelCount)
+        return;
+    for (int i = 0; i < entries.length(); i++) {
+        if (entries[i].mac == mac) {
+            if (i == 0 && entries[i].channel == channel)
+                return;
+            entries.removeAt(i);
+            break;
+        }
+    }
+    Entry entry;
+    entry.mac = mac;
+    entry.channel = channel;
+    entries.prepend(entry);
+    while (entries.length() > MaxVehicles)
+        entries.removeLast();
+    save();
+}
+
+void ChannelCache::save() const
+{
+    QSettings settings(organization, application);
+    settings.beginWriteArray("vehicles", entries.length());
+    for (int i = 0; i < entries.length(); i++) {
+        settings.setArrayIndex(i);
+        settings.setValue("mac", QString::number(entries[i].mac, 16));
+        settings.setValue("channel", entries[i].channel);
+    }
+    settings.endArray();
+}
+
+QList<quint64> ChannelCache::vehicles() const
+{
+    QList<quint64> macs;
+    foreach (Entry entry, entries)
+        macs.append(entry.mac);
+    return macs;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+#include <QList>
+
+/// Remembers the ZigBee channel each vehicle was last found on.
+///
+/// Kept in the application settings so that a scan started after a restart
+/// still knows where to look first. Only the most recently found vehicles
+/// are kept.
+class ChannelCache
+{
+public:
+    /// Most vehicles remembered.
+    enum { MaxVehicles = 32 };
+
+    /// Constructor, loads the cache from the settings.
+    ChannelCache();
+
+    /// Get the channel a vehicle was last found on.
+    /// @return ZigBee channel, or 0 if the vehicle is not known.
+    /// @param mac MAC address of the vehicle.
+    uint8_t channel(uint64_t mac) const;
+
+    /// Get the channels in the order they should be scanned.
+    ///
+    /// Channels the wanted vehicles were last found on come first, then
+    /// those of every other known vehicle, most recently found first, then
+    /// the remaining channels in ascending order.
+    /// @return every ZigBee channel, 0x0C to 0x17, once.
+    /// @param wanted MAC addresses of the vehicles being looked for.
+    /// @param known set to the number of leading channels vehicles were
+    /// last found on, if not null.
+    QList<uint8_t> order(QList<quint64> const &wanted,
+                         int *known = 0) const;
+
+    /// Note a vehicle was found and save the cache.
+    /// @param mac MAC address of the vehicle.
+    /// @param channel ZigBee channel it answered on.
+    void record(uint64_t mac,
+                uint8_t channel);
+
+    /// Get the known vehicles.
+    /// @return MAC addresses, most recently found first.
+    QList<quint64> vehicles() const;
+
+protected:
+    /// A known vehicle.
+    struct Entry
+    {
+        quint64 mac;      ///< MAC address of the vehicle.
+        uint8_t channel;  ///< ZigBee channel it was last found on.
+    };
+
+    /// Write the cache to the settings.
+    void save() const;
+
+    /// Known vehicles, most recently found first.
+    QList<Entry> entries;
+};
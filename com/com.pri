@@ -0,0 +1,63 @@
+# Vehicle protocol and serial transport, shared by the application and the
+# benchmarks.
+QT += network
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    $$PWD/channelcache.cpp \
+    $$PWD/controlpacket.cpp \
+    $$PWD/controlscheduler.cpp \
+    $$PWD/crc16.cpp \
+    $$PWD/framebuffer.cpp \
+    $$PWD/framebuilder.cpp \
+    $$PWD/hexformat.cpp \
+    $$PWD/messagehistory.cpp \
+    $$PWD/ratecontroller.cpp \
+    $$PWD/remotecontroller.cpp \
+    $$PWD/serial/qextserialport.cpp \
+    $$PWD/tea.cpp \
+    $$PWD/telemetry.cpp \
+    $$PWD/trafficlog.cpp \
+    $$PWD/txqueue.cpp \
+    $$PWD/vehicle.cpp \
+    $$PWD/vehicleenumerator.cpp \
+    $$PWD/vehiclefleet.cpp \
+    $$PWD/vehiclerelay.cpp
+
+HEADERS += \
+    $$PWD/bitfield.h \
+    $$PWD/channelcache.h \
+    $$PWD/controlpacket.h \
+    $$PWD/controlscheduler.h \
+    $$PWD/crc16.h \
+    $$PWD/framebuffer.h \
+    $$PWD/framebuilder.h \
+    $$PWD/hexformat.h \
+    $$PWD/messagehistory.h \
+    $$PWD/mpscqueue.h \
+    $$PWD/ratecontroller.h \
+    $$PWD/remotecontroller.h \
+    $$PWD/serial/qextserialenumerator.h \
+    $$PWD/serial/qextserialport.h \
+    $$PWD/serial/qextserialport_global.h \
+    $$PWD/spscqueue.h \
+    $$PWD/tea.h \
+    $$PWD/telemetry.h \
+    $$PWD/trafficlog.h \
+    $$PWD/txqueue.h \
+    $$PWD/vehicle.h \
+    $$PWD/vehicleenumerator.h \
+    $$PWD/vehiclefleet.h \
+    $$PWD/vehiclerelay.h
+
+macx:LIBS += -framework IOKit -framework CoreFoundation
+macx:SOURCES += $$PWD/serial/qextserialenumerator_osx.cpp
+
+unix:DEFINES += _TTY_POSIX_
+unix:SOURCES += $$PWD/serial/posix_qextserialport.cpp
+unix:!macx:SOURCES += $$PWD/serial/qextserialenumerator_unix.cpp
+
+win32:DEFINES          += WINVER=0x0501
+win32:INCLUDEPATH      += C:/QT/$$[QT_VERSION]/src
+win32:LIBS             += -lsetupapi
+win32:SOURCES          += $$PWD/serial/win_qextserialport.cpp $$PWD/serial/qextserialenumerator_win.cpp
@@ -0,0 +1,102 @@
+#include "controlpacket.h"
+#include <string.h>
+#include <QtEndian>
+#include "com/crc16.h"
+
+namespace {
+/// Layout used on each tick of the full and reduced control cycles, -1 for
+/// the skipped tick.
+int const slotLayout[2][ControlPacket::Slots] = {
+    { 0, 1, 0, 2, -1 },
+    { 0, 3, 3, 2, -1 }
+};
+
+/// Channels carried by each layout.
+unsigned int const layoutChannels[4] = { 6, 7, 7, 4 };
+
+/// Change to the CRC of a message when a byte is XORed with n, with k
+/// further bytes following it up to the end of the message.
+///
+/// CRC-16 is linear in the message bits, so this depends neither on the
+/// rest of the message nor on the initial register value.
+struct Contribution
+{
+    Contribution()
+    {
+        unsigned char bytes[ControlPacket::MaxLength] = { 0 };
+        for (unsigned int k = 0; k < ControlPacket::MaxLength; k++)
+            for (unsigned int n = 0; n < 256; n++) {
+                bytes[0] = n;
+                table[k][n] = Crc16::update(0, bytes, k + 1);
+            }
+    }
+
+    /// CRC change indexed by [k][n].
+    uint16_t table[ControlPacket::MaxLength][256];
+} const contribution;
+}
+
+ControlPacket::ControlPacket() :
+    reduced(false), values()
+{
+    for (int i = 0; i < 4; i++) {
+        Layout &layout = layouts[i];
+        layout.channels = layoutChannels[i];
+        memset(layout.bytes, 0, sizeof(layout.bytes));
+        layout.bytes[0] = 0x7;
+        layout.bytes[1] = layout.channels;
+        // Tell the vehicle to use the next few ms to send any message it
+        // has queued, as controls are not sent on the following tick.
+        if (i == 2)
+            layout.bytes[1] |= 1 << 7;
+        for (unsigned int j = 0; j < layout.channels; j++)
+            layout.bytes[2 + 2 * j] = (j < 4? j : j + 2 * (i > 0)) << 4;
+        layout.crc = Crc16::compute(layout.bytes, 2 + layout.channels * 2);
+        qToLittleEndian(layout.crc, layout.bytes + 2 + layout.channels * 2);
+    }
+}
+
+unsigned char const *ControlPacket::data(unsigned int slot) const
+{
+    int layout = slotLayout[reduced][slot % Slots];
+    return layout < 0? 0 : layouts[layout].bytes;
+}
+
+unsigned int ControlPacket::length(unsigned int slot) const
+{
+    int layout = slotLayout[reduced][slot % Slots];
+    return layout < 0? 0 : 4 + layouts[layout].channels * 2;
+}
+
+void ControlPacket::patch(Layout &layout, unsigned int position,
+                          unsigned int channel, int16_t value)
+{
+    unsigned char *bytes = layout.bytes + 2 + 2 * position;
+    unsigned char high = ((value >> 8) & 0x0F) | (channel << 4);
+    unsigned char low = value & 0xFF;
+    // Bytes following the low byte, up to the CRC.
+    unsigned int following = 2 * (layout.channels - position - 1);
+    layout.crc ^= contribution.table[following + 1][bytes[0] ^ high] ^
+            contribution.table[following][bytes[1] ^ low];
+    bytes[0] = high;
+    bytes[1] = low;
+    qToLittleEndian(layout.crc, layout.bytes + 2 + layout.channels * 2);
+}
+
+void ControlPacket::setChannel(unsigned int channel, int16_t value)
+{
+    if (channel >= Channels || values[channel] == value)
+        return;
+    values[channel] = value;
+    // Roll, pitch, throttle, and yaw are sent every time, shutter and ascent
+    // on even ticks, zoom, tilt and hold on odd ticks.
+    if (channel < 6)
+        patch(layouts[0], channel, channel, value);
+    if (channel < 4 || channel >= 6) {
+        unsigned int position = channel < 4? channel : channel - 2;
+        patch(layouts[1], position, channel, value);
+        patch(layouts[2], position, channel, value);
+    }
+    if (channel < 4)
+        patch(layouts[3], channel, channel, value);
+}
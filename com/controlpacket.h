@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+
+/// Zigbee control messages (type 0x07) for every tick of the five tick
+/// control cycle, kept complete and CRC'd so that a tick only has to copy
+/// one out.
+///
+/// The cycle only uses three layouts: six channels on even ticks, seven on
+/// odd ticks, and the seven channel layout flagged as the last before the
+/// skipped tick. A reduced cycle for poor links sends only roll, pitch,
+/// throttle and yaw on the middle two ticks, so the auxiliary channels go
+/// once a cycle rather than twice, if Vehicle::setReducedControls() allows.
+/// Changing a channel patches its two bytes in every layout carrying it and
+/// updates the CRC from the difference alone, as CRC-16 is linear in the
+/// message bits; unchanged channels cost nothing.
+class ControlPacket
+{
+public:
+    enum {
+        /// Channels carried, [roll, pitch, throttle, yaw, tilt, ascent,
+        /// hold, shutter, zoom] after mapping through txMap.
+        Channels = 9,
+
+        /// Longest message, seven channels.
+        MaxLength = 4 + 7 * 2,
+
+        /// Ticks per control cycle, the last of which is left free.
+        Slots = 5
+    };
+
+    /// Constructor, all channels are 0.
+    ControlPacket();
+
+    /// Message to send on a tick of the control cycle.
+    /// @return address of the message, or null for the skipped tick.
+    /// @param slot position in the control cycle, [0 -> 4].
+    unsigned char const *data(unsigned int slot) const;
+
+    /// Length of the message to send on a tick of the control cycle.
+    /// @return number of bytes, 0 for the skipped tick.
+    /// @param slot position in the control cycle, [0 -> 4].
+    unsigned int length(unsigned int slot) const;
+
+    /// Select the reduced cycle.
+    /// @param reduced true to send auxiliary channels once a cycle.
+    void setReduced(bool reduced) { this->reduced = reduced; }
+
+    /// Set a channel value in every layout carrying it.
+    /// @param channel channel index, [0 -> Channels).
+    /// @param value signed 12-bit channel value.
+    void setChannel(unsigned int channel,
+                    int16_t value);
+
+protected:
+    /// One of the message layouts.
+    struct Layout
+    {
+        /// Complete message including CRC.
+        unsigned char bytes[MaxLength];
+
+        /// CRC of bytes, not including the CRC itself.
+        uint16_t crc;
+
+        /// Number of channels carried.
+        unsigned int channels;
+    };
+
+    /// Write a channel into a layout, updating its CRC.
+    /// @param layout layout to patch.
+    /// @param position position of the channel in the layout.
+    /// @param channel channel index.
+    /// @param value signed 12-bit channel value.
+    static void patch(Layout &layout,
+                      unsigned int position,
+                      unsigned int channel,
+                      int16_t value);
+
+    /// Six channel layout, seven channel layout, seven channel layout
+    /// preceding the skipped tick, and four channel layout.
+    Layout layouts[4];
+
+    /// True if the reduced cycle is used.
+    bool reduced;
+
+    /// Current channel values.
+    int16_t values[Channels];
+};
@@ -0,0 +1,179 @@
+#include "controlscheduler.h"
+#include <QIODevice>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#define CONTROLSCHEDULER_HAVE_TIMERFD
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_UNIX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+ControlScheduler::ControlScheduler(QObject *parent) :
+    QObject(parent), active(false), clock(), lateness(Buckets, 0),
+    missed(0), next(0), notifier(0), period(20000000), timer(0),
+    timerFd(-1), worst(0)
+{
+    clock.start();
+}
+
+ControlScheduler::~ControlScheduler()
+{
+    stop();
+}
+
+void ControlScheduler::arm()
+{
+    // Round up, QTimer may otherwise fire just before the deadline.
+    int64_t remaining = next - now();
+    timer->start(remaining > 0? (int)((remaining + 999999) / 1000000) : 0);
+}
+
+void ControlScheduler::expire(uint64_t count)
+{
+    int64_t deadline = next + (int64_t)(count - 1) * period;
+    int64_t late = now() - deadline;
+    if (late < 0)
+        late = 0;
+    if (late > worst)
+        worst = late;
+    next += (int64_t)count * period;
+    missed += count - 1;
+
+    int bucket = 0;
+    for (int64_t us = late / 1000; us > 0 && bucket < Buckets - 1; us >>= 1)
+        bucket++;
+    lateness[bucket]++;
+
+    emit tick((int)(count - 1));
+}
+
+int64_t ControlScheduler::now() const
+{
+#ifdef CONTROLSCHEDULER_HAVE_TIMERFD
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return clock.nsecsElapsed();
+#endif
+}
+
+void ControlScheduler::onTimer()
+{
+    int64_t t = now();
+    if (t < next) {
+        // Woke early, go back to sleep for the remainder.
+        arm();
+        return;
+    }
+    expire((uint64_t)((t - next) / period) + 1);
+    arm();
+}
+
+void ControlScheduler::onTimerFd()
+{
+#ifdef CONTROLSCHEDULER_HAVE_TIMERFD
+    uint64_t count = 0;
+    if (read(timerFd, &count, sizeof(count)) != sizeof(count) || count == 0)
+        return;
+    expire(count);
+#endif
+}
+
+void ControlScheduler::resetHistogram()
+{
+    lateness.fill(0);
+    missed = 0;
+    worst = 0;
+}
+
+void ControlScheduler::setInterval(int microseconds)
+{
+    period = (int64_t)qMax(100, microseconds) * 1000;
+    if (active) {
+        stop();
+        start();
+    }
+}
+
+bool ControlScheduler::setPriority(int priority)
+{
+#ifdef Q_OS_UNIX
+    sched_param param;
+    param.sched_priority = qMax(0, priority);
+    return pthread_setschedparam(pthread_self(),
+                                 priority > 0? SCHED_FIFO : SCHED_OTHER,
+                                 &param) == 0;
+#else
+    Q_UNUSED(priority);
+    return false;
+#endif
+}
+
+void ControlScheduler::start()
+{
+    if (active)
+        return;
+    active = true;
+    next = now() + period;
+    // Notifiers and timers are created here rather than in the constructor so
+    // that they belong to whichever thread the scheduler has been moved to.
+#ifdef CONTROLSCHEDULER_HAVE_TIMERFD
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd >= 0) {
+        itimerspec spec;
+        spec.it_value.tv_sec = next / 1000000000;
+        spec.it_value.tv_nsec = next % 1000000000;
+        spec.it_interval.tv_sec = period / 1000000000;
+        spec.it_interval.tv_nsec = period % 1000000000;
+        if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, 0) == 0) {
+            notifier = new QSocketNotifier(timerFd, QSocketNotifier::Read,
+                                           this);
+            connect(notifier, SIGNAL(activated(int)),
+                    this, SLOT(onTimerFd()));
+            return;
+        }
+        close(timerFd);
+        timerFd = -1;
+    }
+#endif
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()),
+            this, SLOT(onTimer()));
+    arm();
+}
+
+void ControlScheduler::stop()
+{
+    active = false;
+    delete notifier;
+    notifier = 0;
+    delete timer;
+    timer = 0;
+#ifdef CONTROLSCHEDULER_HAVE_TIMERFD
+    if (timerFd >= 0)
+        close(timerFd);
+#endif
+    timerFd = -1;
+}
+
+bool ControlScheduler::writeHistogram(QIODevice *device) const
+{
+    QByteArray csv("upper_us,count\n");
+    for (int i = 0; i < Buckets; i++) {
+        if (i < Buckets - 1)
+            csv += QByteArray::number(1 << i);
+        csv += ',';
+        csv += QByteArray::number(lateness[i]);
+        csv += '\n';
+    }
+    return device->write(csv) == csv.size();
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <stdint.h>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QVector>
+
+class QIODevice;
+class QSocketNotifier;
+class QTimer;
+
+/// Periodic tick source for control output with absolute deadlines.
+///
+/// Deadlines are multiples of the period from the moment start() was called,
+/// on CLOCK_MONOTONIC, so late ticks never push later ones back and the rate
+/// does not drift. On Linux a timerfd armed with an absolute expiry drives the
+/// ticks, elsewhere a single-shot QTimer is re-armed for the time remaining to
+/// each deadline.<BR>
+/// Every tick records how late it fired in a histogram, which can be written
+/// out with writeHistogram().
+class ControlScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    /// Number of histogram buckets.
+    ///
+    /// Bucket 0 counts ticks less than 1 us late, bucket i counts ticks
+    /// [2^(i-1), 2^i) us late and the last bucket counts everything later.
+    enum { Buckets = 18 };
+
+    /// Constructor.
+    explicit ControlScheduler(QObject *parent = 0);
+
+    /// Destructor.
+    ~ControlScheduler();
+
+    /// Get lateness histogram.
+    /// @return tick counts per bucket, see ControlScheduler::Buckets.
+    QVector<quint64> histogram() const { return lateness; }
+
+    /// Get the period between ticks.
+    /// @return period in microseconds.
+    int interval() const { return period / 1000; }
+
+    /// Check whether ticks are being generated.
+    /// @return true between start() and stop().
+    bool isActive() const { return active; }
+
+    /// Get the largest lateness seen.
+    /// @return lateness in microseconds.
+    int maxLateness() const { return worst / 1000; }
+
+    /// Get number of deadlines which passed without a tick.
+    ///
+    /// Happens when the owning thread is blocked for more than a period.
+    /// @return total since the histogram was last reset.
+    quint64 missedCount() const { return missed; }
+
+    /// Write the lateness histogram as CSV.
+    ///
+    /// A header line "upper_us,count", then one line per bucket of the form
+    /// "upper bound in us,count", the upper bound of the last bucket is left
+    /// empty.
+    /// @return false if the device could not be written.
+    /// @param device open device to write to.
+    bool writeHistogram(QIODevice *device) const;
+
+signals:
+    /// Emitted once per deadline.
+    /// @param skipped number of deadlines missed since the previous tick.
+    void tick(int skipped);
+
+public slots:
+    /// Clear the lateness histogram, missed count and maximum.
+    void resetHistogram();
+
+    /// Set the period between ticks, takes effect immediately if active.
+    /// @param microseconds period, at least 100.
+    void setInterval(int microseconds);
+
+    /// Run the owning thread with SCHED_FIFO priority.
+    ///
+    /// Applies to whichever thread the scheduler lives in, so it is intended
+    /// for schedulers running on a dedicated I/O thread. Needs CAP_SYS_NICE or
+    /// a suitable RLIMIT_RTPRIO.
+    /// @return false if the priority could not be set.
+    /// @param priority SCHED_FIFO priority, or 0 to return to SCHED_OTHER.
+    bool setPriority(int priority);
+
+    /// Set the tick rate, takes effect immediately if active.
+    /// @param hz ticks per second.
+    void setRate(int hz) { setInterval(1000000 / qMax(1, hz)); }
+
+    /// Begin generating ticks, the first deadline is one period from now.
+    void start();
+
+    /// Stop generating ticks.
+    void stop();
+
+protected:
+    /// Arm the fallback timer for the next deadline.
+    void arm();
+
+    /// Current time on the monotonic clock.
+    /// @return nanoseconds since an unspecified epoch.
+    int64_t now() const;
+
+    /// Account for expirations and emit tick().
+    /// @param count number of deadlines which have passed.
+    void expire(uint64_t count);
+
+    /// True between start() and stop().
+    bool active;
+
+    /// Monotonic clock for the fallback timer.
+    QElapsedTimer clock;
+
+    /// Lateness histogram, see ControlScheduler::Buckets.
+    QVector<quint64> lateness;
+
+    /// Deadlines which passed without a tick.
+    quint64 missed;
+
+    /// Next deadline in nanoseconds on the monotonic clock.
+    int64_t next;
+
+    /// Watches timerFd, null when falling back to timer.
+    QSocketNotifier *notifier;
+
+    /// Period between ticks in nanoseconds.
+    int64_t period;
+
+    /// Fallback single-shot timer, null when using timerFd.
+    QTimer *timer;
+
+    /// timerfd descriptor, or -1.
+    int timerFd;
+
+    /// Largest lateness in nanoseconds.
+    int64_t worst;
+
+protected slots:
+    /// Handle expiry of the fallback timer.
+    void onTimer();
+
+    /// Handle expiry of timerFd.
+    void onTimerFd();
+};
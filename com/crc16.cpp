@@ -0,0 +1,179 @@
+#define __STDC_CONSTANT_MACROS
+#include "crc16.h"
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#define CRC16_HAVE_CLMUL
+#endif
+
+uint16_t const Crc16::lookup[256] = {
+    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+    0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+    0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+    0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+    0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+    0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+    0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+    0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+    0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+    0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+    0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+    0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+    0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+    0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+    0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+    0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+    0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+    0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+    0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+    0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+    0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+    0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+    0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+    0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+    0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+    0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+    0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+    0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040,
+};
+
+namespace {
+/// Slicing-by-8 tables, slice[k][n] is the register after shifting the byte n
+/// followed by k zero bytes through an empty register.
+struct SliceTables
+{
+    SliceTables()
+    {
+        for (int n = 0; n < 256; n++) {
+            slice[0][n] = Crc16::lookup[n];
+            for (int k = 1; k < 8; k++)
+                slice[k][n] = (slice[k - 1][n] >> 8) ^
+                        Crc16::lookup[slice[k - 1][n] & 0xFF];
+        }
+    }
+    uint16_t slice[8][256];
+};
+
+SliceTables const &sliceTables()
+{
+    static SliceTables const tables;
+    return tables;
+}
+
+uint64_t load64(unsigned char const *data)
+{
+    // Assemble explicitly so the result is independent of host byte order.
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--)
+        value = (value << 8) | data[i];
+    return value;
+}
+
+#ifdef CRC16_HAVE_CLMUL
+/// Bit-reflected low 64 bits of floor(x^80 / P), P = x^16 + x^15 + x^2 + 1.
+uint64_t const barrettMu = UINT64_C(0xF87FF5FFE7FFDFFF);
+
+/// Bit-reflected P without its x^16 term.
+uint64_t const barrettPoly = UINT64_C(0xA001);
+
+__attribute__((target("pclmul,sse2")))
+uint16_t clmulBlocks(uint16_t crc, unsigned char const *data,
+                     unsigned int blocks)
+{
+    __m128i const mu = _mm_cvtsi64_si128(barrettMu);
+    __m128i const poly = _mm_cvtsi64_si128(barrettPoly);
+    for (unsigned int i = 0; i < blocks; i++, data += 8) {
+        // Shifting eight bytes through the register is T(x).x^16 mod P where
+        // T is the block with the register folded into its first two bytes.
+        uint64_t t = load64(data) ^ crc;
+        uint64_t p = _mm_cvtsi128_si64(_mm_clmulepi64_si128(
+                _mm_cvtsi64_si128(t), mu, 0x00));
+        uint64_t q = ((t >> 48) ^ (p >> 47)) & 0xFFFF;
+        uint64_t r = _mm_cvtsi128_si64(_mm_clmulepi64_si128(
+                _mm_cvtsi64_si128(q), poly, 0x00));
+        crc = (r >> 15) & 0xFFFF;
+    }
+    return crc;
+}
+#endif
+}
+
+uint16_t Crc16::bitwise(unsigned char const *data, unsigned int length)
+{
+    uint16_t crc = Initial;
+    bool carry;
+    for (unsigned int i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int j = 0; j < 8; j++) {
+            carry = crc & 0x1;
+            crc >>= 1;
+            if (carry)
+                crc ^= 0xA001U;
+        }
+    }
+    return crc;
+}
+
+uint16_t Crc16::clmul(unsigned char const *data, unsigned int length)
+{
+#ifdef CRC16_HAVE_CLMUL
+    if (hasClmul()) {
+        uint16_t crc = clmulBlocks(Initial, data, length >> 3);
+        return update(crc, data + (length & ~7U), length & 7U);
+    }
+#endif
+    return slicing8(data, length);
+}
+
+uint16_t Crc16::compute(unsigned char const *data, unsigned int length)
+{
+    // Below 8 bytes slicing8 would only run its byte-wise tail. clmul is
+    // not used: each of its steps waits on two dependent multiplies, which
+    // left it at about half the speed of slicing8 from 16 bytes to 1 KB
+    // (bench Crc16::*/4 to /1024).
+    if (length < 8)
+        return update(Initial, data, length);
+    return slicing8(data, length);
+}
+
+bool Crc16::hasClmul()
+{
+#ifdef CRC16_HAVE_CLMUL
+    static bool const supported = __builtin_cpu_supports("pclmul");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+uint16_t Crc16::slicing8(unsigned char const *data, unsigned int length)
+{
+    uint16_t const (*slice)[256] = sliceTables().slice;
+    uint16_t crc = Initial;
+    for (; length >= 8; length -= 8, data += 8) {
+        // The register only overlaps the first two bytes of each block.
+        crc = slice[7][(data[0] ^ crc) & 0xFF] ^
+              slice[6][(data[1] ^ (crc >> 8)) & 0xFF] ^
+              slice[5][data[2]] ^ slice[4][data[3]] ^
+              slice[3][data[4]] ^ slice[2][data[5]] ^
+              slice[1][data[6]] ^ slice[0][data[7]];
+    }
+    return update(crc, data, length);
+}
+
+uint16_t Crc16::table(unsigned char const *data, unsigned int length)
+{
+    return update(Initial, data, length);
+}
+
+uint16_t Crc16::update(uint16_t crc, unsigned char const *data,
+                       unsigned int length)
+{
+    for (unsigned int i = 0; i < length; i++)
+        crc = (crc >> 8) ^ lookup[(crc ^ data[i]) & 0xFF];
+    return crc;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+
+/// CRC-16-ANSI (reflected polynomial 0xA001, initial value 0xFFFF) as used
+/// to terminate all Draganflyer API messages.
+///
+/// Several interchangeable implementations are provided, all of which produce
+/// results identical to Crc16::bitwise(). Crc16::compute() picks the fastest
+/// one for the message length and the CPU it is running on.
+class Crc16
+{
+public:
+    /// Value the CRC register is seeded with.
+    enum { Initial = 0xFFFF };
+
+    /// Reference implementation, one bit per iteration.
+    /// @return CRC-16-ANSI.
+    /// @param data address of the first byte to include in the CRC.
+    /// @param length total number of bytes to include in the CRC.
+    static uint16_t bitwise(unsigned char const *data, unsigned int length);
+
+    /// Carry-less multiply (PCLMULQDQ) implementation, eight bytes per
+    /// Barrett reduction.
+    ///
+    /// Falls back to Crc16::slicing8() where PCLMULQDQ is not available.
+    /// @return CRC-16-ANSI.
+    /// @param data address of the first byte to include in the CRC.
+    /// @param length total number of bytes to include in the CRC.
+    static uint16_t clmul(unsigned char const *data, unsigned int length);
+
+    /// Use the fastest available implementation.
+    /// @return CRC-16-ANSI.
+    /// @param data address of the first byte to include in the CRC.
+    /// @param length total number of bytes to include in the CRC.
+    static uint16_t compute(unsigned char const *data, unsigned int length);
+
+    /// Check whether the CPU supports PCLMULQDQ, determined once by CPUID.
+    /// @return true if Crc16::clmul() is hardware accelerated.
+    static bool hasClmul();
+
+    /// Slicing-by-8 implementation, eight table lookups per eight bytes.
+    /// @return CRC-16-ANSI.
+    /// @param data address of the first byte to include in the CRC.
+    /// @param length total number of bytes to include in the CRC.
+    static uint16_t slicing8(unsigned char const *data, unsigned int length);
+
+    /// Byte-wise table-driven implementation.
+    /// @return CRC-16-ANSI.
+    /// @param data address of the first byte to include in the CRC.
+    /// @param length total number of bytes to include in the CRC.
+    static uint16_t table(unsigned char const *data, unsigned int length);
+
+    /// Continue a CRC over further bytes, one table lookup per byte.
+    /// @return updated CRC register.
+    /// @param crc current CRC register, Crc16::Initial for a new message.
+    /// @param data address of the first byte to include in the CRC.
+    /// @param length total number of bytes to include in the CRC.
+    static uint16_t update(uint16_t crc, unsigned char const *data,
+                           unsigned int length);
+
+    /// Byte-wise lookup table, entry n is the CRC register after shifting
+    /// the byte n through an empty register.
+    static uint16_t const lookup[256];
+};
@@ -0,0 +1,71 @@
+#include "framebuffer.h"
+#include <string.h>
+
+FrameBuffer::FrameBuffer() :
+    readPos(0), size(0)
+{
+}
+
+void FrameBuffer::append(char const *data, int length)
+{
+    if (length <= 0)
+        return;
+    if (length >= Capacity) {
+        // Only the newest Capacity bytes can be kept.
+        data += length - Capacity;
+        length = Capacity;
+        clear();
+    } else if (length > space()) {
+        consume(length - space());
+    }
+    int writePos = readPos + size;
+    if (writePos >= Capacity)
+        writePos -= Capacity;
+    int first = Capacity - writePos;
+    if (first > length)
+        first = length;
+    // Write both copies so unread bytes are contiguous wherever they start.
+    memcpy(storage + writePos, data, first);
+    memcpy(storage + writePos + Capacity, data, first);
+    if (length > first) {
+        memcpy(storage, data + first, length - first);
+        memcpy(storage + Capacity, data + first, length - first);
+    }
+    size += length;
+}
+
+void FrameBuffer::clear()
+{
+    readPos = 0;
+    size = 0;
+}
+
+void FrameBuffer::consume(int count)
+{
+    if (count >= size) {
+        clear();
+        return;
+    }
+    readPos += count;
+    if (readPos >= Capacity)
+        readPos -= Capacity;
+    size -= count;
+}
+
+int FrameBuffer::indexOf(unsigned char delimiter, int from) const
+{
+    if (from >= size)
+        return -1;
+    void const *found = memchr(data() + from, delimiter, size - from);
+    return found? (int)((unsigned char const *)found - data()) : -1;
+}
+
+int FrameBuffer::indexOfAny(unsigned char first, unsigned char second,
+                            int from) const
+{
+    unsigned char const *bytes = data();
+    for (int i = from; i < size; i++)
+        if (bytes[i] == first || bytes[i] == second)
+            return i;
+    return -1;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+
+/// Fixed-capacity byte ring used to reassemble messages from a serial stream.
+///
+/// Every byte is stored twice, Capacity bytes apart, so that the unread bytes
+/// can always be inspected as one contiguous span starting at data().<BR>
+/// Consuming bytes only advances the read cursor, nothing is ever moved.<BR>
+/// If more bytes are appended than there is room for the oldest unread bytes
+/// are discarded, which can only happen if the stream is garbage anyway.
+class FrameBuffer
+{
+public:
+    /// Maximum number of unread bytes held at any time.
+    ///
+    /// Comfortably larger than the longest message (206 bytes wired, 99 bytes
+    /// XBee) so a complete message always fits behind any amount of noise.
+    enum { Capacity = 4096 };
+
+    /// Constructor.
+    FrameBuffer();
+
+    /// Append bytes to the write end of the buffer.
+    /// @param data bytes to append.
+    /// @param length number of bytes to append.
+    void append(char const *data, int length);
+
+    /// Discard all unread bytes.
+    void clear();
+
+    /// Discard bytes from the read end of the buffer.
+    /// @param count number of bytes to discard, clamped to length().
+    void consume(int count);
+
+    /// Contiguous span of all unread bytes, valid until the next append().
+    /// @return address of the oldest unread byte.
+    unsigned char const *data() const { return storage + readPos; }
+
+    /// Find a delimiter in the unread bytes.
+    /// @return offset of the first match at or after from, or -1.
+    /// @param delimiter byte to search for.
+    /// @param from offset to start searching at.
+    int indexOf(unsigned char delimiter, int from = 0) const;
+
+    /// Find either of two delimiters in the unread bytes.
+    /// @return offset of the first match at or after from, or -1.
+    /// @param first byte to search for.
+    /// @param second other byte to search for.
+    /// @param from offset to start searching at.
+    int indexOfAny(unsigned char first, unsigned char second,
+                   int from = 0) const;
+
+    /// Get number of unread bytes.
+    /// @return number of bytes between the read and write cursors.
+    int length() const { return size; }
+
+    /// Get number of bytes which can be appended without discarding any.
+    /// @return Capacity - length().
+    int space() const { return Capacity - size; }
+
+protected:
+    /// Read cursor, always in the range [0, Capacity).
+    int readPos;
+
+    /// Number of unread bytes following the read cursor.
+    int size;
+
+    /// Twice-mirrored ring storage.
+    unsigned char storage[2 * Capacity];
+};
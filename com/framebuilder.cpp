@@ -0,0 +1,62 @@
+#include "framebuilder.h"
+#include <string.h>
+#include <QtEndian>
+
+FrameBuilder::FrameBuilder() :
+    saved(0), trailer(0)
+{
+}
+
+unsigned char const *FrameBuilder::atCommand(uint8_t frameId,
+                                             char const *command,
+                                             unsigned char const *parameter,
+                                             unsigned int length)
+{
+    trailer = 0;
+    if (length > Capacity)
+        length = Capacity;
+    bytes[0] = 0x7E;
+    qToBigEndian<uint16_t>(length + 4, bytes + 1);
+    bytes[3] = 0x08; // AT command
+    bytes[4] = frameId;
+    bytes[5] = command[0];
+    bytes[6] = command[1];
+    if (length)
+        memcpy(bytes + 7, parameter, length);
+    bytes[7 + length] = checksum(bytes + 3, length + 4);
+    return bytes;
+}
+
+unsigned char *FrameBuilder::begin()
+{
+    trailer = 0;
+    return message();
+}
+
+unsigned char FrameBuilder::checksum(unsigned char const *data,
+                                     unsigned int length)
+{
+    unsigned char sum = 0;
+    for (unsigned int i = 0; i < length; i++)
+        sum += data[i];
+    return 0xFFU - sum;
+}
+
+unsigned char const *FrameBuilder::wrap(unsigned int offset,
+                                        unsigned int length,
+                                        uint64_t destination)
+{
+    if (trailer)
+        *trailer = saved;
+    unsigned char *frame = message() + offset - Header;
+    qToBigEndian<uint16_t>(length + 11, frame + 1);
+    frame[0] = 0x7E;
+    frame[3] = 0x00; // 64-bit addressed transmit
+    frame[4] = 0x00; // Frame #, unused
+    qToBigEndian<uint64_t>(destination, frame + 5);
+    frame[13] = 0x01; // Options, sp. 'no ack'
+    trailer = frame + Header + length;
+    saved = *trailer;
+    *trailer = checksum(frame + 3, length + 11);
+    return frame;
+}
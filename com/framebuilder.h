@@ -0,0 +1,83 @@
+#pragma once
+#include <stdint.h>
+
+/// Fixed buffer in which outgoing messages and their XBee wrappers are
+/// composed in place.
+///
+/// A message is written at message(), which is preceded by room for the XBee
+/// transmit header, so wrapping it neither moves nor copies it and the
+/// finished frame can be handed to the port in a single write.<BR>
+/// Messages longer than one XBee packet are wrapped a fragment at a time,
+/// each fragment's header overwriting the tail of the fragment sent before
+/// it.<BR>
+/// A Vehicle owns one builder and reuses it for every frame, so sending
+/// never touches the heap.
+class FrameBuilder
+{
+public:
+    enum {
+        /// Longest message which can be composed (a padded wired message
+        /// with the largest payload the API allows).
+        Capacity = 1024,
+
+        /// Most message bytes carried by one XBee packet.
+        Fragment = 85,
+
+        /// Bytes of XBee 64-bit addressed transmit header.
+        Header = 14
+    };
+
+    /// Constructor.
+    FrameBuilder();
+
+    /// Compose a XBee AT command frame.
+    ///
+    /// Discards any message being composed.
+    /// @return address of the frame, which is length + 8 bytes long.
+    /// @param frameId frame number echoed in the response, 0 for none.
+    /// @param command two character command name, e.g. "CH".
+    /// @param parameter command parameter bytes, may be null if length is 0.
+    /// @param length number of parameter bytes, at most Capacity.
+    unsigned char const *atCommand(uint8_t frameId,
+                                   char const *command,
+                                   unsigned char const *parameter,
+                                   unsigned int length);
+
+    /// Start composing a message.
+    /// @return message(), Capacity bytes are available.
+    unsigned char *begin();
+
+    /// Generate or verify the checksum byte which terminates all XBee packets.
+    /// @return complement of the sum modulo 2^8.
+    /// @param data address of first byte to include in checksum.
+    /// @param length total number of bytes to include in checksum.
+    static unsigned char checksum(unsigned char const *data,
+                                  unsigned int length);
+
+    /// Message being composed.
+    /// @return address of the first byte of the message.
+    unsigned char *message() { return bytes + Header; }
+
+    /// Wrap part of the message in a XBee 64-bit addressed transmit frame.
+    ///
+    /// The byte following the part is replaced by the frame checksum until
+    /// the next call to wrap(), so the parts of a message must be wrapped in
+    /// order, each being written out before the next is wrapped.
+    /// @return address of the frame, which is length + 15 bytes long.
+    /// @param offset offset of the part in the message.
+    /// @param length length of the part, at most Fragment.
+    /// @param destination MAC address of recipient.
+    unsigned char const *wrap(unsigned int offset,
+                              unsigned int length,
+                              uint64_t destination);
+
+protected:
+    /// Header room, message, and one spare byte for the last checksum.
+    unsigned char bytes[Header + Capacity + 1];
+
+    /// Original value of the byte overwritten by the last checksum.
+    unsigned char saved;
+
+    /// Byte overwritten by the last checksum, or null.
+    unsigned char *trailer;
+};
@@ -0,0 +1,203 @@
+#include "hexformat.h"
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#include <tmmintrin.h>
+#define HEXFORMAT_HAVE_SIMD
+#endif
+
+namespace {
+/// Digit of each nibble, also the byte shuffle table of the SIMD variants.
+char const digits[] = "0123456789ABCDEF";
+
+#ifdef HEXFORMAT_HAVE_SIMD
+/// Digit pair each character of the three runs of sixteen characters of a
+/// spaced block of sixteen bytes is taken from, -128 for a space. Indices
+/// count from digit pair 0, 11 and 16 respectively (see spread()).
+signed char const runs[3][16] = {
+    { 0, 1, -128, 2, 3, -128, 4, 5, -128, 6, 7, -128, 8, 9, -128, 10 },
+    { 0, -128, 1, 2, -128, 3, 4, -128, 5, 6, -128, 7, 8, -128, 9, 10 },
+    { -128, 6, 7, -128, 8, 9, -128, 10, 11, -128, 12, 13, -128, 14, 15, -128 }
+};
+
+/// Shuffles and spaces for spread().
+struct Spacing
+{
+    __m128i run[3];    ///< runs as vectors.
+    __m128i space[3];  ///< A space where run is -128, else 0.
+};
+
+__attribute__((target("ssse3")))
+inline Spacing spacing()
+{
+    Spacing result;
+    for (int i = 0; i < 3; i++) {
+        result.run[i] = _mm_loadu_si128((__m128i const *)runs[i]);
+        result.space[i] = _mm_and_si128(
+                    _mm_cmplt_epi8(result.run[i], _mm_setzero_si128()),
+                    _mm_set1_epi8(' '));
+    }
+    return result;
+}
+
+/// Write the digit pairs of sixteen bytes as forty-eight characters, each
+/// pair followed by a space.
+/// @param first digit pairs of bytes 0 to 7.
+/// @param second digit pairs of bytes 8 to 15.
+__attribute__((target("ssse3")))
+inline void spread(__m128i first, __m128i second, Spacing const &spacing,
+                   char *out)
+{
+    __m128i middle = _mm_alignr_epi8(second, first, 11);
+    _mm_storeu_si128((__m128i *)out, _mm_or_si128(
+                         _mm_shuffle_epi8(first, spacing.run[0]),
+                         spacing.space[0]));
+    _mm_storeu_si128((__m128i *)(out + 16), _mm_or_si128(
+                         _mm_shuffle_epi8(middle, spacing.run[1]),
+                         spacing.space[1]));
+    _mm_storeu_si128((__m128i *)(out + 32), _mm_or_si128(
+                         _mm_shuffle_epi8(second, spacing.run[2]),
+                         spacing.space[2]));
+}
+
+/// Format whole blocks of sixteen bytes.
+/// @return bytes formatted, the rest is left to the caller.
+__attribute__((target("ssse3")))
+int ssse3Blocks(unsigned char const *data, int length, char *out,
+                bool spaced)
+{
+    __m128i const table = _mm_loadu_si128((__m128i const *)digits);
+    __m128i const nibble = _mm_set1_epi8(0x0F);
+    Spacing const layout = spacing();
+    int done = 0;
+    // A spaced block ends in a space, which is only wanted if more follows.
+    for (; length - done > (spaced? 16 : 15); done += 16) {
+        __m128i bytes = _mm_loadu_si128((__m128i const *)(data + done));
+        __m128i high = _mm_shuffle_epi8(
+                    table, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+        __m128i low = _mm_shuffle_epi8(table, _mm_and_si128(bytes, nibble));
+        __m128i first = _mm_unpacklo_epi8(high, low);
+        __m128i second = _mm_unpackhi_epi8(high, low);
+        if (spaced) {
+            spread(first, second, layout, out + 3 * done);
+        } else {
+            _mm_storeu_si128((__m128i *)(out + 2 * done), first);
+            _mm_storeu_si128((__m128i *)(out + 2 * done + 16), second);
+        }
+    }
+    return done;
+}
+
+/// Format whole blocks of thirty-two bytes.
+/// @return bytes formatted, the rest is left to the caller.
+__attribute__((target("avx2")))
+int avx2Blocks(unsigned char const *data, int length, char *out, bool spaced)
+{
+    __m256i const table = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128((__m128i const *)digits));
+    __m256i const nibble = _mm256_set1_epi8(0x0F);
+    Spacing const layout = spacing();
+    int done = 0;
+    for (; length - done > (spaced? 32 : 31); done += 32) {
+        __m256i bytes = _mm256_loadu_si256((__m256i const *)(data + done));
+        __m256i high = _mm256_shuffle_epi8(
+                    table,
+                    _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+        __m256i low = _mm256_shuffle_epi8(
+                    table, _mm256_and_si256(bytes, nibble));
+        // Unpacking works within each half, put the pairs back in order.
+        __m256i a = _mm256_unpacklo_epi8(high, low);
+        __m256i b = _mm256_unpackhi_epi8(high, low);
+        __m256i first = _mm256_permute2x128_si256(a, b, 0x20);
+        __m256i second = _mm256_permute2x128_si256(a, b, 0x31);
+        if (spaced) {
+            spread(_mm256_castsi256_si128(first),
+                   _mm256_extracti128_si256(first, 1), layout,
+                   out + 3 * done);
+            spread(_mm256_castsi256_si128(second),
+                   _mm256_extracti128_si256(second, 1), layout,
+                   out + 3 * done + 48);
+        } else {
+            _mm256_storeu_si256((__m256i *)(out + 2 * done), first);
+            _mm256_storeu_si256((__m256i *)(out + 2 * done + 32), second);
+        }
+    }
+    return done;
+}
+#endif
+}
+
+void HexFormat::avx2(unsigned char const *data, int length, char *out,
+                     bool spaced)
+{
+#ifdef HEXFORMAT_HAVE_SIMD
+    if (hasAvx2()) {
+        int done = avx2Blocks(data, length, out, spaced);
+        ssse3(data + done, length - done, out + (spaced? 3 : 2) * done,
+              spaced);
+        return;
+    }
+#endif
+    ssse3(data, length, out, spaced);
+}
+
+void HexFormat::format(unsigned char const *data, int length, char *out,
+                       bool spaced)
+{
+    // Below a block the set-up cost of the wide variants is not recovered.
+    if (length < 16)
+        scalar(data, length, out, spaced);
+    else
+        avx2(data, length, out, spaced);
+}
+
+void HexFormat::format(QByteArray const &data, QByteArray &out, bool spaced)
+{
+    out.resize(length(data.length(), spaced));
+    format((unsigned char const *)data.constData(), data.length(),
+           out.data(), spaced);
+}
+
+bool HexFormat::hasAvx2()
+{
+#ifdef HEXFORMAT_HAVE_SIMD
+    static bool const supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+bool HexFormat::hasSsse3()
+{
+#ifdef HEXFORMAT_HAVE_SIMD
+    static bool const supported = __builtin_cpu_supports("ssse3");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void HexFormat::scalar(unsigned char const *data, int length, char *out,
+                       bool spaced)
+{
+    for (int i = 0; i < length; i++) {
+        if (spaced && i)
+            *out++ = ' ';
+        *out++ = digits[data[i] >> 4];
+        *out++ = digits[data[i] & 0x0F];
+    }
+}
+
+void HexFormat::ssse3(unsigned char const *data, int length, char *out,
+                      bool spaced)
+{
+#ifdef HEXFORMAT_HAVE_SIMD
+    if (hasSsse3()) {
+        int done = ssse3Blocks(data, length, out, spaced);
+        scalar(data + done, length - done, out + (spaced? 3 : 2) * done,
+               spaced);
+        return;
+    }
+#endif
+    scalar(data, length, out, spaced);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <QByteArray>
+
+/// Formats bytes as uppercase hex, either plain ("0A1B") or with a space
+/// between bytes ("0A 1B"), as shown by the monitor and written to the text
+/// logs.
+///
+/// Several interchangeable implementations are provided, all of which
+/// produce output identical to HexFormat::scalar(). HexFormat::format()
+/// picks the fastest one for the CPU it is running on. The SIMD variants
+/// look up the digits of sixteen or thirty-two bytes at a time with one
+/// byte shuffle per nibble and place them, spaces included, with a further
+/// shuffle per sixteen output characters.
+class HexFormat
+{
+public:
+    /// AVX2 implementation, thirty-two bytes per iteration.
+    ///
+    /// Falls back to HexFormat::ssse3() where AVX2 is not available.
+    /// @param data first byte to format.
+    /// @param length number of bytes to format.
+    /// @param out receives length(length, spaced) characters.
+    /// @param spaced true for a space between bytes.
+    static void avx2(unsigned char const *data, int length, char *out,
+                     bool spaced);
+
+    /// Use the fastest available implementation.
+    /// @param data first byte to format.
+    /// @param length number of bytes to format.
+    /// @param out receives length(length, spaced) characters.
+    /// @param spaced true for a space between bytes.
+    static void format(unsigned char const *data, int length, char *out,
+                       bool spaced);
+
+    /// Format into a buffer which is reused from call to call.
+    /// @param data bytes to format.
+    /// @param out resized to fit and overwritten, so a buffer kept from call
+    /// to call is seldom reallocated.
+    /// @param spaced true for a space between bytes.
+    static void format(QByteArray const &data, QByteArray &out,
+                       bool spaced);
+
+    /// Check whether the CPU supports AVX2, determined once by CPUID.
+    static bool hasAvx2();
+
+    /// Check whether the CPU supports SSSE3, determined once by CPUID.
+    static bool hasSsse3();
+
+    /// Get the length of the formatted text.
+    /// @return characters format() writes.
+    /// @param bytes number of bytes to format.
+    /// @param spaced true for a space between bytes.
+    static int length(int bytes, bool spaced)
+    {
+        return spaced? (bytes > 0? 3 * bytes - 1 : 0) : 2 * bytes;
+    }
+
+    /// Reference implementation, one table lookup per nibble.
+    /// @param data first byte to format.
+    /// @param length number of bytes to format.
+    /// @param out receives length(length, spaced) characters.
+    /// @param spaced true for a space between bytes.
+    static void scalar(unsigned char const *data, int length, char *out,
+                       bool spaced);
+
+    /// SSSE3 implementation, sixteen bytes per iteration.
+    ///
+    /// Falls back to HexFormat::scalar() where SSSE3 is not available.
+    /// @param data first byte to format.
+    /// @param length number of bytes to format.
+    /// @param out receives length(length, spaced) characters.
+    /// @param spaced true for a space between bytes.
+    static void ssse3(unsigned char const *data, int length, char *out,
+                      bool spaced);
+};
@@ -0,0 +1,154 @@
+#include "messagehistory.h"
+#include <string.h>
+#include <QtAlgorithms>
+
+MessageHistory::MessageHistory() :
+    log()
+{
+    for (int i = 0; i < 2; i++) {
+        directions[i].arena = QByteArray(Window * Slot, 0);
+        directions[i].count = 0;
+        directions[i].lengths = QVector<quint16>(Window, 0);
+        directions[i].positions = QVector<qint64>(Window, -1);
+        directions[i].trimmed = 0;
+    }
+}
+
+void MessageHistory::append(QByteArray const &message, bool incoming)
+{
+    Direction &direction = directions[incoming];
+    qint64 position = log.append(message, incoming);
+    if (direction.count % Stride == 0) {
+        // Drop the oldest half at a time, so that moving the rest down is
+        // paid for once every Marks strides.
+        if (direction.strides.size() == 2 * Marks) {
+            direction.strides.remove(0, Marks);
+            direction.trimmed += Marks;
+            int first = direction.strides.first().index;
+            int stale = 0;
+            while (stale < direction.unlogged.size() &&
+                   direction.unlogged.at(stale) < first)
+                stale++;
+            direction.unlogged.remove(0, stale);
+        }
+        Mark mark = { direction.count, -1 };
+        direction.strides.append(mark);
+    }
+    // Scans start from the first message of a Stride the log took, later
+    // ones it dropped are noted so that the scan does not count them.
+    Mark &mark = direction.strides.last();
+    if (mark.position < 0 && position >= 0) {
+        mark.index = direction.count;
+        mark.position = position;
+    } else if (mark.position >= 0 && position < 0) {
+        direction.unlogged.append(direction.count);
+    }
+    int slot = direction.count % Window;
+    int length = qMin(message.length(), 0xFFFF);
+    direction.lengths[slot] = length;
+    direction.positions[slot] = position;
+    memcpy(direction.arena.data() + slot * Slot, message.constData(),
+           qMin<int>(length, Slot));
+    direction.count++;
+}
+
+QByteArray MessageHistory::at(int index, bool incoming)
+{
+    Direction const &direction = directions[incoming];
+    if (index < 0 || index >= direction.count)
+        return QByteArray();
+    if (index < direction.count - Window) {
+        QByteArray message;
+        read(locate(index, 1, incoming), &message);
+        return message;
+    }
+    int slot = index % Window;
+    if (direction.lengths[slot] > Slot) {
+        qint64 offset = log.find(direction.positions[slot]);
+        return log.read(offset);
+    }
+    return QByteArray(direction.arena.constData() + slot * Slot,
+                      direction.lengths[slot]);
+}
+
+MessageHistory::Run MessageHistory::locate(int first, int count,
+                                           bool incoming) const
+{
+    Direction const &direction = directions[incoming];
+    Run run;
+    run.first = qMax(first, 0);
+    run.count = qMax(qMin(first + count, direction.count) - run.first, 0);
+    run.incoming = incoming;
+    run.position = -1;
+    run.start = run.first;
+    int end = run.first + run.count;
+    // Scan from the first mark in the run, anything before it was not
+    // logged or is no longer indexed.
+    int stride = qMax(run.first / Stride - direction.trimmed, 0);
+    for (; stride < direction.strides.size(); stride++) {
+        Mark const &mark = direction.strides.at(stride);
+        if (mark.index >= end)
+            return run;
+        if (mark.position >= 0)
+            break;
+    }
+    if (stride == direction.strides.size())
+        return run;
+    run.position = direction.strides.at(stride).position;
+    run.start = direction.strides.at(stride).index;
+    // The scan must not count messages the log did not take: those noted
+    // after the mark of their Stride and those before the mark of a later
+    // one.
+    QVector<int>::const_iterator dropped = qLowerBound(
+                direction.unlogged.constBegin(), direction.unlogged.constEnd(),
+                run.start);
+    for (; stride < direction.strides.size(); stride++) {
+        int strideStart = (stride + direction.trimmed) * Stride;
+        if (strideStart >= end)
+            break;
+        Mark const &mark = direction.strides.at(stride);
+        int logged = mark.position < 0? strideStart + Stride : mark.index;
+        for (int i = qMax(strideStart, run.start); i < qMin(logged, end); i++)
+            run.unlogged.append(i);
+        int strideEnd = qMin(strideStart + Stride, end);
+        for (; dropped != direction.unlogged.constEnd() &&
+             *dropped < strideEnd; ++dropped)
+            run.unlogged.append(*dropped);
+    }
+    return run;
+}
+
+bool MessageHistory::open(QString const &path)
+{
+    return log.open(path);
+}
+
+void MessageHistory::read(Run const &run, QByteArray *messages)
+{
+    for (int i = 0; i < run.count; i++)
+        messages[i] = QByteArray();
+    qint64 offset = run.position < 0? -1 : log.find(run.position);
+    if (offset < 0)
+        return;
+    int end = run.first + run.count;
+    int index = run.start;
+    QVector<int>::const_iterator dropped = run.unlogged.constBegin();
+    for (;;) {
+        while (dropped != run.unlogged.constEnd() && *dropped == index) {
+            ++dropped;
+            index++;
+        }
+        if (index >= end)
+            return;
+        bool direction = false;
+        QByteArray message = log.read(offset, &direction);
+        if (message.isNull())
+            return;
+        // Messages of the other direction are interleaved, skip past them.
+        if (direction != run.incoming)
+            continue;
+        if (index >= run.first)
+            messages[index - run.first] = message;
+        index++;
+    }
+}
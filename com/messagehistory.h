@@ -0,0 +1,149 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "trafficlog.h"
+
+/// Every message sent and received in a session, in bounded memory.
+///
+/// All messages go to a TrafficLog. Only the most recent Window messages of
+/// each direction are also kept in memory, each in a fixed Slot of one
+/// contiguous arena, so keeping them allocates nothing. Older messages are
+/// read back from the log when asked for. To find them without an index
+/// entry per message, the log position of the first logged message of every
+/// Stride messages is kept and the log scanned forward from there. Only the
+/// last Marks of those are kept, and messages older than about
+/// Marks * Stride in a direction are left in the log file only. The few
+/// messages the log drops are noted so the scan does not count them.<BR>
+/// Memory stays bounded however long the session: per direction a Window *
+/// Slot byte arena (1 MB), Window lengths and positions (40 KB) and up to
+/// 2 * Marks marks (512 KB), about 3 MB for both.<BR>
+/// A message still on its way through the log's queue, or dropped by it,
+/// cannot be read back. A run of consecutive messages is read back in one
+/// pass over the log, see locate() and read().<BR>
+/// Without a log only the in-memory window is available.<BR>
+/// Not thread safe, the caller serializes access.
+class MessageHistory
+{
+public:
+    /// Sizes.
+    enum {
+        Marks = 1 << 14,  ///< Strides per direction kept for the log.
+        Slot = 256,       ///< Bytes per message in the arena, longer ones
+                          ///< are only read back from the log.
+        Stride = 256,     ///< Messages between offsets kept for the log.
+        Window = 4096     ///< Recent messages per direction kept in
+                          ///< memory.
+    };
+
+    /// Where to read a run of messages of one direction back from the log.
+    struct Run
+    {
+        /// Constructor, for an empty run.
+        Run() : count(0), first(0), incoming(false), position(-1), start(0),
+            unlogged() {}
+
+        int count;              ///< Messages in the run.
+        int first;              ///< Index of the first message.
+        bool incoming;          ///< Direction.
+        qint64 position;        ///< Log position to scan from, -1 if none
+                                ///< of the run can be read back.
+        int start;              ///< Index of the message at position.
+        QVector<int> unlogged;  ///< Messages from start on which the log
+                                ///< did not take, in order.
+    };
+
+    /// Constructor.
+    MessageHistory();
+
+    /// Add a message.
+    /// @param message message sent or received.
+    /// @param incoming true if the message was received.
+    void append(QByteArray const &message,
+                bool incoming);
+
+    /// Get a message.
+    /// @return the message, null if out of range or no longer available.
+    /// @param index 0 for the first message of the session in this
+    /// direction.
+    /// @param incoming true for received messages.
+    QByteArray at(int index,
+                  bool incoming);
+
+    /// Get the number of messages.
+    /// @param incoming true for received messages.
+    int count(bool incoming) const { return directions[incoming].count; }
+
+    /// Get the number of messages the log dropped, see TrafficLog.
+    int droppedCount() { return log.droppedCount(); }
+
+    /// Check whether a message is kept in memory rather than only in the
+    /// log.
+    /// @param index index of the message.
+    /// @param incoming true for received messages.
+    bool isInMemory(int index,
+                    bool incoming) const
+    {
+        return index >= directions[incoming].count - Window;
+    }
+
+    /// Find where to read a run of messages back from the log.
+    /// @return the run, for read().
+    /// @param first index of the first message.
+    /// @param count number of messages.
+    /// @param incoming true for received messages.
+    Run locate(int first,
+               int count,
+               bool incoming) const;
+
+    /// Start logging to a file.
+    /// @return false if the log could not be created.
+    /// @param path log file, see TrafficLog.
+    bool open(QString const &path);
+
+    /// Get the number of messages waiting to be logged, see TrafficLog.
+    int queueDepth() { return log.queueDepth(); }
+
+    /// Read a run of messages back from the log in one pass.
+    ///
+    /// Only the log is used, which is thread safe, so unlike the rest this
+    /// need not be serialized with append().
+    /// @param run run found by locate().
+    /// @param messages receives the run.count messages, null for those not
+    /// available.
+    void read(Run const &run,
+              QByteArray *messages);
+
+protected:
+    /// A logged message the log can be scanned forward from.
+    struct Mark
+    {
+        int index;        ///< Index of the message.
+        qint64 position;  ///< Log position of the message, -1 if none of
+                          ///< its Stride was logged (yet).
+    };
+
+    /// Messages of one direction.
+    struct Direction
+    {
+        QByteArray arena;          ///< Window slots of Slot bytes.
+        int count;                 ///< Messages so far.
+        QVector<quint16> lengths;  ///< Length of the message in each slot.
+        QVector<qint64> positions; ///< Log position of the message in
+                                   ///< each slot, -1 if not logged.
+        QVector<Mark> strides;     ///< First logged message of every
+                                   ///< Stride messages, the last Marks to
+                                   ///< 2 * Marks of them.
+        int trimmed;               ///< Strides dropped from the front of
+                                   ///< strides.
+        QVector<int> unlogged;     ///< Messages after the mark of their
+                                   ///< Stride which the log did not take,
+                                   ///< in order.
+    };
+
+    /// Outgoing messages first, then incoming.
+    Direction directions[2];
+
+    /// Log of all messages.
+    TrafficLog log;
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <QAtomicInt>
+
+/// Bounded multi-producer / single-consumer lock-free queue.
+///
+/// Any number of threads may call push() concurrently, exactly one thread
+/// may call pop(). Neither ever blocks; push() fails when the queue is full
+/// and pop() fails when it is empty. Each cell carries a sequence number
+/// telling whose turn it is, so producers only contend on the tail index,
+/// and elements come out in the order their producers claimed a position.
+/// @tparam T element type, must be default constructible and assignable.
+/// @tparam Capacity maximum number of queued elements, a power of two.
+template <typename T, int Capacity>
+class MpscQueue
+{
+public:
+    /// Constructor.
+    MpscQueue() : head(0), tail(0)
+    {
+        for (int i = 0; i < Capacity; i++)
+            cells[i].sequence.fetchAndStoreRelaxed(i);
+    }
+
+    /// Remove the oldest element, consumer thread only.
+    /// @return false if the queue was empty, or the oldest element is still
+    /// being pushed.
+    /// @param item receives the element.
+    bool pop(T *item)
+    {
+        int h = head.fetchAndAddRelaxed(0);
+        Cell &cell = cells[index(h)];
+        if (cell.sequence.fetchAndAddAcquire(0) != next(h))
+            return false;
+        *item = cell.item;
+        // Release anything the element holds on to now rather than when the
+        // cell is next overwritten.
+        cell.item = T();
+        cell.sequence.fetchAndStoreRelease((int)((unsigned)h + Capacity));
+        head.fetchAndStoreRelease(next(h));
+        return true;
+    }
+
+    /// Append an element, from any thread.
+    /// @return false if the queue was full, in which case item is dropped.
+    /// @param item element to append.
+    /// @param position if not null, receives the position claimed, which
+    /// counts up from 0 by one for every element pushed.
+    bool push(T const &item,
+              int *position = 0)
+    {
+        for (;;) {
+            int t = tail.fetchAndAddRelaxed(0);
+            Cell &cell = cells[index(t)];
+            int turn = (int)((unsigned)cell.sequence.fetchAndAddAcquire(0) -
+                             (unsigned)t);
+            if (turn < 0)
+                return false;
+            if (turn == 0 && tail.testAndSetRelaxed(t, next(t))) {
+                cell.item = item;
+                cell.sequence.fetchAndStoreRelease(next(t));
+                if (position)
+                    *position = t;
+                return true;
+            }
+            // Another producer claimed t first, try the next position.
+        }
+    }
+
+    /// Get the number of queued elements, approximate while pushes are in
+    /// progress.
+    /// @return number of positions claimed but not yet popped.
+    int size()
+    {
+        return (int)((unsigned)tail.fetchAndAddAcquire(0) -
+                     (unsigned)head.fetchAndAddAcquire(0));
+    }
+
+protected:
+    /// One element and whose turn it is.
+    struct Cell
+    {
+        /// Position this cell is free for when equal to it, holds the
+        /// element of position sequence - 1 otherwise.
+        QAtomicInt sequence;
+
+        /// The element.
+        T item;
+    };
+
+    /// Cell of a position.
+    static int index(int position)
+    {
+        return (unsigned)position % Capacity;
+    }
+
+    /// Position after position, wrapping rather than overflowing.
+    static int next(int position)
+    {
+        return (int)((unsigned)position + 1);
+    }
+
+    /// Position of the next element to pop, written only by the consumer.
+    QAtomicInt head;
+
+    /// Storage, each cell is owned by one side at any time.
+    Cell cells[Capacity];
+
+    /// Position of the next element to push.
+    QAtomicInt tail;
+
+private:
+    MpscQueue(MpscQueue const &);
+    MpscQueue &operator=(MpscQueue const &);
+};
@@ -0,0 +1,89 @@
+#include "ratecontroller.h"
+#include <QDebug>
+
+namespace {
+/// Smoothed loss above which each level steps down to the next.
+double const stepDown[RateController::Levels] = { 10, 20, 35, 1e9 };
+
+/// Weight of each new report, telemetry arrives at about 10 Hz in total so
+/// this averages over roughly the last second.
+double const weight = 0.15;
+
+/// Shortest time between steps down, in ms, so a single burst of loss does
+/// not take the controller to the bottom before smoothing has caught up.
+qint64 const downHold = 1000;
+
+/// Time loss must stay below half the threshold of the level above before
+/// stepping back up, in ms.
+qint64 const upHold = 3000;
+
+/// Level names for the log.
+char const *const names[RateController::Levels] = {
+    "full", "reduced", "half", "minimal"
+};
+}
+
+RateController::RateController(QObject *parent) :
+    QObject(parent), calm(), current(Full), lastChange(), lastRssi(0),
+    smoothedLoss(-1)
+{
+    calm.start();
+    lastChange.start();
+}
+
+void RateController::change(Level level)
+{
+    if (level == current)
+        return;
+    qDebug() << "Link" << names[current] << "->" << names[level]
+             << "loss" << smoothedLoss << "rssi" << lastRssi;
+    current = level;
+    calm.restart();
+    lastChange.restart();
+    emit levelChanged(level, smoothedLoss, lastRssi);
+}
+
+int RateController::controlRate(int nominal) const
+{
+    switch (current) {
+    case Half:
+        return qMax(1, nominal / 2);
+    case Minimal:
+        return qMax(1, nominal / 4);
+    default:
+        return qMax(1, nominal);
+    }
+}
+
+int RateController::keepaliveInterval() const
+{
+    // The vehicle stops streaming 3 s after the last request.
+    return current >= Half? 2000 : 1000;
+}
+
+void RateController::report(int packetLoss, int rssi)
+{
+    lastRssi = rssi;
+    if (smoothedLoss < 0)
+        smoothedLoss = packetLoss;
+    else
+        smoothedLoss += weight * (packetLoss - smoothedLoss);
+    if (smoothedLoss > stepDown[current]) {
+        calm.restart();
+        if (lastChange.elapsed() >= downHold)
+            change((Level)(current + 1));
+    } else if (current > Full &&
+               smoothedLoss >= stepDown[current - 1] / 2) {
+        calm.restart();
+    } else if (current > Full && calm.elapsed() >= upHold) {
+        change((Level)(current - 1));
+    }
+}
+
+void RateController::reset()
+{
+    smoothedLoss = -1;
+    change(Full);
+    calm.restart();
+    lastChange.restart();
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QObject>
+
+/// Chooses how much control traffic to send from the link quality the
+/// vehicle reports.
+///
+/// Every bit-packed telemetry message carries the packet loss the vehicle
+/// sees, which is smoothed here. As it climbs the controller steps down one
+/// level at a time, first sending the auxiliary channels less often, then
+/// lowering the control rate, so that roll, pitch, throttle and yaw keep
+/// getting through a congested link. Once loss has stayed low for a while
+/// it steps back up, again one level at a time.<BR>
+/// Every change is logged with qDebug() and reported by levelChanged().
+class RateController : public QObject
+{
+    Q_OBJECT
+public:
+    /// Amount of control traffic, most first.
+    enum Level {
+        Full,     ///< Every channel twice a cycle at the nominal rate.
+        Reduced,  ///< Auxiliary channels once a cycle if enabled, see
+                  ///< Vehicle::setReducedControls().
+        Half,     ///< As Reduced at half the nominal rate.
+        Minimal,  ///< As Reduced at a quarter of the nominal rate.
+        Levels    ///< Number of levels.
+    };
+
+    /// Constructor.
+    explicit RateController(QObject *parent = 0);
+
+    /// Get the control rate to use.
+    /// @return ticks per second at the current level, at least 1.
+    /// @param nominal ticks per second on a clean link.
+    int controlRate(int nominal) const;
+
+    /// Get the interval between telemetry keepalive requests.
+    ///
+    /// Telemetry keeps flowing at every level, as it carries the loss
+    /// figures the controller depends on, but is requested less often.
+    /// @return interval in ms.
+    int keepaliveInterval() const;
+
+    /// Get the current level.
+    /// @return one of Level.
+    Level level() const { return current; }
+
+    /// Get the smoothed packet loss.
+    /// @return loss in the units the vehicle reports.
+    double loss() const { return smoothedLoss; }
+
+signals:
+    /// Emitted on every change of level.
+    /// @param level new level, one of Level.
+    /// @param loss smoothed packet loss which led to the change.
+    /// @param rssi signal strength last reported by the vehicle.
+    void levelChanged(int level,
+                      double loss,
+                      int rssi);
+
+public slots:
+    /// Take in the link figures of a telemetry message.
+    /// @param packetLoss packet loss reported by the vehicle.
+    /// @param rssi signal strength reported by the vehicle.
+    void report(int packetLoss,
+                int rssi);
+
+    /// Return to Full and forget the link history, e.g. on connection.
+    void reset();
+
+protected:
+    /// Change level and report it.
+    void change(Level level);
+
+    /// Since the last change of level, or since loss last exceeded the
+    /// threshold for stepping back up.
+    QElapsedTimer calm;
+
+    /// Current level.
+    Level current;
+
+    /// Since the last change of level.
+    QElapsedTimer lastChange;
+
+    /// Signal strength last reported.
+    int lastRssi;
+
+    /// Exponentially weighted packet loss, negative before the first report.
+    double smoothedLoss;
+};
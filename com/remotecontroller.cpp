@@ -24,59 +24,8 @@ void RemoteController::onReadyRead()
         QByteArray bytes;
         bytes.resize(socket->pendingDatagramSize());
         socket->readDatagram(bytes.data(), bytes.length());
-        if (bytes[0] != (char)0xDF || bytes.length() < 5) {
-            qDebug()<<"rejected delimiter / impossible length";
+        if (!parseDatagram(bytes))
             return;
-        }
-        int length = qFromBigEndian<uint16_t>(
-                    (unsigned char const *)bytes.constData() + 1);
-        if (length + 4 > bytes.length()) {
-            qDebug()<<"rejected length"<<(length + 4)<<">"<<bytes.length();
-            return;
-        }
-        if  (Vehicle::checksum(
-                 (unsigned char const *)bytes.constData() + 3, length + 1)) {
-            qDebug()<<"rejected checksum";
-            return;
-        }
-        quint8 type = bytes[3] & 0xF0;
-        quint8 mode = bytes[3] & 0xF;
-        switch (type) {
-        case 0x00: {
-            // Presence broadcast from Dragan View, not used in this example
-            // but show it in the message monitor.
-            emit message(bytes, true);
-            return;
-        }
-            break;
-        case 0x10: {
-            // Echoed message.
-            QByteArray msg;
-            // Strip the network wrapper using inner-message length if it is a
-            // known type.
-            if (bytes[4] == (char)0x7EU && length >= 4)
-                msg = bytes.mid(4, qFromBigEndian<quint16>(
-                                    (unsigned char const *)
-                                    bytes.constData() + 5) + 4);
-            else if ((bytes[4] == (char)0xFFU || bytes[4] == (char)0xFEU) &&
-                     length >= 6)
-                msg = bytes.mid(4, qFromBigEndian<quint16>(
-                                    (unsigned char const *)
-                                    bytes.constData() + 6) + 6);
-            else
-                msg = bytes;
-
-            if (mode == 0x01) // Message was received by Dragan View from a
-                emit message(msg, true);                        // vehicle.
-            else if (mode == 0x02) // Message was sent by Dragan View to a
-                emit message(msg, false);                       // vehicle.
-        }
-            break;
-        default: {
-            qDebug()<<"Ignoring unknown message type"<<type;
-        }
-            break;
-        }
     }
 }
 
@@ -91,6 +40,64 @@ void RemoteController::onTimer()
     socket->writeDatagram(bytes, hostAddress, hostPort);
 }
 
+bool RemoteController::parseDatagram(QByteArray const &bytes)
+{
+    if (bytes[0] != (char)0xDF || bytes.length() < 5) {
+        qDebug()<<"rejected delimiter / impossible length";
+        return false;
+    }
+    int length = qFromBigEndian<uint16_t>(
+                (unsigned char const *)bytes.constData() + 1);
+    if (length + 4 > bytes.length()) {
+        qDebug()<<"rejected length"<<(length + 4)<<">"<<bytes.length();
+        return false;
+    }
+    if  (Vehicle::checksum(
+             (unsigned char const *)bytes.constData() + 3, length + 1)) {
+        qDebug()<<"rejected checksum";
+        return false;
+    }
+    quint8 type = bytes[3] & 0xF0;
+    quint8 mode = bytes[3] & 0xF;
+    switch (type) {
+    case 0x00: {
+        // Presence broadcast from Dragan View, not used in this example
+        // but show it in the message monitor.
+        emit message(bytes, true);
+        return false;
+    }
+        break;
+    case 0x10: {
+        // Echoed message.
+        QByteArray msg;
+        // Strip the network wrapper using inner-message length if it is a
+        // known type.
+        if (bytes[4] == (char)0x7EU && length >= 4)
+            msg = bytes.mid(4, qFromBigEndian<quint16>(
+                                (unsigned char const *)
+                                bytes.constData() + 5) + 4);
+        else if ((bytes[4] == (char)0xFFU || bytes[4] == (char)0xFEU) &&
+                 length >= 6)
+            msg = bytes.mid(4, qFromBigEndian<quint16>(
+                                (unsigned char const *)
+                                bytes.constData() + 6) + 6);
+        else
+            msg = bytes;
+
+        if (mode == 0x01) // Message was received by Dragan View from a
+            emit message(msg, true);                        // vehicle.
+        else if (mode == 0x02) // Message was sent by Dragan View to a
+            emit message(msg, false);                       // vehicle.
+    }
+        break;
+    default: {
+        qDebug()<<"Ignoring unknown message type"<<type;
+    }
+        break;
+    }
+    return true;
+}
+
 qint64 RemoteController::writeData(const char *data, qint64 len)
 {
     if (passive)
@@ -39,6 +39,14 @@ protected:
     /// @return 0
     qint64 bytesAvailable() const { return 0; }
 
+    /// Unwrap one datagram from Dragan View and emit the message it carries.
+    ///
+    /// @param bytes Complete datagram.
+    /// @return false if the datagram was rejected or was a presence
+    /// broadcast, in which case onReadyRead() leaves the remaining datagrams
+    /// until the next readyRead().
+    bool parseDatagram(QByteArray const &bytes);
+
     /// This QIODevice is sequential.
     /// @return true
     bool isSequential() const { return true; }
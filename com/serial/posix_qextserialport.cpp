@@ -5,6 +5,9 @@
 #include "qextserialport.h"
 #include <QMutexLocker>
 #include <QDebug>
+#ifdef Q_OS_LINUX
+#include <linux/serial.h>
+#endif
 
 void QextSerialPort::platformSpecificInit()
 {
@@ -657,6 +660,19 @@ void QextSerialPort::setTimeout(long millisec)
     Posix_Copy_Timeout.tv_sec = millisec / 1000;
     Posix_Copy_Timeout.tv_usec = millisec % 1000;
     if (isOpen()) {
+#ifdef Q_OS_LINUX
+        if (isNonBlocking()) {
+            // Never wait in read(), which returns what is waiting or 0, but
+            // leave the descriptor blocking so that write() always writes
+            // everything it is given.
+            fcntl(fd, F_SETFL, 0);
+            tcgetattr(fd, & Posix_CommConfig);
+            Posix_CommConfig.c_cc[VMIN] = 0;
+            Posix_CommConfig.c_cc[VTIME] = 0;
+            tcsetattr(fd, TCSAFLUSH, & Posix_CommConfig);
+            return;
+        }
+#endif
         if (millisec == -1)
             fcntl(fd, F_SETFL, O_NDELAY);
         else
@@ -686,6 +702,18 @@ bool QextSerialPort::open(OpenMode mode)
             qDebug("file opened succesfully");
 
             setOpenMode(mode);              // Flag the port as opened
+#ifdef Q_OS_LINUX
+            if (isNonBlocking()) {
+                // Have the driver pass each byte on as it arrives rather than
+                // batching them on a timer, which adds up to 16 ms on the USB
+                // adapters XBee boards are usually behind.
+                struct serial_struct serial;
+                if (ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+                    serial.flags |= ASYNC_LOW_LATENCY;
+                    ioctl(fd, TIOCSSERIAL, &serial);
+                }
+            }
+#endif
             tcgetattr(fd, &old_termios);    // Save the old termios
             Posix_CommConfig = old_termios; // Make a working copy
             cfmakeraw(&Posix_CommConfig);   // Enable raw access
@@ -846,6 +874,21 @@ void QextSerialPort::setDtr(bool set)
     }
 }
 
+/*!
+Returns true if read() returns straight away when nothing is waiting.  This is the case for an
+event driven port on Linux, which is set up with VMIN=0, VTIME=0 and the driver's low latency
+flag, so it can be read until read() returns 0 without asking bytesAvailable() first.  Writes
+still block until everything has been handed to the driver.
+*/
+bool QextSerialPort::isNonBlocking() const
+{
+#ifdef Q_OS_LINUX
+    return queryMode() == QextSerialPort::EventDriven;
+#else
+    return false;
+#endif
+}
+
 /*!
 Sets RTS line to the requested state (high by default).  This function will have no effect if
 the port associated with the class is not currently open.
@@ -934,8 +977,12 @@ qint64 QextSerialPort::readData(char * data, qint64 maxSize)
 {
     QMutexLocker lock(mutex);
     int retVal = ::read(fd, data, maxSize);
-    if (retVal == -1)
+    if (retVal == -1) {
+        // Nothing waiting on a port opened O_NDELAY is not an error.
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
         lastErr = E_READ_FAILED;
+    }
 
     return retVal;
 }
@@ -260,6 +260,7 @@ class QEXTSERIALPORT_EXPORT QextSerialPort: public QIODevice
 
         void setDtr(bool set=true);
         void setRts(bool set=true);
+        bool isNonBlocking() const;
         ulong lineStatus();
         QString errorString();
 
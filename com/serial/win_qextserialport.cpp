@@ -721,6 +721,14 @@ void QextSerialPort::setDtr(bool set) {
     }
 }
 
+/*!
+Returns true if read() returns straight away when nothing is waiting.  Always false on Windows,
+where an event driven read waits for the overlapped operation to complete.
+*/
+bool QextSerialPort::isNonBlocking() const {
+    return false;
+}
+
 /*!
 Sets RTS line to the requested state (high by default).  This function will have no effect if
 the port associated with the class is not currently open.
@@ -0,0 +1,73 @@
+#pragma once
+#include <QAtomicInt>
+
+/// Bounded single-producer / single-consumer lock-free queue.
+///
+/// Exactly one thread may call push() and exactly one (possibly different)
+/// thread may call pop(). Neither ever blocks; push() fails when the queue is
+/// full and pop() fails when it is empty.
+/// @tparam T element type, must be default constructible and assignable.
+/// @tparam Capacity maximum number of queued elements.
+template <typename T, int Capacity>
+class SpscQueue
+{
+public:
+    /// Constructor.
+    SpscQueue() : head(0), tail(0) {}
+
+    /// Remove the oldest element, consumer thread only.
+    /// @return false if the queue was empty.
+    /// @param item receives the element.
+    bool pop(T *item)
+    {
+        int h = head.fetchAndAddRelaxed(0);
+        if (h == tail.fetchAndAddAcquire(0))
+            return false;
+        *item = items[h];
+        // Release anything the element holds on to (e.g. shared data) now
+        // rather than when the slot is next overwritten.
+        items[h] = T();
+        head.fetchAndStoreRelease((h + 1) % Slots);
+        return true;
+    }
+
+    /// Append an element, producer thread only.
+    /// @return false if the queue was full, in which case item is dropped.
+    /// @param item element to append.
+    bool push(T const &item)
+    {
+        int t = tail.fetchAndAddRelaxed(0);
+        int next = (t + 1) % Slots;
+        if (next == head.fetchAndAddAcquire(0))
+            return false;
+        items[t] = item;
+        tail.fetchAndStoreRelease(next);
+        return true;
+    }
+
+    /// Get the number of queued elements, exact only when called from the
+    /// producer or consumer thread.
+    /// @return number of elements which can currently be popped.
+    int size()
+    {
+        int count = tail.fetchAndAddAcquire(0) - head.fetchAndAddAcquire(0);
+        return count < 0? count + Slots : count;
+    }
+
+protected:
+    /// One slot is always left empty to distinguish full from empty.
+    enum { Slots = Capacity + 1 };
+
+    /// Index of the next element to pop, written only by the consumer.
+    QAtomicInt head;
+
+    /// Storage, each slot is owned by exactly one side at any time.
+    T items[Slots];
+
+    /// Index of the next slot to push to, written only by the producer.
+    QAtomicInt tail;
+
+private:
+    SpscQueue(SpscQueue const &);
+    SpscQueue &operator=(SpscQueue const &);
+};
@@ -0,0 +1,182 @@
+#include "tea.h"
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define TEA_HAVE_SSE2
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define TEA_HAVE_AVX2
+#endif
+
+namespace {
+uint32_t const delta = 0x9E3779B9;
+
+/// TEA mixing function on signed words, i.e. with an arithmetic right shift.
+inline uint32_t mix(uint32_t v)
+{
+    return ((v << 4) ^ (uint32_t)((int32_t)v >> 5)) + v;
+}
+
+void decryptBlock(uint32_t const *keys, unsigned char const *in,
+                  unsigned char *out)
+{
+    uint32_t v[2];
+    memcpy(v, in, 8);
+    for (int n = Tea::Rounds - 1; n >= 0; n--) {
+        v[1] -= mix(v[0]) ^ keys[2 * n + 1];
+        v[0] -= mix(v[1]) ^ keys[2 * n];
+    }
+    memcpy(out, v, 8);
+}
+
+void encryptBlock(uint32_t const *keys, unsigned char const *in,
+                  unsigned char *out)
+{
+    uint32_t v[2];
+    memcpy(v, in, 8);
+    for (int n = 0; n < Tea::Rounds; n++) {
+        v[0] += mix(v[1]) ^ keys[2 * n];
+        v[1] += mix(v[0]) ^ keys[2 * n + 1];
+    }
+    memcpy(out, v, 8);
+}
+
+#ifdef TEA_HAVE_SSE2
+inline __m128i mix(__m128i v)
+{
+    return _mm_add_epi32(_mm_xor_si128(_mm_slli_epi32(v, 4),
+                                       _mm_srai_epi32(v, 5)), v);
+}
+
+/// Process four blocks, words are split into one register per word position
+/// so every lane runs an independent block.
+void crypt4(uint32_t const *keys, unsigned char const *in, unsigned char *out,
+            bool forward)
+{
+    __m128i a = _mm_loadu_si128((__m128i const *)in);
+    __m128i b = _mm_loadu_si128((__m128i const *)(in + 16));
+    a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+    __m128i v0 = _mm_unpacklo_epi64(a, b);
+    __m128i v1 = _mm_unpackhi_epi64(a, b);
+    if (forward) {
+        for (int n = 0; n < Tea::Rounds; n++) {
+            v0 = _mm_add_epi32(v0, _mm_xor_si128(
+                    mix(v1), _mm_set1_epi32(keys[2 * n])));
+            v1 = _mm_add_epi32(v1, _mm_xor_si128(
+                    mix(v0), _mm_set1_epi32(keys[2 * n + 1])));
+        }
+    } else {
+        for (int n = Tea::Rounds - 1; n >= 0; n--) {
+            v1 = _mm_sub_epi32(v1, _mm_xor_si128(
+                    mix(v0), _mm_set1_epi32(keys[2 * n + 1])));
+            v0 = _mm_sub_epi32(v0, _mm_xor_si128(
+                    mix(v1), _mm_set1_epi32(keys[2 * n])));
+        }
+    }
+    a = _mm_shuffle_epi32(_mm_unpacklo_epi64(v0, v1), _MM_SHUFFLE(3, 1, 2, 0));
+    b = _mm_shuffle_epi32(_mm_unpackhi_epi64(v0, v1), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128((__m128i *)out, a);
+    _mm_storeu_si128((__m128i *)(out + 16), b);
+}
+#endif
+
+#ifdef TEA_HAVE_AVX2
+__attribute__((target("avx2")))
+inline __m256i mix8(__m256i v)
+{
+    return _mm256_add_epi32(_mm256_xor_si256(_mm256_slli_epi32(v, 4),
+                                             _mm256_srai_epi32(v, 5)), v);
+}
+
+/// Process eight blocks, as crypt4() but with the blocks permuted across
+/// both 128-bit halves.
+__attribute__((target("avx2")))
+void crypt8(uint32_t const *keys, unsigned char const *in, unsigned char *out,
+            bool forward)
+{
+    __m256i a = _mm256_loadu_si256((__m256i const *)in);
+    __m256i b = _mm256_loadu_si256((__m256i const *)(in + 32));
+    a = _mm256_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+    b = _mm256_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i v0 = _mm256_unpacklo_epi64(a, b);
+    __m256i v1 = _mm256_unpackhi_epi64(a, b);
+    if (forward) {
+        for (int n = 0; n < Tea::Rounds; n++) {
+            v0 = _mm256_add_epi32(v0, _mm256_xor_si256(
+                    mix8(v1), _mm256_set1_epi32(keys[2 * n])));
+            v1 = _mm256_add_epi32(v1, _mm256_xor_si256(
+                    mix8(v0), _mm256_set1_epi32(keys[2 * n + 1])));
+        }
+    } else {
+        for (int n = Tea::Rounds - 1; n >= 0; n--) {
+            v1 = _mm256_sub_epi32(v1, _mm256_xor_si256(
+                    mix8(v0), _mm256_set1_epi32(keys[2 * n + 1])));
+            v0 = _mm256_sub_epi32(v0, _mm256_xor_si256(
+                    mix8(v1), _mm256_set1_epi32(keys[2 * n])));
+        }
+    }
+    a = _mm256_shuffle_epi32(_mm256_unpacklo_epi64(v0, v1),
+                             _MM_SHUFFLE(3, 1, 2, 0));
+    b = _mm256_shuffle_epi32(_mm256_unpackhi_epi64(v0, v1),
+                             _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i *)out, a);
+    _mm256_storeu_si256((__m256i *)(out + 32), b);
+}
+#endif
+
+/// Shared driver, widest lanes first.
+void crypt(uint32_t const *keys, unsigned char const *in, unsigned char *out,
+           unsigned int blocks, bool forward)
+{
+#ifdef TEA_HAVE_AVX2
+    if (Tea::hasAvx2()) {
+        for (; blocks >= 8; blocks -= 8, in += 64, out += 64)
+            crypt8(keys, in, out, forward);
+    }
+#endif
+#ifdef TEA_HAVE_SSE2
+    for (; blocks >= 4; blocks -= 4, in += 32, out += 32)
+        crypt4(keys, in, out, forward);
+#endif
+    for (; blocks > 0; blocks--, in += 8, out += 8) {
+        if (forward)
+            encryptBlock(keys, in, out);
+        else
+            decryptBlock(keys, in, out);
+    }
+}
+}
+
+Tea::Tea(uint32_t const key[4])
+{
+    uint32_t sum = 0;
+    for (int n = 0; n < Rounds; n++) {
+        roundKeys[2 * n] = sum + key[sum & 3];
+        sum += delta;
+        roundKeys[2 * n + 1] = sum + key[(sum >> 11) & 3];
+    }
+}
+
+void Tea::decrypt(unsigned char const *data, unsigned char *output,
+                  unsigned int start, unsigned int count) const
+{
+    crypt(roundKeys, data + start, output + start, count >> 3, false);
+}
+
+void Tea::encrypt(unsigned char const *data, unsigned char *output,
+                  unsigned int start, unsigned int count) const
+{
+    crypt(roundKeys, data + start, output + start, count >> 3, true);
+}
+
+bool Tea::hasAvx2()
+{
+#ifdef TEA_HAVE_AVX2
+    static bool const supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
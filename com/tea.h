@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+
+/// Tiny Encryption Algorithm engine for a single 128-bit key.
+///
+/// The 64 round keys (sum + key[...]) are computed once on construction
+/// rather than for every block. Runs of blocks are processed in independent
+/// lanes, eight at a time with AVX2 or four at a time with SSE2 where
+/// available, with a scalar loop for the remainder.<BR>
+/// Output is byte-identical to a plain one-block-at-a-time TEA using signed
+/// 32-bit words as in the Draganflyer API.
+class Tea
+{
+public:
+    /// Constructor.
+    /// @param key 128-bit encryption key.
+    explicit Tea(uint32_t const key[4]);
+
+    /// Decrypt data.
+    /// @param data pointer to the message to be decrypted.
+    /// @param output pointer to buffer where decrypted bytes will be written,
+    /// may be equal to data.
+    /// @param start offset which is applied to both data and output, used
+    /// to skip bytes which should not be decrypted (e.g. message headers).
+    /// @param count total number of bytes to decrypt, if this is not a
+    /// multiple of 8 then the remaining bytes will be ignored.
+    void decrypt(unsigned char const *data,
+                 unsigned char *output,
+                 unsigned int start,
+                 unsigned int count) const;
+
+    /// Encrypt data.
+    /// @param data pointer to the message to be encrypted.
+    /// @param output pointer to buffer where encrypted bytes will be written,
+    /// may be equal to data.
+    /// @param start offset which is applied to both data and output, used
+    /// to skip bytes which should not be encrypted (e.g. message headers).
+    /// @param count total number of bytes to encrypt, if this is not a
+    /// multiple of 8 then the remaining bytes will be ignored.
+    void encrypt(unsigned char const *data,
+                 unsigned char *output,
+                 unsigned int start,
+                 unsigned int count) const;
+
+    /// Check whether the CPU supports AVX2, determined once by CPUID.
+    /// @return true if eight blocks are processed per iteration.
+    static bool hasAvx2();
+
+    /// Number of rounds per block.
+    enum { Rounds = 32 };
+
+protected:
+    /// Round keys in encryption order.
+    ///
+    /// roundKeys[2n] is mixed into the first word and roundKeys[2n + 1] into
+    /// the second word during round n. Decryption uses them in reverse.
+    uint32_t roundKeys[2 * Rounds];
+};
@@ -0,0 +1,205 @@
+#include "telemetry.h"
+#include "bitfield.h"
+
+// Field layouts. Offsets are in bits from the 0xFF delimiter, i.e. the
+// payload starts at bit 40. A new message type needs a layout here, a
+// decode() filling its frame and an encode() reversing it.
+
+/// Bit-packed telemetry message #22.
+namespace Telemetry22 {
+typedef BitField<40, 11, true, 10> Roll;
+typedef BitField<51, 11, true, 10> Pitch;
+typedef BitField<62, 10, true> Yaw;
+typedef BitField<72, 8> PacketLoss;
+typedef BitField<80, 8> Rssi;
+typedef BitField<88, 16> Throttle;
+typedef BitField<104, 16, true, 10> AltPre;
+typedef BitField<120, 13, true> MagX;
+typedef BitField<133, 13, true> MagY;
+typedef BitField<146, 13, true> MagZ;
+typedef BitField<160, 10, true, 10> VelN;
+typedef BitField<170, 10, true, 10> VelE;
+typedef BitField<180, 10, true, 10> VelD;
+typedef BitField<192, 10, true> ErrN;
+typedef BitField<202, 10, true> ErrE;
+typedef BitField<212, 10, true> ErrD;
+typedef BitField<222, 1> ErrNEWhole;   ///< ErrN/E are in metres, not dm.
+typedef BitField<223, 1> ErrDWhole;    ///< ErrD is in metres, not dm.
+typedef BitField<224, 8, false, 10> BattHeli;
+typedef BitField<232, 16> FlightTime;  ///< 40 s units.
+typedef BitField<248, 5> Svs;
+typedef BitField<253, 3> HoldMode;
+typedef BitField<256, 8, false, 10> Current;
+typedef BitField<264, 8> Picture;
+}
+
+/// Bit-packed telemetry message #23.
+namespace Telemetry23 {
+typedef BitField<40, 11, true, 10> Roll;
+typedef BitField<51, 11, true, 10> Pitch;
+typedef BitField<62, 10, true> Yaw;
+typedef BitField<72, 8> PacketLoss;
+typedef BitField<80, 8> Rssi;
+typedef BitField<88, 16> Throttle;
+typedef BitField<104, 16, true, 10> AltPre;
+typedef BitField<120, 16, true> AltGps;
+typedef BitField<136, 23> LatMillionths;
+typedef BitField<159, 9, true> LatDegrees;
+typedef BitField<168, 23> LngMillionths;
+typedef BitField<191, 9, true> LngDegrees;
+typedef BitField<200, 10, false, 10> Pdop;
+typedef BitField<210, 11, false, 10> Hacc;
+typedef BitField<221, 11, false, 10> Vacc;
+typedef BitField<232, 20> GpsTime;     ///< Seconds.
+typedef BitField<252, 12, true, 16> Temperature;
+typedef BitField<264, 8> Tilt;
+}
+
+namespace {
+/// Combine whole degrees and millionths, the fraction takes the sign of the
+/// whole degrees.
+double degrees(int32_t whole, int32_t millionths)
+{
+    double result = whole;
+    if (result < 0)
+        result -= millionths / 1000000.0;
+    else
+        result += millionths / 1000000.0;
+    return result;
+}
+
+/// Check whether a distance in metres fits a 10-bit signed field in dm.
+bool fitsDecimetres(float metres)
+{
+    return metres > -51.25f && metres < 51.15f;
+}
+
+/// Split degrees into whole degrees and millionths, inverse of degrees().
+void splitDegrees(double value, int32_t *whole, int32_t *millionths)
+{
+    *whole = (int32_t)value;
+    double fraction = value < 0? *whole - value : value - *whole;
+    *millionths = (int32_t)(fraction * 1000000.0 + 0.5);
+}
+}
+
+Telemetry1Frame Telemetry1Frame::decode(unsigned char const *data)
+{
+    using namespace Telemetry22;
+    Telemetry1Frame frame;
+    frame.roll = Roll::value(data);
+    frame.pitch = Pitch::value(data);
+    frame.yaw = Yaw::value(data);
+    frame.packetLoss = PacketLoss::raw(data);
+    frame.rssi = Rssi::raw(data);
+    frame.throttle = Throttle::raw(data);
+    frame.altPre = AltPre::value(data);
+    frame.magX = MagX::raw(data);
+    frame.magY = MagY::raw(data);
+    frame.magZ = MagZ::raw(data);
+    frame.velN = VelN::value(data);
+    frame.velE = VelE::value(data);
+    frame.velD = VelD::value(data);
+    frame.errN = ErrN::value(data);
+    frame.errE = ErrE::value(data);
+    frame.errD = ErrD::value(data);
+    if (!ErrNEWhole::raw(data)) {
+        frame.errN /= 10;
+        frame.errE /= 10;
+    }
+    if (!ErrDWhole::raw(data))
+        frame.errD /= 10;
+    frame.battHeli = BattHeli::value(data);
+    frame.flightTime = FlightTime::raw(data) * 40;
+    frame.svs = Svs::raw(data);
+    frame.holdMode = HoldMode::raw(data);
+    frame.picture = Picture::raw(data);
+    frame.current = Current::value(data);
+    return frame;
+}
+
+Telemetry2Frame Telemetry2Frame::decode(unsigned char const *data)
+{
+    using namespace Telemetry23;
+    Telemetry2Frame frame;
+    frame.roll = Roll::value(data);
+    frame.pitch = Pitch::value(data);
+    frame.yaw = Yaw::value(data);
+    frame.packetLoss = PacketLoss::raw(data);
+    frame.rssi = Rssi::raw(data);
+    frame.throttle = Throttle::raw(data);
+    frame.altPre = AltPre::value(data);
+    frame.altGps = AltGps::raw(data);
+    frame.lat = degrees(LatDegrees::raw(data), LatMillionths::raw(data));
+    frame.lng = degrees(LngDegrees::raw(data), LngMillionths::raw(data));
+    frame.pdop = Pdop::value(data);
+    frame.hacc = Hacc::value(data);
+    frame.vacc = Vacc::value(data);
+    frame.gpsTime = GpsTime::raw(data) * 1000;
+    // 0x7FF is reserved to mean no sensor fitted.
+    frame.temperature = Temperature::raw(data) == 0x7FF?
+                -1000000 : Temperature::value(data);
+    frame.tilt = Tilt::raw(data);
+    return frame;
+}
+
+void Telemetry1Frame::encode(unsigned char *data) const
+{
+    using namespace Telemetry22;
+    Roll::setValue(data, roll);
+    Pitch::setValue(data, pitch);
+    Yaw::setValue(data, yaw);
+    PacketLoss::store(data, packetLoss);
+    Rssi::store(data, rssi);
+    Throttle::store(data, throttle);
+    AltPre::setValue(data, altPre);
+    MagX::store(data, magX);
+    MagY::store(data, magY);
+    MagZ::store(data, magZ);
+    VelN::setValue(data, velN);
+    VelE::setValue(data, velE);
+    VelD::setValue(data, velD);
+    // Errors go out in dm unless that would overflow the 10-bit fields.
+    bool neWhole = !fitsDecimetres(errN) || !fitsDecimetres(errE);
+    bool dWhole = !fitsDecimetres(errD);
+    ErrN::setValue(data, neWhole? errN : errN * 10);
+    ErrE::setValue(data, neWhole? errE : errE * 10);
+    ErrD::setValue(data, dWhole? errD : errD * 10);
+    ErrNEWhole::store(data, neWhole);
+    ErrDWhole::store(data, dWhole);
+    BattHeli::setValue(data, battHeli);
+    FlightTime::store(data, flightTime / 40);
+    Svs::store(data, svs);
+    HoldMode::store(data, holdMode);
+    Picture::store(data, picture);
+    Current::setValue(data, current);
+}
+
+void Telemetry2Frame::encode(unsigned char *data) const
+{
+    using namespace Telemetry23;
+    Roll::setValue(data, roll);
+    Pitch::setValue(data, pitch);
+    Yaw::setValue(data, yaw);
+    PacketLoss::store(data, packetLoss);
+    Rssi::store(data, rssi);
+    Throttle::store(data, throttle);
+    AltPre::setValue(data, altPre);
+    AltGps::store(data, altGps);
+    int32_t whole, millionths;
+    splitDegrees(lat, &whole, &millionths);
+    LatDegrees::store(data, whole);
+    LatMillionths::store(data, millionths);
+    splitDegrees(lng, &whole, &millionths);
+    LngDegrees::store(data, whole);
+    LngMillionths::store(data, millionths);
+    Pdop::setValue(data, pdop);
+    Hacc::setValue(data, hacc);
+    Vacc::setValue(data, vacc);
+    GpsTime::store(data, gpsTime / 1000);
+    if (temperature <= -1000000)
+        Temperature::store(data, 0x7FF);
+    else
+        Temperature::setValue(data, temperature);
+    Tilt::store(data, tilt);
+}
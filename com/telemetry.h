@@ -0,0 +1,92 @@
+#pragma once
+#include <stdint.h>
+#include <QMetaType>
+
+/// Decoded contents of the bit-packed telemetry message #22.
+///
+/// Plain data so that it can be passed by const reference, or copied once as
+/// a whole through a queued connection.
+struct Telemetry1Frame
+{
+    float roll;              ///< Degrees.
+    float pitch;             ///< Degrees.
+    float yaw;               ///< Degrees.
+    int packetLoss;          ///< Link packet loss as reported by the vehicle.
+    int rssi;                ///< Received signal strength at the vehicle.
+    unsigned int throttle;   ///< Commanded throttle.
+    float altPre;            ///< Barometric altitude in metres.
+    int magX;                ///< Magnetometer X in mG.
+    int magY;                ///< Magnetometer Y in mG.
+    int magZ;                ///< Magnetometer Z in mG.
+    float velN;              ///< Velocity north in m/s.
+    float velE;              ///< Velocity east in m/s.
+    float velD;              ///< Velocity down in m/s.
+    float errN;              ///< Position error north in metres.
+    float errE;              ///< Position error east in metres.
+    float errD;              ///< Position error down in metres.
+    float battHeli;          ///< Battery voltage.
+    unsigned int flightTime; ///< Flight time in seconds.
+    int svs;                 ///< Satellites used.
+    int holdMode;            ///< Active hold mode.
+    int picture;             ///< Picture counter.
+    float current;           ///< Current draw in amps.
+
+    /// Decode a bit-packed telemetry message #22.
+    /// @return decoded frame.
+    /// @param data decrypted config message, starting at the 0xFF delimiter.
+    static Telemetry1Frame decode(unsigned char const *data);
+
+    /// Bit-pack this frame into a telemetry message #22.
+    ///
+    /// Inverse of decode() to within the resolution of each field, used to
+    /// synthesise vehicle traffic. Only the field bits are written.
+    /// @param data config message of at least Telemetry1Frame::Length + 6
+    /// bytes, starting at the 0xFF delimiter.
+    void encode(unsigned char *data) const;
+
+    /// Value of the length field of a telemetry message #22.
+    enum { Length = 32 };
+};
+
+/// Decoded contents of the bit-packed telemetry message #23.
+///
+/// Plain data so that it can be passed by const reference, or copied once as
+/// a whole through a queued connection.
+struct Telemetry2Frame
+{
+    float roll;              ///< Degrees.
+    float pitch;             ///< Degrees.
+    float yaw;               ///< Degrees.
+    int packetLoss;          ///< Link packet loss as reported by the vehicle.
+    int rssi;                ///< Received signal strength at the vehicle.
+    unsigned int throttle;   ///< Commanded throttle.
+    float altPre;            ///< Barometric altitude in metres.
+    int altGps;              ///< GPS altitude ASL in metres.
+    double lat;              ///< Latitude in degrees.
+    double lng;              ///< Longitude in degrees.
+    float pdop;              ///< Position dilution of precision.
+    float hacc;              ///< Horizontal accuracy in metres.
+    float vacc;              ///< Vertical accuracy in metres.
+    int gpsTime;             ///< GPS time of week in ms.
+    float temperature;       ///< Degrees C, -1000000 if not available.
+    unsigned int tilt;       ///< Camera tilt.
+
+    /// Decode a bit-packed telemetry message #23.
+    /// @return decoded frame.
+    /// @param data decrypted config message, starting at the 0xFF delimiter.
+    static Telemetry2Frame decode(unsigned char const *data);
+
+    /// Bit-pack this frame into a telemetry message #23.
+    ///
+    /// Inverse of decode() to within the resolution of each field, used to
+    /// synthesise vehicle traffic. Only the field bits are written.
+    /// @param data config message of at least Telemetry2Frame::Length + 6
+    /// bytes, starting at the 0xFF delimiter.
+    void encode(unsigned char *data) const;
+
+    /// Value of the length field of a telemetry message #23.
+    enum { Length = 32 };
+};
+
+Q_DECLARE_METATYPE(Telemetry1Frame)
+Q_DECLARE_METATYPE(Telemetry2Frame)
@@ -0,0 +1,311 @@
+#include "trafficlog.h"
+#include <string.h>
+#include <QByteArray>
+#include <QDateTime>
+#include <QtEndian>
+#include "hexformat.h"
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+/// Marks a binary log.
+char const magic[4] = { 'D', 'F', 'T', 'L' };
+
+/// Format written by this version.
+quint32 const version = 1;
+
+/// Commit what was written to a file to disk.
+void commit(QFile &file)
+{
+#if defined(Q_OS_LINUX)
+    fdatasync(file.handle());
+#elif defined(Q_OS_UNIX)
+    fsync(file.handle());
+#else
+    // Windows writes back mapped views on its own.
+    (void)file;
+#endif
+}
+
+/// Write a number in decimal.
+/// @return characters written, at most 20.
+/// @param value number to write.
+/// @param out receives the digits, not terminated.
+int formatDecimal(quint64 value, char *out)
+{
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    for (int i = 0; i < count; i++)
+        out[i] = digits[count - 1 - i];
+    return count;
+}
+}
+
+TrafficLog::TrafficLog() :
+    accepting(0), clock(), dropped(0), file(), first(0), mutex(), queue(),
+    readLength(0), readStart(0), readWindow(0), stopping(false), strides(),
+    trimmed(0), used(0), wake(), window(0), windowLength(0), windowStart(0),
+    written(0), writer(this)
+{
+}
+
+TrafficLog::~TrafficLog()
+{
+    close();
+}
+
+qint64 TrafficLog::append(QByteArray const &message, bool incoming)
+{
+    if (!isOpen() || message.isEmpty() || message.length() > 0xFFFF)
+        return -1;
+    Record record;
+    record.bytes = message;
+    record.incoming = incoming;
+    record.time = clock.nsecsElapsed();
+    int position = 0;
+    if (!queue.push(record, &position)) {
+        dropped.fetchAndAddRelaxed(1);
+        return -1;
+    }
+    // The writer looks at the queue every Poll ms anyway, only hurry it
+    // along in a burst.
+    if (queue.size() >= QueueLength / 2)
+        wake.wakeOne();
+    return (quint32)((unsigned)position - (unsigned)first);
+}
+
+void TrafficLog::close()
+{
+    accepting.fetchAndStoreOrdered(0);
+    if (writer.isRunning()) {
+        mutex.lock();
+        stopping = true;
+        wake.wakeOne();
+        mutex.unlock();
+        writer.wait();
+    }
+    // Anything pushed while closing, so the next log starts afresh.
+    Record record;
+    while (queue.pop(&record))
+        written++;
+    if (!file.isOpen())
+        return;
+    if (readWindow)
+        file.unmap(readWindow);
+    readWindow = 0;
+    if (window)
+        file.unmap(window);
+    window = 0;
+    file.resize(used);
+    file.close();
+}
+
+bool TrafficLog::convert(QString const &path, QString const &incomingPath,
+                         QString const &outgoingPath)
+{
+    QFile log(path);
+    QFile incoming(incomingPath);
+    QFile outgoing(outgoingPath);
+    if (!log.open(QFile::ReadOnly) || log.size() < FileHeader)
+        return false;
+    uchar const *data = log.map(0, log.size());
+    if (!data || memcmp(data, magic, sizeof(magic)) ||
+            qFromLittleEndian<quint32>(data + 4) != version)
+        return false;
+    if (!incoming.open(QFile::WriteOnly | QFile::Truncate) ||
+            !outgoing.open(QFile::WriteOnly | QFile::Truncate))
+        return false;
+    qint64 start = qFromLittleEndian<qint64>(data + 8);
+    qint64 offset = FileHeader;
+    QByteArray line;
+    while (offset + RecordHeader <= log.size()) {
+        uchar const *record = data + offset;
+        int length = qFromLittleEndian<quint16>(record);
+        if (length == 0 || offset + RecordHeader + length > log.size())
+            break;
+        qint64 ms = start + qFromLittleEndian<quint64>(record + 4) / 1000000;
+        // Only ever grown, so that each line is formatted in place.
+        int longest = 20 + 1 + HexFormat::length(length, false) + 1;
+        if (line.length() < longest)
+            line.resize(longest);
+        char *out = line.data();
+        out += formatDecimal(ms, out);
+        *out++ = ':';
+        HexFormat::format(record + RecordHeader, length, out, false);
+        out += HexFormat::length(length, false);
+        *out++ = '\n';
+        (record[2]? incoming : outgoing).write(line.constData(),
+                                               out - line.constData());
+        offset += RecordHeader + length;
+    }
+    return true;
+}
+
+bool TrafficLog::extend()
+{
+    // Windows cannot resize a file while any part of it is mapped.
+    if (readWindow)
+        file.unmap(readWindow);
+    readWindow = 0;
+    if (window)
+        file.unmap(window);
+    window = 0;
+    if (!file.resize(used + Chunk))
+        return false;
+    window = file.map(used, Chunk);
+    if (!window)
+        return false;
+    windowStart = used;
+    windowLength = Chunk;
+    return true;
+}
+
+QByteArray TrafficLog::fetch(qint64 &offset, bool *incoming)
+{
+    if (!file.isOpen() || offset < FileHeader ||
+            offset + RecordHeader > used)
+        return QByteArray();
+    // A record lies either wholly in the window or wholly before it, where
+    // the Chunk from it on is mapped to read it and the ones after it.
+    uchar const *record;
+    if (window && offset >= windowStart) {
+        record = window + (offset - windowStart);
+    } else {
+        qint64 end = window? windowStart : used;
+        if (!readWindow || offset < readStart ||
+                offset + RecordHeader > readStart + readLength ||
+                offset + RecordHeader +
+                qFromLittleEndian<quint16>(readWindow + (offset - readStart))
+                > readStart + readLength) {
+            if (readWindow)
+                file.unmap(readWindow);
+            readStart = offset;
+            readLength = qMin<qint64>(Chunk, end - offset);
+            readWindow = file.map(readStart, readLength);
+            if (!readWindow)
+                return QByteArray();
+        }
+        record = readWindow + (offset - readStart);
+    }
+    int length = qFromLittleEndian<quint16>(record);
+    if (length == 0 || offset + RecordHeader + length > used)
+        return QByteArray();
+    QByteArray data((char const *)record + RecordHeader, length);
+    if (incoming)
+        *incoming = record[2] != 0;
+    offset += RecordHeader + length;
+    return data;
+}
+
+qint64 TrafficLog::find(qint64 position)
+{
+    QMutexLocker lock(&mutex);
+    if (position < 0 || position >= written - first)
+        return -1;
+    qint64 offset = strides.value(position / Stride - trimmed, -1);
+    for (qint64 skip = position % Stride; skip > 0 && offset >= 0; skip--)
+        if (fetch(offset, 0).isNull())
+            return -1;
+    return offset;
+}
+
+bool TrafficLog::open(QString const &path)
+{
+    close();
+    file.setFileName(path);
+    // Unbuffered, a read ahead could otherwise hold bytes since written
+    // through the window.
+    if (!file.open(QFile::ReadWrite | QFile::Truncate | QFile::Unbuffered))
+        return false;
+    used = 0;
+    if (!extend()) {
+        file.close();
+        return false;
+    }
+    memcpy(window, magic, sizeof(magic));
+    qToLittleEndian<quint32>(version, window + 4);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), window + 8);
+    used = FileHeader;
+    first = written;
+    strides.clear();
+    trimmed = 0;
+    stopping = false;
+    dropped.fetchAndStoreRelaxed(0);
+    clock.start();
+    accepting.fetchAndStoreRelease(1);
+    writer.start();
+    return true;
+}
+
+QByteArray TrafficLog::read(qint64 &offset, bool *incoming)
+{
+    QMutexLocker lock(&mutex);
+    return fetch(offset, incoming);
+}
+
+qint64 TrafficLog::take()
+{
+    qint64 bytes = 0;
+    Record record;
+    while (queue.pop(&record)) {
+        qint64 index = written++ - first;
+        int length = record.bytes.length();
+        if (window && used - windowStart + RecordHeader + length >
+                windowLength && !extend())
+            accepting.fetchAndStoreOrdered(0);
+        if (!window) {
+            dropped.fetchAndAddRelaxed(1);
+            continue;
+        }
+        if (index % Stride == 0) {
+            // Drop the oldest half at a time, so that moving the rest down
+            // is paid for once every Offsets strides.
+            if (strides.size() == 2 * Offsets) {
+                strides.remove(0, Offsets);
+                trimmed += Offsets;
+            }
+            strides.append(used);
+        }
+        uchar *out = window + (used - windowStart);
+        qToLittleEndian<quint16>(length, out);
+        out[2] = record.incoming? 1 : 0;
+        out[3] = 0;
+        qToLittleEndian<quint64>(record.time, out + 4);
+        memcpy(out + RecordHeader, record.bytes.constData(), length);
+        used += RecordHeader + length;
+        bytes += RecordHeader + length;
+    }
+    return bytes;
+}
+
+void TrafficLog::write()
+{
+    QElapsedTimer lastCommit;
+    lastCommit.start();
+    qint64 pending = 0;
+    QMutexLocker lock(&mutex);
+    for (;;) {
+        // Looked at before taking, so everything queued before close() is
+        // written on the last pass.
+        bool stop = stopping;
+        pending += take();
+        if (stop || pending >= SyncBytes ||
+                (pending && lastCommit.elapsed() >= SyncInterval)) {
+            // Committing may stall, reads need not wait for it.
+            lock.unlock();
+            commit(file);
+            lock.relock();
+            pending = 0;
+            lastCommit.restart();
+        }
+        if (stop)
+            return;
+        if (!stopping)
+            wake.wait(&mutex, Poll);
+    }
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include "mpscqueue.h"
+
+/// Binary log of every message sent and received.
+///
+/// The file starts with a 16 byte header: the magic "DFTL", the format
+/// version and the wall-clock time the log was opened, in ms since the
+/// epoch. Each message follows as a record of a 12 byte header and the raw
+/// message bytes. The header holds the message length (16 bits), the
+/// direction (1 incoming, 0 outgoing), a padding byte and the time since the
+/// log was opened in ns from a monotonic clock (64 bits). All fields are
+/// little-endian.<BR>
+/// append() only timestamps the message and pushes it onto a lock-free
+/// queue, from any thread. A writer thread of the log's own copies queued
+/// records into a memory-mapped window of the file, which is extended a
+/// Chunk at a time ahead of them, and commits them to disk in groups with
+/// fdatasync() once SyncBytes have been written or SyncInterval has passed.
+/// A disk stall therefore holds up only the writer. Should the queue fill
+/// meanwhile, further messages are dropped and counted rather than waited
+/// for.<BR>
+/// The unused tail is cut off by close(). A log which was never closed ends
+/// in zeros, and a zero length marks the end for convert().<BR>
+/// Records already written can be found by the position append() returned
+/// and read back while the log is open, through a mapping of the Chunk they
+/// are in so that scanning forward costs no system calls, as long as they
+/// are among the last Offsets * Stride or so. Older ones stay in the file,
+/// only their index is let go so that memory stays bounded.
+class TrafficLog
+{
+public:
+    /// Sizes and intervals.
+    enum {
+        Chunk = 1 << 20,       ///< Bytes the file is extended by at a time.
+        FileHeader = 16,       ///< Length of the file header.
+        Offsets = 1 << 15,     ///< Stride offsets kept for find().
+        Poll = 20,             ///< Longest ms the writer sleeps.
+        QueueLength = 4096,    ///< Records which may wait for the writer.
+        RecordHeader = 12,     ///< Length of the header of each record.
+        Stride = 256,          ///< Records between offsets kept for find().
+        SyncBytes = 64 << 10,  ///< Bytes written before a commit is due.
+        SyncInterval = 1000    ///< Longest ms between commits.
+    };
+
+    /// Constructor.
+    TrafficLog();
+
+    /// Destructor, closes the log.
+    ~TrafficLog();
+
+    /// Queue a message for the log, from any thread.
+    /// @return position of the record, for find(), or -1 if the log is not
+    /// open, the message is empty or too long, or the queue is full.
+    /// @param message message, 1 to 65535 bytes.
+    /// @param incoming true if the message was received.
+    qint64 append(QByteArray const &message,
+                  bool incoming);
+
+    /// Write everything queued, commit it and cut the file to what was
+    /// written, then close it.
+    void close();
+
+    /// Write the legacy text logs for a binary log.
+    ///
+    /// Each message becomes a line of the wall-clock time in ms since the
+    /// epoch, a colon and the message bytes in uppercase hex.
+    /// @return false if a file could not be opened or the log is not valid.
+    /// @param path binary log to read.
+    /// @param incomingPath text log to write incoming messages to.
+    /// @param outgoingPath text log to write outgoing messages to.
+    static bool convert(QString const &path,
+                        QString const &incomingPath,
+                        QString const &outgoingPath);
+
+    /// Get the number of messages dropped because the queue was full.
+    /// @return total since open().
+    int droppedCount() { return dropped.fetchAndAddRelaxed(0); }
+
+    /// Find a record written since the log was opened.
+    /// @return file offset of the record, for read(), or -1 if it has not
+    /// been written (yet).
+    /// @param position position append() returned for it.
+    qint64 find(qint64 position);
+
+    /// Check whether the log is open.
+    bool isOpen() { return accepting.fetchAndAddRelaxed(0) != 0; }
+
+    /// Create a log, replacing any file at path, and start its writer.
+    /// @return false if the file could not be created or mapped.
+    /// @param path file to write.
+    bool open(QString const &path);
+
+    /// Get the number of messages waiting for the writer.
+    /// @return current queue depth.
+    int queueDepth() { return queue.size(); }
+
+    /// Read back a record written since the log was opened.
+    /// @return the message, null if offset is not a record.
+    /// @param offset file offset of the record, advanced to the next one.
+    /// @param incoming if not null, set to the direction of the message.
+    QByteArray read(qint64 &offset,
+                    bool *incoming = 0);
+
+protected:
+    /// A message on its way to the writer.
+    struct Record
+    {
+        QByteArray bytes;  ///< The message.
+        bool incoming;     ///< Direction.
+        qint64 time;       ///< When it was queued, in ns since open().
+    };
+
+    /// Runs TrafficLog::write() until the log is closed.
+    class Writer : public QThread
+    {
+    public:
+        /// Constructor.
+        explicit Writer(TrafficLog *log) : log(log) {}
+
+    protected:
+        /// Thread body.
+        void run() { log->write(); }
+
+        /// Log to write.
+        TrafficLog *log;
+    };
+
+    /// Map a new window at the end of what was written, extending the file.
+    /// Called with mutex held.
+    /// @return false if the file could not be extended or mapped.
+    bool extend();
+
+    /// Read the record at offset, with mutex held.
+    QByteArray fetch(qint64 &offset,
+                     bool *incoming);
+
+    /// Copy every queued record into the file, with mutex held.
+    /// @return bytes copied.
+    qint64 take();
+
+    /// Writer thread body, copies queued records into the file and commits
+    /// them until stopping.
+    void write();
+
+    /// Nonzero while append() takes messages.
+    QAtomicInt accepting;
+
+    /// Monotonic clock started when the log was opened.
+    QElapsedTimer clock;
+
+    /// Messages dropped to a full queue.
+    QAtomicInt dropped;
+
+    /// The log file.
+    QFile file;
+
+    /// Value of written when the log was opened, positions count from it.
+    qint64 first;
+
+    /// Guards the file, the window and the index from the writer thread.
+    QMutex mutex;
+
+    /// Messages on their way to the writer.
+    MpscQueue<Record, QueueLength> queue;
+
+    /// Length of readWindow.
+    qint64 readLength;
+
+    /// File offset of readWindow.
+    qint64 readStart;
+
+    /// Mapped part of the file before window, for reading records back,
+    /// null if none.
+    uchar *readWindow;
+
+    /// Set, with mutex held, to have the writer finish.
+    bool stopping;
+
+    /// Offset of every Stride'th record written, the last Offsets to
+    /// 2 * Offsets of them.
+    QVector<qint64> strides;
+
+    /// Offsets dropped from the front of strides.
+    qint64 trimmed;
+
+    /// Bytes of the file written, header included.
+    qint64 used;
+
+    /// Woken to have the writer look at the queue before Poll is up.
+    QWaitCondition wake;
+
+    /// Mapped window of the file, null if not open.
+    uchar *window;
+
+    /// Length of window.
+    qint64 windowLength;
+
+    /// File offset of window.
+    qint64 windowStart;
+
+    /// Records taken off the queue since construction, written or not.
+    qint64 written;
+
+    /// The writer thread.
+    Writer writer;
+};
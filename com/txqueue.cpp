@@ -0,0 +1,234 @@
+#include "txqueue.h"
+#include <string.h>
+#include <QIODevice>
+#include <QTimer>
+
+TxQueue::TxQueue(QObject *parent) :
+    QObject(parent), batchLength(0), batchTimer(new QTimer(this)),
+    bytesPerSecond(0), clock(), controlLength(0), controlQueued(0), device(0),
+    dropped(0), gather(false), inFlight(0), lastSettle(0),
+    statsTimer(new QTimer(this)), superseded(0), timer(new QTimer(this)),
+    writeCalls(0), writeErrors(0)
+{
+    qRegisterMetaType<TxQueue::Stats>("TxQueue::Stats");
+    memset(figures, 0, sizeof(figures));
+    memset(&reported, 0, sizeof(reported));
+    clock.start();
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), this, SLOT(drain()));
+    batchTimer->setSingleShot(true);
+    connect(batchTimer, SIGNAL(timeout()), this, SLOT(writeBatch()));
+    connect(statsTimer, SIGNAL(timeout()), this, SLOT(updateStats()));
+}
+
+void TxQueue::drain()
+{
+    if (!device)
+        return;
+    settle();
+    for (;;) {
+        if (controlLength) {
+            if (!fits(controlLength))
+                break;
+            unsigned int length = controlLength;
+            controlLength = 0;
+            transmit(Control, control, length, controlQueued);
+            continue;
+        }
+        int next = 0;
+        while (next < Classes && pending[next].isEmpty())
+            next++;
+        if (next == Classes ||
+                !fits(pending[next].first().frame.length()))
+            break;
+        Pending frame = pending[next].takeFirst();
+        transmit((Class)next, (unsigned char const *)frame.frame.constData(),
+                 frame.frame.length(), frame.queued);
+    }
+    schedule();
+}
+
+bool TxQueue::fits(unsigned int length) const
+{
+    return bytesPerSecond == 0 || inFlight <= 0 ||
+            inFlight + length <= Window;
+}
+
+void TxQueue::flush()
+{
+    int rate = bytesPerSecond;
+    bytesPerSecond = 0;
+    drain();
+    bytesPerSecond = rate;
+    writeBatch();
+}
+
+void TxQueue::schedule()
+{
+    unsigned int length = controlLength;
+    for (int i = 0; i < Classes && !length; i++)
+        if (!pending[i].isEmpty())
+            length = pending[i].first().frame.length();
+    if (!length || bytesPerSecond == 0) {
+        timer->stop();
+        return;
+    }
+    // Time until enough of what is in flight has gone for the frame to fit.
+    double excess = inFlight + length - Window;
+    int ms = (int)(excess * 1000 / bytesPerSecond) + 1;
+    timer->start(qMax(ms, 1));
+}
+
+void TxQueue::setDevice(QIODevice *device, int bytesPerSecond, bool gather)
+{
+    this->device = device;
+    this->bytesPerSecond = qMax(0, bytesPerSecond);
+    this->gather = gather;
+    batchLength = 0;
+    batchTimer->stop();
+    controlLength = 0;
+    for (int i = 0; i < Classes; i++)
+        pending[i].clear();
+    inFlight = 0;
+    lastSettle = clock.nsecsElapsed();
+    timer->stop();
+    if (device)
+        statsTimer->start(1000);
+    else
+        statsTimer->stop();
+}
+
+void TxQueue::settle()
+{
+    qint64 now = clock.nsecsElapsed();
+    inFlight = qMax(0.0, inFlight - (now - lastSettle) * 1e-9 *
+                    bytesPerSecond);
+    lastSettle = now;
+}
+
+TxQueue::Stats TxQueue::stats() const
+{
+    Stats result = reported;
+    for (int i = 0; i < Classes; i++)
+        result.depth[i] = pending[i].length();
+    if (controlLength)
+        result.depth[Control]++;
+    double sent = (clock.nsecsElapsed() - lastSettle) * 1e-9 * bytesPerSecond;
+    result.inFlight = (int)qMax(0.0, inFlight - sent);
+    return result;
+}
+
+void TxQueue::transmit(Class priority, unsigned char const *frame,
+                       unsigned int length, qint64 queued)
+{
+    if (gather) {
+        if (batchLength + length > sizeof(batch))
+            writeBatch();
+        if (batchLength + length > sizeof(batch)) {
+            // The device has not taken anything for a while, drop the frame
+            // rather than a part of one.
+            dropped++;
+            return;
+        }
+        memcpy(batch + batchLength, frame, length);
+        batchLength += length;
+        if (priority == Control)
+            writeBatch();
+        else if (!batchTimer->isActive())
+            batchTimer->start(0);
+    } else {
+        if (device->write((char const *)frame, length) != length)
+            writeErrors++;
+        writeCalls++;
+    }
+    emit frameWritten(frame, length);
+    if (bytesPerSecond)
+        inFlight += length;
+    qint64 latency = clock.nsecsElapsed() - queued;
+    figures[priority].latencySum += latency;
+    figures[priority].latencyWorst = qMax(figures[priority].latencyWorst,
+                                          latency);
+    figures[priority].written++;
+}
+
+void TxQueue::updateStats()
+{
+    for (int i = 0; i < Classes; i++) {
+        Figures &figure = figures[i];
+        reported.latency[i] = figure.written?
+                    figure.latencySum * 1e-6 / figure.written : 0;
+        reported.maxLatency[i] = figure.latencyWorst * 1e-6;
+        reported.written[i] = figure.written;
+        figure.latencySum = 0;
+        figure.latencyWorst = 0;
+        figure.written = 0;
+    }
+    reported.dropped = dropped;
+    reported.superseded = superseded;
+    reported.writeErrors = writeErrors;
+    reported.writes = writeCalls;
+    dropped = 0;
+    superseded = 0;
+    writeCalls = 0;
+    writeErrors = 0;
+    emit statsChanged(stats());
+}
+
+bool TxQueue::waiting(Class priority) const
+{
+    if (controlLength)
+        return true;
+    for (int i = 0; i <= priority; i++)
+        if (!pending[i].isEmpty())
+            return true;
+    return false;
+}
+
+void TxQueue::writeBatch()
+{
+    batchTimer->stop();
+    if (!device || !batchLength)
+        return;
+    unsigned int done = 0;
+    while (done < batchLength) {
+        qint64 count = device->write((char const *)batch + done,
+                                     batchLength - done);
+        writeCalls++;
+        if (count <= 0)
+            break;
+        done += count;
+    }
+    batchLength -= done;
+    if (batchLength) {
+        // Keep the rest in order for another attempt.
+        writeErrors++;
+        memmove(batch, batch + done, batchLength);
+        batchTimer->start(Retry);
+    }
+}
+
+void TxQueue::write(Class priority, unsigned char const *frame,
+                    unsigned int length)
+{
+    if (!device || !length)
+        return;
+    settle();
+    qint64 now = clock.nsecsElapsed();
+    if (!waiting(priority) && fits(length)) {
+        transmit(priority, frame, length, now);
+        return;
+    }
+    if (priority == Control && length <= sizeof(control)) {
+        if (controlLength)
+            superseded++;
+        memcpy(control, frame, length);
+        controlLength = length;
+        controlQueued = now;
+    } else {
+        Pending entry;
+        entry.frame = QByteArray((char const *)frame, length);
+        entry.queued = now;
+        pending[priority].append(entry);
+    }
+    drain();
+}
@@ -0,0 +1,229 @@
+#pragma once
+#include <stdint.h>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include "framebuilder.h"
+
+class QIODevice;
+class QTimer;
+
+/// Priority queue in front of the serial port.
+///
+/// Frames are written in order of class, controls first, then short
+/// commands such as alarm acknowledgements and the connection handshake,
+/// then bulk config traffic. Only the newest control frame is kept while
+/// waiting, a newer one replaces it.<BR>
+/// The bytes written but not yet on the air are estimated from the line
+/// rate, and a frame is only written while they fit in a window of two
+/// XBee packets. Everything else waits in the queue, where a frame of a
+/// higher class can overtake it. A long message split into fragments
+/// therefore delays a control frame by at most one fragment.<BR>
+/// Without a line rate, e.g. for a FleetPort which does its own pacing,
+/// every frame is written straight away.<BR>
+/// On a serial port the frames written in one pass of the event loop are
+/// collected in a fixed buffer and handed over in a single write. A control
+/// frame is written straight away, behind whatever was collected before it,
+/// so it never waits for the end of the pass and nothing is allocated per
+/// frame. A short or failed write keeps the rest of the buffer, in order,
+/// for another attempt Retry ms later. Any other device gets one write()
+/// per frame, as a FleetPort expects.
+class TxQueue : public QObject
+{
+    Q_OBJECT
+public:
+    /// Traffic classes, highest priority first.
+    enum Class {
+        Control,  ///< Control messages, only the newest matters.
+        Command,  ///< Short messages which must go promptly.
+        Bulk,     ///< Config messages, telemetry requests and fragments.
+        Classes   ///< Number of classes.
+    };
+
+    /// Figures for the last second.
+    struct Stats
+    {
+        int depth[Classes];          ///< Frames waiting in each class, now.
+        quint64 dropped;             ///< Frames dropped for want of room
+                                     ///< to collect them.
+        int inFlight;                ///< Bytes estimated on the line, now.
+        double latency[Classes];     ///< Mean ms from queued to written.
+        double maxLatency[Classes];  ///< Worst ms from queued to written.
+        quint64 superseded;          ///< Control frames replaced waiting.
+        quint64 writeErrors;         ///< Writes which failed or fell short.
+        quint64 writes;              ///< Write calls made to the device.
+        quint64 written[Classes];    ///< Frames written in each class.
+    };
+
+    /// Sizes and intervals.
+    enum {
+        /// Bytes collected for one write, room for two frames of any size.
+        Batch = 2 * (FrameBuilder::Header + FrameBuilder::Capacity + 1),
+        /// ms before writing the rest of a batch after a failed write.
+        Retry = 10,
+        /// Bytes which may be written but not yet sent before frames are
+        /// held.
+        Window = 2 * (FrameBuilder::Header + FrameBuilder::Fragment + 1)
+    };
+
+    /// Constructor.
+    explicit TxQueue(QObject *parent = 0);
+
+    /// Write every waiting frame straight away, whatever the line rate,
+    /// including any collected for a gathering write.
+    void flush();
+
+    /// Set the device written to, dropping any waiting or collected frames.
+    /// @param device device to write to, null to stop writing.
+    /// @param bytesPerSecond line rate to pace writes at, 0 for unpaced.
+    /// @param gather true to collect the frames of one pass of the event
+    /// loop into one write, for a serial port.
+    void setDevice(QIODevice *device,
+                   int bytesPerSecond,
+                   bool gather = false);
+
+    /// Get the figures for the last second.
+    /// @return depth and in flight are current, the rest are as last
+    /// reported by statsChanged().
+    Stats stats() const;
+
+    /// Write a frame, or queue it if the line is busy.
+    /// @param priority class of the frame.
+    /// @param frame first byte of a complete frame.
+    /// @param length length of the frame.
+    void write(Class priority,
+               unsigned char const *frame,
+               unsigned int length);
+
+signals:
+    /// Emitted as each frame leaves the queue for the device, in the order
+    /// they go out. Only for direct connections, frame is not kept.
+    /// @param frame first byte of the frame.
+    /// @param length length of the frame.
+    void frameWritten(unsigned char const *frame,
+                      unsigned int length);
+
+    /// Emitted once a second while a device is set.
+    /// @param stats figures for the last second.
+    void statsChanged(TxQueue::Stats const &stats);
+
+protected:
+    /// A frame waiting to be written.
+    struct Pending
+    {
+        QByteArray frame;  ///< The frame.
+        qint64 queued;     ///< When it was queued, in ns since clock start.
+    };
+
+    /// Per class figures of the current stats window.
+    struct Figures
+    {
+        qint64 latencySum;    ///< Sum of latencies, in ns.
+        qint64 latencyWorst;  ///< Worst latency, in ns.
+        quint64 written;      ///< Frames written.
+    };
+
+    /// Check whether a frame fits the window now.
+    bool fits(unsigned int length) const;
+
+    /// Arm the timer for when the first waiting frame will fit the window.
+    void schedule();
+
+    /// Bring the bytes in flight up to date.
+    void settle();
+
+    /// Write a frame to the device, or collect it for writeBatch().
+    ///
+    /// A frame there is no room to collect is dropped and counted, and is
+    /// not reported by frameWritten().
+    /// @param priority class of the frame.
+    /// @param frame first byte of the frame.
+    /// @param length length of the frame.
+    /// @param queued when it was queued, in ns since clock start.
+    void transmit(Class priority,
+                  unsigned char const *frame,
+                  unsigned int length,
+                  qint64 queued);
+
+    /// Check whether anything of a class or a higher one is waiting.
+    bool waiting(Class priority) const;
+
+    /// Frames collected for the next write.
+    unsigned char batch[Batch];
+
+    /// Bytes in batch.
+    unsigned int batchLength;
+
+    /// Fires once the current pass of the event loop is done, or Retry ms
+    /// after a failed write, to write the collected frames.
+    QTimer *batchTimer;
+
+    /// Line rate, 0 if unpaced.
+    int bytesPerSecond;
+
+    /// Clock for pacing and latency.
+    QElapsedTimer clock;
+
+    /// Newest control frame waiting, valid if controlLength.
+    unsigned char control[FrameBuilder::Header + FrameBuilder::Fragment + 1];
+
+    /// Length of the waiting control frame, 0 if none.
+    unsigned int controlLength;
+
+    /// When the waiting control frame was queued.
+    qint64 controlQueued;
+
+    /// Device written to, or null.
+    QIODevice *device;
+
+    /// Frames dropped in the current stats window.
+    quint64 dropped;
+
+    /// Figures of the current stats window, per class.
+    Figures figures[Classes];
+
+    /// Collect frames into batch rather than writing each.
+    bool gather;
+
+    /// Bytes estimated written but not yet sent.
+    double inFlight;
+
+    /// Time inFlight was last brought up to date, in ns since clock start.
+    qint64 lastSettle;
+
+    /// Frames waiting per class, oldest first, controls only if they do not
+    /// fit control.
+    QList<Pending> pending[Classes];
+
+    /// Figures from the last complete stats window.
+    Stats reported;
+
+    /// Closes the stats window once a second.
+    QTimer *statsTimer;
+
+    /// Control frames replaced in the current stats window.
+    quint64 superseded;
+
+    /// Fires when the first waiting frame fits the window.
+    QTimer *timer;
+
+    /// Write calls made in the current stats window.
+    quint64 writeCalls;
+
+    /// Failed or short writes in the current stats window.
+    quint64 writeErrors;
+
+protected slots:
+    /// Write waiting frames as the window allows.
+    void drain();
+
+    /// Close the current stats window.
+    void updateStats();
+
+    /// Write the collected frames in one call, continuing a short write.
+    void writeBatch();
+};
+
+Q_DECLARE_METATYPE(TxQueue::Stats)
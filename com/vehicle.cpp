@@ -1,26 +1,115 @@
 #include "vehicle.h"
+#include <string.h>
 #include <QTimer>
 #include <QtEndian>
 #include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include "com/controlscheduler.h"
+#include "com/crc16.h"
+#include "com/tea.h"
 #include "com/serial/qextserialport.h"
 #include "com/remotecontroller.h"
 
+namespace {
+/// Acquires sent before the first query, see Vehicle::onTimer().
+unsigned int const queryAfter = 5;
+
+/// Local XBee module MAC addresses by serial port name, shared by every
+/// Vehicle whichever thread it runs on.
+QHash<QString, quint64> localMacs;
+QMutex localMacsMutex;
+
+/// Check whether a device is a serial port, whose frames are gathered into
+/// one write per pass of the event loop, see TxQueue.
+bool isSerialPort(QIODevice *device)
+{
+    return qobject_cast<QextSerialPort *>(device) != 0;
+}
+
+/// Get the name of the serial port behind a device.
+/// @return port name, empty if the device is not a serial port.
+QString portNameOf(QIODevice *device)
+{
+    QextSerialPort *port = qobject_cast<QextSerialPort *>(device);
+    return port? port->portName() : QString();
+}
+
+/// Get the line rate to pace writes to a device at.
+/// @return bytes per second, 0 if the device is not a serial port.
+int lineRate(QIODevice *device)
+{
+    QextSerialPort *port = qobject_cast<QextSerialPort *>(device);
+    if (!port)
+        return 0;
+    switch (port->baudRate()) {
+    case BAUD115200:
+        return 11520;
+    case BAUD57600:
+        return 5760;
+    case BAUD38400:
+        return 3840;
+    case BAUD19200:
+        return 1920;
+    case BAUD9600:
+        return 960;
+    default:
+        return 0;
+    }
+}
+
+/// Get a TEA engine for key, reusing the round keys of the API key.
+Tea teaFor(uint32_t const key[])
+{
+    static Tea const apiTea(teaKey);
+    return memcmp(key, teaKey, sizeof(teaKey))? Tea(key) : apiTea;
+}
+}
+
 Vehicle::Vehicle(QObject *parent) :
-    QObject(parent), buffer(), bufferMutex(), bypassMode(false), channel(0),
-    config(false), connAttempt(0), controls(), controlsInterval(0),
-    controlsTimer(new QTimer(this)), enumAttempt(0), haveMacLow(false),
-    iter(0), localMac(0), macLowBytes(0), motors(), remoteMac(0),
-    serialMutex(), serialPort(0), state(IDLE), streamingTelemetry(false),
-    throttleMode(-1), timer(new QTimer(this)), zigbee(true)
+    QObject(parent), acquires(0), buffer(), builder(), bypassMode(false),
+    channel(0),
+    config(false), connAttempt(0), controlPacket(), controlRate(50),
+    controls(), controlsInterval(0),
+    controlScheduler(new ControlScheduler(this)), enumAnswered(false),
+    enumAttempt(0), enumChannels(), enumKnown(0), haveMacLow(false),
+    iter(0), localMac(0), macLowBytes(0), motors(),
+    rateController(new RateController(this)), reducedControls(false),
+    remoteMac(0), rxArrival(0),
+    rxClock(), rxFrames(0), rxLatencySum(0), rxLatencyWorst(0),
+    rxWindowStart(0), serialPort(0), state(IDLE), streamingTelemetry(false),
+    throttleMode(-1), timer(new QTimer(this)), txQueue(new TxQueue(this)),
+    zigbee(true)
 {
+    // Needed for queued connections when running on a separate thread.
+    qRegisterMetaType<Telemetry1Frame>("Telemetry1Frame");
+    qRegisterMetaType<Telemetry2Frame>("Telemetry2Frame");
+    qRegisterMetaType<Vehicle::VehicleState>("Vehicle::VehicleState");
+    qRegisterMetaType<QHostAddress>("QHostAddress");
+    qRegisterMetaType<int16_t>("int16_t");
+    qRegisterMetaType<uint8_t>("uint8_t");
+    qRegisterMetaType<uint64_t>("uint64_t");
     connect(timer, SIGNAL(timeout()),
             this, SLOT(onTimer()));
     connect(this, SIGNAL(message(QByteArray,bool)),
             this, SLOT(onMessage(QByteArray,bool)));
-    connect(controlsTimer, SIGNAL(timeout()),
-            this, SLOT(sendControl()));
+    connect(controlScheduler, SIGNAL(tick(int)),
+            this, SLOT(sendControl(int)));
+    connect(txQueue, SIGNAL(statsChanged(TxQueue::Stats)),
+            this, SIGNAL(txStatsChanged(TxQueue::Stats)));
+    connect(txQueue, SIGNAL(frameWritten(unsigned char const*,unsigned int)),
+            this, SLOT(onFrameWritten(unsigned char const*,unsigned int)),
+            Qt::DirectConnection);
+    connect(rateController, SIGNAL(levelChanged(int,double,int)),
+            this, SLOT(onLinkLevelChanged()));
+    connect(rateController, SIGNAL(levelChanged(int,double,int)),
+            this, SIGNAL(linkLevelChanged(int,double,int)));
     timer->start(100);
-    controlsTimer->start(20);
+    rxClock.start();
+    // Queued so that the scheduler starts in whichever thread this Vehicle
+    // ends up running in.
+    QMetaObject::invokeMethod(controlScheduler, "start", Qt::QueuedConnection);
 }
 
 Vehicle::~Vehicle()
@@ -36,57 +125,32 @@ void Vehicle::armHeli()
 
 unsigned char Vehicle::checksum(unsigned char const *data, unsigned int length)
 {
-    unsigned char sum = 0;
-    for (unsigned int i = 0; i < length; i++)
-        sum += data[i];
-    return 0xFFU - sum;
+    return FrameBuilder::checksum(data, length);
 }
 
 void Vehicle::close()
 {
     if (state == CONNECTED && !config && !zigbee)
         sendMessage(6, 0, 0);
-    bool gotMutex = serialMutex.tryLock(200);
+    // Whatever is still waiting, including the above, goes before the port.
+    txQueue->flush();
+    txQueue->setDevice(0, 0);
     if (serialPort)
         QMetaObject::invokeMethod(serialPort, "deleteLater", Qt::QueuedConnection);
     serialPort = 0;
-    if (gotMutex)
-        serialMutex.unlock();
     state = IDLE;
     emit stateChanged(state);
 }
 
 uint16_t Vehicle::crc(unsigned char const *input, unsigned int length)
 {
-    uint16_t CRC = 0xFFFFU;
-    bool carry;
-    for (unsigned int i = 0; i < length; i++) {
-        CRC ^= input[i];
-        for (int j = 0; j < 8; j++) {
-            carry = CRC & 0x1;
-            CRC >>= 1;
-            if (carry)
-                CRC ^= 0xA001U;
-        }
-    }
-    return CRC;
+    return Crc16::compute(input, length);
 }
 
 void Vehicle::decrypt(unsigned char const *data, unsigned char *output,
                       uint32_t const key[], uint32_t skip, uint32_t count)
 {
-    uint32_t delta = 0x9E3779B9, num_rounds = 32, sum = delta * num_rounds;
-    int32_t v[2];
-    for (uint32_t i = 0; i < (count >> 3); i++, sum = delta * num_rounds) {
-        memcpy(v, data + skip + (i << 3), 8);
-        for (uint32_t n = 0; n < num_rounds; n++) {
-            v[1] -= ((v[0] << 4 ^ v[0] >> 5) + v[0]) ^
-                    (sum + key[(sum >> 11) & 3]);
-            sum -= delta;
-            v[0] -= ((v[1] << 4 ^ v[1] >> 5) + v[1]) ^ (sum + key[sum & 3]);
-        }
-        memcpy(output + skip + (i << 3), v, 8);
-    }
+    teaFor(key).decrypt(data, output, skip, count);
 }
 
 void Vehicle::disarmHeli()
@@ -98,18 +162,7 @@ void Vehicle::disarmHeli()
 void Vehicle::encrypt(unsigned char const *data, unsigned char *output,
                       uint32_t const key[], uint32_t skip, uint32_t count)
 {
-    uint32_t delta = 0x9E3779B9, num_rounds = 32, sum = 0;
-    int32_t v[2];
-    for (uint32_t i = 0; i < (count >> 3); i++, sum = 0) {
-        memcpy(v, data + skip + (i << 3), 8);
-        for (uint32_t n = 0; n < num_rounds; n++) {
-            v[0] += ((v[1] << 4 ^ v[1] >> 5) + v[1]) ^ (sum + key[sum & 3]);
-            sum += delta;
-            v[1] += ((v[0] << 4 ^ v[0] >> 5) + v[0]) ^
-                    (sum + key[(sum >> 11) & 3]);
-        }
-        memcpy(output + skip + (i << 3), v, 8);
-    }
+    teaFor(key).encrypt(data, output, skip, count);
 }
 
 void Vehicle::enterBypass()
@@ -122,50 +175,46 @@ void Vehicle::enterBypass()
 
 void Vehicle::enumerate(QString port)
 {
-    QMutexLocker locker(&serialMutex);
-    if (state == IDLE) {
-        zigbee = true;
-        QextSerialPort *tempPort = new QextSerialPort(port);
-        tempPort->setBaudRate(BAUD57600);
-        tempPort->setParity(PAR_NONE);
-        tempPort->setDataBits(DATA_8);
-        tempPort->setStopBits(STOP_1);
-        tempPort->setFlowControl(FLOW_OFF);
-        if (tempPort->open(QIODevice::ReadWrite)) {
-            tempPort->setDtr(false);
-            connect(tempPort, SIGNAL(readyRead()),
-                    this, SLOT(onReadyRead()));
-            serialPort = tempPort;
-            channel = 0xC; // first valid channel
-            enumAttempt = 0;
-            state = ENUM;
-            emit stateChanged(state);
-            locker.unlock();
-            setChannel(channel);
-        } else {
-            delete tempPort;
-        }
+    if (state != IDLE)
+        return;
+    QIODevice *device = openXBee(port);
+    if (!device)
+        return;
+    QList<uint8_t> channels;
+    for (uint8_t i = 0xC; i <= 0x17; i++)
+        channels.append(i);
+    enumerate(device, channels, channels.length());
+}
+
+void Vehicle::enumerate(QIODevice *device, QList<uint8_t> channels,
+                        int known)
+{
+    if (state != IDLE || !device)
+        return;
+    if (channels.isEmpty()) {
+        delete device;
+        return;
     }
+    zigbee = true;
+    connect(device, SIGNAL(readyRead()),
+            this, SLOT(onReadyRead()));
+    serialPort = device;
+    txQueue->setDevice(device, lineRate(device), isSerialPort(device));
+    channel = channels.takeFirst();
+    enumChannels = channels;
+    enumKnown = known;
+    enumAnswered = false;
+    enumAttempt = 0;
+    state = ENUM;
+    emit stateChanged(state);
+    setChannel(channel);
 }
 
 void Vehicle::getLocalMac(bool highBytes)
 {
     if (!zigbee)
         return;
-    QByteArray packet = QByteArray(8, '\0');
-    packet[0] = 0x7E;
-    packet[1] = 0x0;
-    packet[2] = 0x4;
-    packet[3] = 0x8;
-    packet[4] = 0x1;
-    packet[5] = 'S';
-    packet[6] = highBytes? 'H' : 'L';
-    packet[7] = checksum((unsigned char const *)packet.constData() + 3, 4);
-    QMutexLocker locker(&serialMutex);
-    if (serialPort) {
-        serialPort->write(packet);
-        emit message(packet, false);
-    }
+    write(builder.atCommand(0x1, highBytes? "SH" : "SL", 0, 0), 8);
 }
 
 void Vehicle::leaveBypass()
@@ -176,6 +225,14 @@ void Vehicle::leaveBypass()
     }
 }
 
+void Vehicle::onFrameWritten(unsigned char const *frame, unsigned int length)
+{
+    // The Vehicle's own onMessage() ignores outgoing messages, so only pay
+    // for a copy if anything else is listening.
+    if (receivers(SIGNAL(message(QByteArray,bool))) > 1)
+        emit message(QByteArray((char const *)frame, length), false);
+}
+
 void Vehicle::onMessage(QByteArray message, bool incoming)
 {
     unsigned char const *data = (unsigned char const *)message.constData();
@@ -187,124 +244,88 @@ void Vehicle::onMessage(QByteArray message, bool incoming)
                     data[14] == 0x1) { // Query response
                 state = CONNECTED;
                 emit stateChanged(CONNECTED);
+                // Repeat the throttle mode read sent with the query in case
+                // the vehicle had not been acquired by then.
+                if (throttleMode < 0)
+                    sendMessage(2, 16, 0);
             }
             if (state == CONNECTED && sourceMac == remoteMac &&
                     data[14] == 0x3) { // Alarm
                 if (data[28]) { // Ack is required
-                    QByteArray response(4, 0x0);
+                    unsigned char *response = builder.begin();
                     response[0] = 4;
                     response[1] = 1;
-                    qToLittleEndian(crc((unsigned char const *)
-                                        response.constData(), 2),
-                                    (unsigned char *)(response.data() + 2));
-                    send(response, remoteMac);
+                    qToLittleEndian(crc(response, 2), response + 2);
+                    send(4, remoteMac);
                 }
             }
-            if (state == ENUM && data[14] == 0xF8) // Enumeration response
+            if (state == ENUM && data[14] == 0xF8) { // Enumeration response
+                enumAnswered = true;
                 emit vehicleFound(sourceMac, data[31] + 0xC);
+            }
         } else if (type == 0x88 && data[7] == 0) { // Module configuration
             if (message[5] == 'S' && message[6] == 'H' && haveMacLow) {
                 // High 4 bytes of local MAC address
                 uint64_t macHigh = qFromBigEndian<uint32_t>(
                             (unsigned char const *)message.constData() + 8);
-                localMac = (macHigh << 32) | macLowBytes;
+                uint64_t mac = (macHigh << 32) | macLowBytes;
+                QString port = portNameOf(serialPort);
+                if (!port.isEmpty()) {
+                    QMutexLocker lock(&localMacsMutex);
+                    localMacs.insert(port, mac);
+                }
+                // Acquire at once, or again if the cached address was wrong.
+                if (mac != localMac) {
+                    localMac = mac;
+                    if (state == CONNECTING)
+                        sendAcquire();
+                }
             } else if (message[5] == 'S' && message[6] == 'L') {
                 // Low 4 bytes of local MAC address
                 macLowBytes = qFromBigEndian<uint32_t>(
                             (unsigned char const *)message.constData() + 8);
                 haveMacLow = true;
+                if (state == CONNECTING)
+                    getLocalMac(true);
             }
         } else if (type == 0x8A && data[4] == 0) // XBee reset, set channel
             setChannel(channel);
     }
 }
 
+void Vehicle::onLinkLevelChanged()
+{
+    controlPacket.setReduced(
+                reducedControls &&
+                rateController->level() >= RateController::Reduced);
+    controlScheduler->setRate(rateController->controlRate(controlRate));
+}
+
 void Vehicle::onReadyRead()
 {
-    QMutexLocker bufferLocker(&bufferMutex);
-    QMutexLocker serialLocker(&serialMutex);
     if (serialPort == 0)
         return;
-    buffer.append(serialPort->read(serialPort->bytesAvailable()));
-    serialLocker.unlock();
-    while (buffer.length() >= (zigbee? 5 : 6)) {
-        unsigned char const *data = (unsigned char const *)buffer.constData();
-        if ((zigbee && data[0] == 0x7E) ||
-                (!zigbee && (data[0] == 0xFF || data[0] == 0xFE))) {
-            uint16_t length = qFromBigEndian<uint16_t>(data + (zigbee? 1 : 2));
-            if (zigbee) {
-                if (length == 0 || length > 95) {
-                    // Invalid length
-                    buffer.remove(0, 1);
-                    continue;
-                }
-                if (length + 4 > buffer.length()) {
-                    // Length appears reasonable but exceeds bytes available.
-                    // Leave buffer unmodified and return waiting for remainder
-                    // of packet to arrive.
-                    return;
-                }
-                if (checksum(data + 3, length + 1)) {
-                    // Checksum failed
-                    buffer.remove(0, 1);
-                    continue;
-                }
-                if (data[3] == 0x80 &&
-                    qFromBigEndian<quint64>(data + 4) == remoteMac &&
-                    data[14] == 0xFF &&
-                    !parseConfigMessage(
-                            QByteArray((char const *)(data + 14),
-                                       length - 11))) {
-                    // Was a config message, but parsing failed.
-                    buffer.remove(0, 1);
-                    continue;
-                }
-                // Appears to be a valid message.
-                emit message(QByteArray((char const *)data, length + 4), true);
-                buffer.remove(0, length + 4);
-            } else {
-                // In wired mode the maximum length is effectively the range of
-                // an unsigned 16-bit int. However, 200 is longer than any
-                // actual message in case a bad message has unreasonable length
-                // we don't want to wait for all of it to arrive before
-                // continuing.
-                if (length > 200) {
-                    buffer.remove(0, 1);
-                    continue;
-                }
-                // Length is reasonable but incomplete, wait for the remainder.
-                if (length + 6 > buffer.length()) {
-                    return;
-                }
-                QByteArray newMessage((char const *)data, length + 6);
-                if (parseConfigMessage(newMessage)) { // Valid message
-                    emit message(newMessage, true);
-                    buffer.remove(0, length + 6);
-                    continue;
-                } else { // Parsing failed
-                    buffer.remove(0, 1);
-                    continue;
-                }
-            }
-        } else {
-            // Buffer does not start with a valid delimiter.
-            // Trim to the first delimiter found, or clear the buffer if none.
-            int delim = -1;
-            if (zigbee) {
-                delim = buffer.indexOf(0x7E);
-            } else {
-                int FE_delim = buffer.indexOf((char)0xFE);
-                int FF_delim = buffer.indexOf((char)0xFF);
-                if (FF_delim < 0 || FE_delim < FF_delim)
-                    delim = FE_delim;
-                else
-                    delim = FF_delim;
-            }
-            if (delim > 0)
-                buffer.remove(0, delim);
-            else
-                buffer.clear();
-        }
+    rxArrival = rxClock.nsecsElapsed();
+    char chunk[1024];
+    // A port which does not wait in read() is read straight into chunk
+    // until it has nothing left, anything else only as far as it says is
+    // available.
+    bool drain = isNonBlocking(serialPort);
+    qint64 available = drain? (qint64)sizeof(chunk) :
+                              serialPort->bytesAvailable();
+    while (available > 0) {
+        qint64 count = serialPort->read(
+                    chunk, qMin<qint64>(available, sizeof(chunk)));
+        if (count <= 0)
+            break;
+        if (!drain)
+            available -= count;
+        buffer.append(chunk, count);
+        // Scan after every chunk so a burst larger than the buffer capacity
+        // is never discarded unparsed.
+        scanBuffer();
+        if (serialPort == 0)
+            return;
     }
 }
 
@@ -316,13 +337,19 @@ void Vehicle::onTimer()
         break;
     case ENUM:
     {
-        if (enumAttempt++ % 3 == 2) {
-            if (++channel > 0x17)
-                close();
-            else
-                setChannel(channel);
-        } else {
+        // Channels which are known or have answered get a second request
+        // in case more than one vehicle is listening.
+        unsigned int requests = (enumKnown > 0 || enumAnswered)? 2 : 1;
+        if (enumAttempt++ < requests) {
             sendEnumRequest();
+        } else if (enumChannels.isEmpty()) {
+            close();
+        } else {
+            channel = enumChannels.takeFirst();
+            enumKnown--;
+            enumAnswered = false;
+            enumAttempt = 0;
+            setChannel(channel);
         }
     }
         break;
@@ -331,19 +358,25 @@ void Vehicle::onTimer()
         if (connAttempt++ > 100) {
             close();
         } else if (zigbee) {
+            // Responses drive the handshake, this only repeats whatever
+            // went unanswered.
             if (localMac == 0) {
                 getLocalMac(haveMacLow);
             } else {
-                if (iter % 2 == 0)
-                    sendAcquire();
-                // Queries are only sent after several acquires have been sent,
-                // this is to allow the present program to switch between
-                // config-only and master modes. Without this delay it would be
-                // possible for the vehicle to miss the acquire and interpret
-                // the subsequent query as a request to reconnect in the
-                // previous mode.
-                else if (connAttempt > 10)
+                // A query is only ever sent straight behind an acquire, and
+                // only once several acquires have been sent, this is to
+                // allow the present program to switch between config-only
+                // and master modes. Otherwise it would be possible for the
+                // vehicle to miss the acquire and interpret the query as a
+                // request to reconnect in the previous mode.
+                sendAcquire();
+                if (acquires >= queryAfter) {
                     sendQuery();
+                    // Read the throttle mode at the same time so controls
+                    // are usable as soon as the query is answered.
+                    if (throttleMode < 0)
+                        sendMessage(2, 16, 0);
+                }
             }
         } else { // Wired mode
             if (config) {
@@ -366,7 +399,8 @@ void Vehicle::onTimer()
             sendMessage(2, 16, 0);
         // Bit-packed telemetry messages need to be requested periodically or
         // they time-out.
-        if (streamingTelemetry && (iter % 10 == 0))
+        if (streamingTelemetry &&
+                (iter % (rateController->keepaliveInterval() / 100) == 0))
             sendMessage(1, 22, 1);
     }
         break;
@@ -391,7 +425,6 @@ void Vehicle::onUdpMessage(QByteArray msg, bool incoming)
 
 void Vehicle::open(QString port, bool config)
 {
-    QMutexLocker locker(&serialMutex);
     if (state != IDLE)
         return;
     zigbee = false;
@@ -403,14 +436,14 @@ void Vehicle::open(QString port, bool config)
     tempPort->setDataBits(DATA_8);
     tempPort->setStopBits(STOP_1);
     tempPort->setFlowControl(FLOW_OFF);
-    if (tempPort->open(QIODevice::ReadWrite)) {
+    if (tempPort->open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
         tempPort->setDtr(true);
         serialPort = tempPort;
+        txQueue->setDevice(tempPort, lineRate(tempPort), true);
         connect(tempPort, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
         connAttempt = 0;
         state = CONNECTING;
         emit stateChanged(CONNECTING);
-        locker.unlock();
         //if (!config) // Try to set bypass-mode
         //    sendMessage(6, 0, 1);
     } else {
@@ -420,39 +453,48 @@ void Vehicle::open(QString port, bool config)
 
 void Vehicle::open(QString port, uint64_t vehicleMac, uint8_t channel, bool config)
 {
-    QMutexLocker locker(&serialMutex);
     if (state != IDLE)
         return;
+    QIODevice *device = openXBee(port);
+    if (device)
+        open(device, vehicleMac, channel, config);
+}
+
+void Vehicle::open(QIODevice *device, uint64_t vehicleMac, uint8_t channel,
+                   bool config)
+{
+    if (state != IDLE || !device)
+        return;
     remoteMac = vehicleMac;
     this->channel = channel;
     zigbee = true;
     this->config = config;
-    QextSerialPort *tempPort = new QextSerialPort(port);
-    tempPort->setBaudRate(BAUD57600);
-    tempPort->setParity(PAR_NONE);
-    tempPort->setDataBits(DATA_8);
-    tempPort->setStopBits(STOP_1);
-    tempPort->setFlowControl(FLOW_OFF);
-    if (tempPort->open(QIODevice::ReadWrite)) {
-        tempPort->setDtr(false);
-        serialPort = tempPort;
-        connect(tempPort, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
-        connAttempt = 0;
-        localMac = 0;
-        haveMacLow = false;
-        state = CONNECTING;
-        emit stateChanged(CONNECTING);
-        locker.unlock();
-        setChannel(channel);
-    } else {
-        delete tempPort;
+    serialPort = device;
+    txQueue->setDevice(device, lineRate(device), isSerialPort(device));
+    connect(device, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    acquires = 0;
+    connAttempt = 0;
+    haveMacLow = false;
+    throttleMode = -1;
+    rateController->reset();
+    QString port = portNameOf(device);
+    {
+        QMutexLocker lock(&localMacsMutex);
+        localMac = port.isEmpty()? 0 : localMacs.value(port, 0);
     }
+    state = CONNECTING;
+    emit stateChanged(CONNECTING);
+    setChannel(channel);
+    // The module is asked for its address even when it is cached, in case a
+    // different module has been plugged into the port.
+    getLocalMac(false);
+    if (localMac)
+        sendAcquire();
 }
 
 void Vehicle::open(QHostAddress hostAddress, quint16 hostUdp)
 {
     qDebug()<<"remote open";
-    QMutexLocker locker(&serialMutex);
     if (state != IDLE)
         return;
     zigbee = false;
@@ -460,16 +502,56 @@ void Vehicle::open(QHostAddress hostAddress, quint16 hostUdp)
     RemoteController *tempPort = new RemoteController(hostAddress, hostUdp, false, this);
     if (tempPort->open(QIODevice::ReadWrite)) {
         serialPort = tempPort;
+        txQueue->setDevice(tempPort, lineRate(tempPort));
         connect(tempPort, SIGNAL(message(QByteArray,bool)), this, SLOT(onUdpMessage(QByteArray,bool)));
         connAttempt = 0;
         state = CONNECTING;
         emit stateChanged(CONNECTING);
-        locker.unlock();
     } else {
         delete tempPort;
     }
 }
 
+bool Vehicle::isNonBlocking(QIODevice *device)
+{
+    QextSerialPort *port = qobject_cast<QextSerialPort *>(device);
+    return port && port->isNonBlocking();
+}
+
+void Vehicle::noteRxFrame()
+{
+    qint64 now = rxClock.nsecsElapsed();
+    qint64 latency = now - rxArrival;
+    rxFrames++;
+    rxLatencySum += latency;
+    rxLatencyWorst = qMax(rxLatencyWorst, latency);
+    if (now - rxWindowStart < 1000000000)
+        return;
+    emit rxLatencyChanged(rxLatencySum * 1e-6 / rxFrames,
+                          rxLatencyWorst * 1e-6, rxFrames);
+    rxFrames = 0;
+    rxLatencySum = 0;
+    rxLatencyWorst = 0;
+    rxWindowStart = now;
+}
+
+QIODevice *Vehicle::openXBee(QString port)
+{
+    QextSerialPort *tempPort = new QextSerialPort(port);
+    tempPort->setBaudRate(BAUD57600);
+    tempPort->setParity(PAR_NONE);
+    tempPort->setDataBits(DATA_8);
+    tempPort->setStopBits(STOP_1);
+    tempPort->setFlowControl(FLOW_OFF);
+    // Unbuffered so that reads go straight into the caller's buffer.
+    if (!tempPort->open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        delete tempPort;
+        return 0;
+    }
+    tempPort->setDtr(false);
+    return tempPort;
+}
+
 bool Vehicle::parseConfigMessage(QByteArray message)
 {
     uint16_t length = qFromBigEndian<uint16_t>(
@@ -490,155 +572,45 @@ bool Vehicle::parseConfigMessage(QByteArray message)
             if (!streamingTelemetry)
                 sendMessage(1, 22, 0); // Send a stop request if we don't want
             else {
-                int32_t itemp;
-                int16_t stemp;
-                uint16_t ustemp;
-                uint8_t btemp;
-                itemp = qFromLittleEndian<int32_t>(data + 5);
-                stemp = itemp & UINT16_C(0x7FF);
-                if (stemp & UINT16_C(0x400))
-                    stemp |= UINT16_C(0xF800);
-                float roll = stemp / 10.0f;
-                stemp = (itemp & UINT32_C(0x3FF800)) >> 11;
-                if ((stemp & UINT16_C(0x400)) != 0)
-                    stemp |= UINT16_C(0xF800);
-                float pitch = stemp / 10.0f;
-                stemp = (itemp & UINT32_C(0xFFC00000)) >> 22;
-                if (stemp & UINT16_C(0x200))
-                    stemp |= UINT16_C(0xFC00);
-                float yaw = stemp;
-                int packetLoss = data[9];
-                int rssi = data[10];
-                uint16_t throttle = qFromLittleEndian<uint16_t>(data + 11);
-                float altPre = qFromLittleEndian<int16_t>(data + 13) / 10.0f;
-                itemp = qFromLittleEndian<int32_t>(data + 15);
-                btemp = data[19];
-                stemp = itemp & UINT16_C(0x1FFF);
-                if (stemp & UINT16_C(0x1000))
-                    stemp |= UINT16_C(0xE000);
-                int16_t magX = stemp;
-                stemp = (itemp & UINT32_C(0x3FFE000)) >> 13;
-                if (stemp & UINT16_C(0x1000))
-                    stemp |= UINT16_C(0xE000);
-                int16_t magY = stemp;
-                stemp = (itemp & UINT32_C(0xFC000000)) >> 26;
-                stemp |= btemp << 6;
-                if (stemp & UINT16_C(0x1000))
-                    stemp |= UINT16_C(0xE000);
-                int16_t magZ = stemp;
-                itemp = qFromLittleEndian<int32_t>(data + 20);
-                stemp = itemp & UINT16_C(0x3FF);
-                if (stemp & UINT16_C(0x200))
-                    stemp |= UINT16_C(0xFC00);
-                float veln = stemp / 10.0f;
-                stemp = (itemp & UINT32_C(0xFFC00)) >> 10;
-                if (stemp & UINT16_C(0x200))
-                    stemp |= UINT16_C(0xFC00);
-                float vele = stemp / 10.0f;
-                stemp = (itemp & UINT32_C(0x3FF00000)) >> 20;
-                if (stemp & UINT16_C(0x200))
-                    stemp |= UINT16_C(0xFC00);
-                float veld = stemp / 10.0f;
-                itemp = qFromLittleEndian<int32_t>(data + 24);
-                stemp = itemp & UINT16_C(0x3FF);
-                if (stemp & UINT16_C(0x200))
-                    stemp |= UINT16_C(0xFC00);
-                float errn = stemp;
-                if ((itemp & 1 << 30) == 0)
-                    errn /= 10;
-                stemp = (itemp & UINT32_C(0xFFC00)) >> 10;
-                if (stemp & UINT16_C(0x200))
-                    stemp |= UINT16_C(0xFC00);
-                float erre = stemp;
-                if ((itemp & 1 << 30) == 0)
-                    erre /= 10;
-                stemp = (itemp & UINT32_C(0x3FF00000)) >> 20;
-                if (stemp & UINT16_C(0x200))
-                    stemp |= UINT16_C(0xFC00);
-                float errd = stemp;
-                if ((itemp & 1 << 31) == 0)
-                    errd /= 10;
-                float battHeli = data[28] / 10.0f;
-                ustemp = qFromLittleEndian<uint16_t>(data + 29);
-                uint32_t timeFlight = ustemp * 40;
-                int svs = (data[31] & 0x1F);
-                int holdMode = (data[31] & UINT8_C(0xE0)) >> 5;
-                float current = data[32] / 10.0f;
-                int picture = data[33];
-                emit telemetry1Changed(roll, pitch, yaw, packetLoss, rssi,
-                                       throttle, altPre, magX, magY, magZ,
-                                       veln, vele, veld, errn, erre, errd,
-                                       battHeli, timeFlight, svs, holdMode,
-                                       picture, current);
+                Telemetry1Frame frame = Telemetry1Frame::decode(data);
+                if (zigbee)
+                    rateController->report(frame.packetLoss, frame.rssi);
+                emit telemetry1Received(frame);
+                // Compatibility path for scalar consumers, only unpacked if
+                // somebody is listening.
+                if (receivers(SIGNAL(telemetry1Changed(float,float,float,int,
+                                     int,uint,float,int,int,int,float,float,
+                                     float,float,float,float,float,uint,int,
+                                     int,int,float))) > 0)
+                    emit telemetry1Changed(frame.roll, frame.pitch, frame.yaw,
+                                           frame.packetLoss, frame.rssi,
+                                           frame.throttle, frame.altPre,
+                                           frame.magX, frame.magY, frame.magZ,
+                                           frame.velN, frame.velE, frame.velD,
+                                           frame.errN, frame.errE, frame.errD,
+                                           frame.battHeli, frame.flightTime,
+                                           frame.svs, frame.holdMode,
+                                           frame.picture, frame.current);
             }
         }
         if (data[4] == 23) { // Bit-packed telemetry 2
             if (!streamingTelemetry)
                 sendMessage(1, 22, 0);
             else {
-                int32_t itemp, itemp2;
-                int16_t stemp;
-                double dtemp;
-                itemp = qFromLittleEndian<int32_t>(data + 5);
-                stemp = itemp & UINT16_C(0x7FF);
-                if (stemp & UINT16_C(0x400))
-                    stemp |= UINT16_C(0xF800);
-                float roll = stemp / 10.0f;
-                stemp = (itemp & UINT32_C(0x3FF800)) >> 11;
-                if ((stemp & UINT16_C(0x400)) != 0)
-                    stemp |= UINT16_C(0xF800);
-                float pitch = stemp / 10.0f;
-                stemp = (itemp & UINT32_C(0xFFC00000)) >> 22;
-                if (stemp & UINT16_C(0x200))
-                    stemp |= UINT16_C(0xFC00);
-                float yaw = stemp;
-                int packetLoss = data[9];
-                int rssi = data[10];
-                uint16_t throttle = qFromLittleEndian<uint16_t>(data + 11);
-                float altPre = qFromLittleEndian<int16_t>(data + 13) / 10.0f;
-                int16_t altGps = qFromLittleEndian<int16_t>(data + 15);
-                itemp = qFromLittleEndian<int32_t>(data + 17);
-                itemp2 = itemp & UINT32_C(0x7FFFFF);
-                stemp = (itemp & UINT32_C(0xFF800000)) >> 23;
-                if (stemp & UINT16_C(0x100))
-                    stemp |= UINT16_C(0xFE00);
-                dtemp = stemp;
-                if (dtemp < 0)
-                    dtemp -= itemp2 / 1000000.0;
-                else
-                    dtemp += itemp2 / 1000000.0;
-                double lat = dtemp;
-                itemp = qFromLittleEndian<int32_t>(data + 21);
-                itemp2 = itemp & 0x007FFFFF;
-                stemp = (short)((itemp & 0xFF800000) >> 23);
-                if ((stemp & 0x100) != 0)
-                    stemp |= (short)0xFE00;
-                dtemp = (double)stemp;
-                if (dtemp < 0)
-                    dtemp -= itemp2 / 1000000.0;
-                else
-                    dtemp += itemp2 / 1000000.0;
-                double lng = dtemp;
-                itemp = qFromLittleEndian<int32_t>(data + 25);
-                stemp = itemp & UINT16_C(0x3FF);
-                float pdop = stemp / 10.0f;
-                stemp = itemp >> 10 & UINT16_C(0x7FF);
-                float hacc = stemp / 10.0f;
-                stemp = (short)((itemp >> 21) & 0x7FF);
-                float vacc = ((float)stemp) / 10;
-                itemp = qFromLittleEndian<int32_t>(data + 29);
-                int32_t timeGps = (itemp & UINT32_C(0xFFFFF)) * 1000;
-                float temperature = -1000000;
-                stemp = itemp >> 20 & UINT16_C(0xFFF);
-                if (stemp & UINT16_C(0x800))
-                    stemp |= UINT16_C(0xF000);
-                if (stemp != UINT16_C(0x7FF))
-                    temperature = stemp * 0.0625f;
-                uint8_t tilt = data[33];
-                emit telemetry2Changed(roll, pitch, yaw, packetLoss, rssi,
-                                       throttle, altPre, altGps, lat, lng,
-                                       pdop, hacc, vacc, timeGps, temperature,
-                                       tilt);
+                Telemetry2Frame frame = Telemetry2Frame::decode(data);
+                if (zigbee)
+                    rateController->report(frame.packetLoss, frame.rssi);
+                emit telemetry2Received(frame);
+                if (receivers(SIGNAL(telemetry2Changed(float,float,float,int,
+                                     int,uint,float,int,double,double,float,
+                                     float,float,int,float,uint))) > 0)
+                    emit telemetry2Changed(frame.roll, frame.pitch, frame.yaw,
+                                           frame.packetLoss, frame.rssi,
+                                           frame.throttle, frame.altPre,
+                                           frame.altGps, frame.lat, frame.lng,
+                                           frame.pdop, frame.hacc, frame.vacc,
+                                           frame.gpsTime, frame.temperature,
+                                           frame.tilt);
             }
         }
     }
@@ -662,96 +634,129 @@ bool Vehicle::parseConfigMessage(QByteArray message)
     return true;
 }
 
-void Vehicle::send(QByteArray data, uint64_t destination)
-{
-    // data must be a valid message, CRC'd and if necessary encrypted.
-    if (zigbee) {
-        // Wrap message in a XBee packet.
-        int length = data.length() + 11;
-        unsigned char bytes[14];
-        bytes[0] = 0x7E;
-        qToBigEndian<uint16_t>(length, bytes + 1);
-        bytes[3] = 0x00; // 64-bit addressed transmit
-        bytes[4] = 0x00; // Frame #, unused
-        qToBigEndian<uint64_t>(destination, bytes + 5);
-        bytes[13] = 0x01; // Options, sp. 'no ack'
-        data.prepend((char *)bytes, 14);
-        data.append(checksum((unsigned char const *)data.constData() + 3,
-                    length));
-    } else {
+void Vehicle::scanBuffer()
+{
+    while (buffer.length() >= (zigbee? 5 : 6)) {
+        unsigned char const *data = buffer.data();
+        if ((zigbee && data[0] == 0x7E) ||
+                (!zigbee && (data[0] == 0xFF || data[0] == 0xFE))) {
+            uint16_t length = qFromBigEndian<uint16_t>(data + (zigbee? 1 : 2));
+            if (zigbee) {
+                if (length == 0 || length > 95) {
+                    // Invalid length
+                    buffer.consume(1);
+                    continue;
+                }
+                if (length + 4 > buffer.length()) {
+                    // Length appears reasonable but exceeds bytes available.
+                    // Leave buffer unmodified and return waiting for remainder
+                    // of packet to arrive.
+                    return;
+                }
+                if (checksum(data + 3, length + 1)) {
+                    // Checksum failed
+                    buffer.consume(1);
+                    continue;
+                }
+                if (data[3] == 0x80 &&
+                    qFromBigEndian<quint64>(data + 4) == remoteMac &&
+                    data[14] == 0xFF &&
+                    !parseConfigMessage(
+                            QByteArray((char const *)(data + 14),
+                                       length - 11))) {
+                    // Was a config message, but parsing failed.
+                    buffer.consume(1);
+                    continue;
+                }
+                // Appears to be a valid message.
+                QByteArray newMessage((char const *)data, length + 4);
+                buffer.consume(length + 4);
+                noteRxFrame();
+                emit message(newMessage, true);
+            } else {
+                // In wired mode the maximum length is effectively the range of
+                // an unsigned 16-bit int. However, 200 is longer than any
+                // actual message in case a bad message has unreasonable length
+                // we don't want to wait for all of it to arrive before
+                // continuing.
+                if (length > 200) {
+                    buffer.consume(1);
+                    continue;
+                }
+                // Length is reasonable but incomplete, wait for the remainder.
+                if (length + 6 > buffer.length()) {
+                    return;
+                }
+                QByteArray newMessage((char const *)data, length + 6);
+                if (parseConfigMessage(newMessage)) { // Valid message
+                    buffer.consume(length + 6);
+                    noteRxFrame();
+                    emit message(newMessage, true);
+                } else { // Parsing failed
+                    buffer.consume(1);
+                }
+            }
+        } else {
+            // Buffer does not start with a valid delimiter.
+            // Skip to the first delimiter found, or clear the buffer if none.
+            int delim = zigbee? buffer.indexOf(0x7E, 1) :
+                                buffer.indexOfAny(0xFF, 0xFE, 1);
+            if (delim > 0)
+                buffer.consume(delim);
+            else
+                buffer.clear();
+        }
+    }
+}
+
+void Vehicle::send(unsigned int length, uint64_t destination,
+                   TxQueue::Class priority)
+{
+    if (!zigbee) {
         // No additional wrapper needed.
+        write(builder.message(), length, priority);
+        return;
     }
-    QMutexLocker locker(&serialMutex);
-    if (serialPort) {
-        serialPort->write(data);
-        locker.unlock();
-        emit message(data, false);
+    // Wrap message in XBee packets, breaking it up if it is longer than the
+    // maximum XBee packet.
+    for (unsigned int offset = 0; offset < length;
+         offset += FrameBuilder::Fragment) {
+        unsigned int part = qMin<unsigned int>(length - offset,
+                                               FrameBuilder::Fragment);
+        write(builder.wrap(offset, part, destination),
+              part + FrameBuilder::Header + 1, priority);
     }
 }
 
 void Vehicle::sendAcquire()
 {
-    unsigned char bytes[11];
+    acquires++;
+    unsigned char *bytes = builder.begin();
     bytes[0] = config? 254 : 0;
     qToLittleEndian(localMac, bytes + 1);
     qToLittleEndian(crc(bytes, 9), bytes + 9);
-    send(QByteArray((char const *)bytes, 11));
+    send(11);
 }
 
-void Vehicle::sendControl()
+void Vehicle::sendControl(int skipped)
 {
     if (state != CONNECTED)
         return;
     if (zigbee && !config) {
-        controlsInterval++;
+        controlsInterval += 1 + skipped;
         controlsInterval = controlsInterval % 5;
-        if (controlsInterval == 4)
+        // Controls are not sent when interval == 4, the message before tells
+        // the vehicle to use the gap to send any message it has queued.
+        unsigned int length = controlPacket.length(controlsInterval);
+        if (!length)
             return;
-        uint chCount = 6 + (controlsInterval % 2);
-        QByteArray message = QByteArray(4 + chCount * 2, 0x1);
-        message[0] = 0x7;
-        message[1] = chCount;
-        // Controls are not sent when interval == 4, indicate to vehicle on
-        // last message before skip that it should use the next few ms to send
-        // any message it has queued.
-        if (controlsInterval == 3)
-            message[1] = message[1] | (1 << 7);
-        // Roll, pitch, throttle, and yaw are sent every time.
-        for (int i = 0; i < 4; i++) {
-            qToBigEndian(controls[i],
-                         (unsigned char *)(message.data() + 2 + 2 * i));
-            // Mask the value and OR with its index.
-            message[2 + 2 * i] = (message[2 + 2 * i] & 0x0F) | (i << 4);
-        }
-        if (controlsInterval % 2 == 0) { // Shutter and ascent for even
-            qToBigEndian(controls[4],
-                         (unsigned char *)(message.data() + 2 + 2 * 4));
-            qToBigEndian(controls[5],
-                         (unsigned char *)(message.data() + 2 + 2 * 5));
-            // Mask values and OR with indices.
-            message[2 + 2 * 4] = (message[2 + 2 * 4] & 0xF) | (4 << 4);
-            message[2 + 2 * 5] = (message[2 + 2 * 5] & 0xF) | (5 << 4);
-        } else { // Zoom, tilt, hold for odd
-            qToBigEndian(controls[6],
-                         (unsigned char *)(message.data() + 2 + 2 * 4));
-            qToBigEndian(controls[7],
-                         (unsigned char *)(message.data() + 2 + 2 * 5));
-            qToBigEndian(controls[8],
-                         (unsigned char *)(message.data() + 2 + 2 * 6));
-            // Mask values and OR with indices.
-            message[2 + 2 * 4] = (message[2 + 2 * 4] & 0xF) | (6 << 4);
-            message[2 + 2 * 5] = (message[2 + 2 * 5] & 0xF) | (7 << 4);
-            message[2 + 2 * 6] = (message[2 + 2 * 6] & 0xF) | (8 << 4);
-        }
-        qToLittleEndian(crc((unsigned char const *)
-                            message.constData(), 2 + chCount * 2),
-                        (unsigned char *)(message.data() + 2 + chCount * 2));
-        send(message, remoteMac);
+        memcpy(builder.begin(), controlPacket.data(controlsInterval), length);
+        send(length, remoteMac, TxQueue::Control);
     } else if (!zigbee && !config && bypassMode) {
         uchar ms[16];
         for (int i = 0; i < 8; i++)
             qToLittleEndian<uint16_t>(motors[i], ms + i * 2);
-        sendMessage(6, 1, 1, QByteArray((char *)ms, 16));
+        sendMessage(6, 1, 1, ms, 16);
     } else if (config) {
         uchar data[33];
         data[0] = 10;
@@ -760,85 +765,97 @@ void Vehicle::sendControl()
             // Mask the value and OR with its index.
             data[2 + 2 * i] = (data[2 + 2 * i] & 0x0F) | (i << 4);
         }
-        sendMessage(5, 0, 1, QByteArray((char *)data, 21));
+        sendMessage(5, 0, 1, data, 21);
     }
 }
 
 void Vehicle::sendEnumRequest()
 {
-    uchar bytes[4];
+    unsigned char *bytes = builder.begin();
     bytes[0] = 0xF8; // Identify request
     bytes[1] = 0x0;  // Omit no vehicles
     qToLittleEndian(crc(bytes, 2), bytes + 2);
-    send(QByteArray((char*)bytes, 4));
+    send(4);
 }
 
 void Vehicle::sendMessage(uint8_t type, uint8_t subType, uint8_t mode,
                           QByteArray const &payload)
 {
-    unsigned char bytes[1024];
+    sendMessage(type, subType, mode,
+                (unsigned char const *)payload.constData(), payload.length());
+}
+
+void Vehicle::sendMessage(uint8_t type, uint8_t subType, uint8_t mode,
+                          unsigned char const *payload, unsigned int count)
+{
     if (state == IDLE)
         return;
-    uint16_t length = payload.length() + 2;
+    uint16_t length = count + 2;
     length = ((length % 8) == 0)? length : ((length >> 3) + 1) << 3;
-    if (length + 6U > sizeof(bytes))
+    if (length + 6U > FrameBuilder::Capacity)
         return;
+    unsigned char *bytes = builder.begin();
     bytes[0] = 0xFF;
     bytes[1] = type;
     qToBigEndian<uint16_t>(length, bytes + 2);
     bytes[4] = subType;
     bytes[5] = mode;
     // Payload
-    for (int i = 0; i < payload.length(); i++)
-        bytes[6 + i] = payload.constData()[i];
+    if (count)
+        memcpy(bytes + 6, payload, count);
     // Padding
-    for (int i = payload.length(); i < length - 2; i++)
-        bytes[6 + i] = 0;
+    memset(bytes + 6 + count, 0, length - 2 - count);
     qToLittleEndian(crc(bytes + 1, length + 3), bytes + length + 4);
     if (type != 6)
         encrypt(bytes, bytes, teaKey, 4, length);
-    int outLen = length + 6;
-    int offset = 0;
-    // If message is longer than maximum XBee packet, break it up.
-    while (zigbee && outLen > 85) {
-        send(QByteArray((char *)(bytes + offset), 85), remoteMac);
-        outLen -= 85;
-        offset += 85;
-    }
-    send(QByteArray((char *)(bytes + offset), outLen), remoteMac);
+    // Bypass-mode traffic, motor speeds included, stays in one class so
+    // that speeds never overtake the command entering bypass-mode.
+    TxQueue::Class priority = TxQueue::Bulk;
+    if (type == 5) // Controls
+        priority = TxQueue::Control;
+    else if (type == 6)
+        priority = TxQueue::Command;
+    send(length + 6, remoteMac, priority);
 }
 
 void Vehicle::sendQuery()
 {
-    QByteArray message = QByteArray(3, 0x0);
+    unsigned char *message = builder.begin();
     message[0] = 1;
-    qToLittleEndian(crc((unsigned char const *)message.constData(), 1),
-                    (unsigned char *)message.data() + 1);
-    send(message, remoteMac);
+    qToLittleEndian(crc(message, 1), message + 1);
+    send(3, remoteMac);
 }
 
 void Vehicle::setChannel(uint8_t channel)
 {
     if (!zigbee)
         return;
-    QByteArray packet(9, '\0');
-    packet[0] = 0x7E;
-    packet[1] = 0x00;
-    packet[2] = 0x05;
-    packet[3] = 0x08; // AT command
-    packet[4] = 0x00; // frame #, unused
-    packet[5] = 'C';  // "CH" = channel
-    packet[6] = 'H';
-    packet[7] = channel;
-    packet[8] = checksum((unsigned char const *)packet.constData() + 3, 5);
-    QMutexLocker locker(&serialMutex);
     if (serialPort) {
         this->channel = channel;
-        serialPort->write(packet);
-        emit message(packet, false);
+        // "CH" = channel, frame # unused.
+        write(builder.atCommand(0x0, "CH", &channel, 1), 9);
     }
 }
 
+bool Vehicle::saveControlLateness(QString fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return controlScheduler->writeHistogram(&file);
+}
+
+bool Vehicle::setControlPriority(int priority)
+{
+    return controlScheduler->setPriority(priority);
+}
+
+void Vehicle::setControlRate(int hz)
+{
+    controlRate = hz;
+    controlScheduler->setRate(rateController->controlRate(hz));
+}
+
 void Vehicle::setControls(uint8_t c0, uint8_t c1, uint8_t c2, uint8_t c3,
                           uint8_t c4, uint8_t c5, uint8_t c6, uint8_t c7)
 {
@@ -853,6 +870,8 @@ void Vehicle::setControls(uint8_t c0, uint8_t c1, uint8_t c2, uint8_t c3,
         controls[txMap[7]] = 1022.0*c7/100.0-511;
         for (int i = 8; i < 16; i++)
             controls[txMap[i]] = 0;
+        for (int i = 0; i < ControlPacket::Channels; i++)
+            controlPacket.setChannel(i, controls[i]);
     } else if (!zigbee && !config) {
         motors[0] = 1023*c0/100;
         motors[1] = 1023*c1/100;
@@ -865,8 +884,22 @@ void Vehicle::setControls(uint8_t c0, uint8_t c1, uint8_t c2, uint8_t c3,
     }
 }
 
+void Vehicle::setReducedControls(bool enable)
+{
+    reducedControls = enable;
+    onLinkLevelChanged();
+}
+
 void Vehicle::streamTelemetry(bool enable)
 {
     streamingTelemetry = enable;
     sendMessage(1, 22, enable? 1 : 0);
 }
+
+void Vehicle::write(unsigned char const *frame, unsigned int length,
+                    TxQueue::Class priority)
+{
+    if (!serialPort)
+        return;
+    txQueue->write(priority, frame, length);
+}
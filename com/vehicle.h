@@ -1,12 +1,20 @@
 #pragma once
 #define __STDC_CONSTANT_MACROS
 #include <stdint.h>
+#include <QElapsedTimer>
 #include <QHostAddress>
-#include <QMutex>
+#include <QList>
 #include <QObject>
+#include "controlpacket.h"
+#include "framebuffer.h"
+#include "framebuilder.h"
+#include "ratecontroller.h"
+#include "telemetry.h"
+#include "txqueue.h"
 
 class QIODevice;
 class QTimer;
+class ControlScheduler;
 
 /// 128-bit key used with TEA to encrypt messages.
 uint32_t const teaKey[4]= {
@@ -23,6 +31,11 @@ const uint8_t txMap[16]= {
 ///
 /// Implements minimal client allowing enumeration, connection, telemetry and
 /// control.
+///
+/// Not thread-safe. A Vehicle may be moved to its own thread so that serial
+/// I/O and control timing are independent of the GUI, in which case it must
+/// only be driven through queued connections or QMetaObject::invokeMethod,
+/// see VehicleRelay for getting its output back.
 class Vehicle : public QObject
 {
     Q_OBJECT
@@ -52,7 +65,8 @@ public:
     /// Draganflyer API messages.
     ///
     /// Note that for encrypted messages the CRC is calculated from the
-    /// unencrypted data.
+    /// unencrypted data.<BR>
+    /// Dispatches to the fastest implementation in Crc16.
     /// @return CRC-16-ANSI.
     /// @param data address of the first byte to include in the CRC.
     /// @param length total number of bytes to include in the CRC.
@@ -60,6 +74,9 @@ public:
                         unsigned int length);
 
     /// Use Tiny Encryption Algorithm to decrypt data.
+    ///
+    /// Runs on a Tea engine, so blocks are processed several at a time and
+    /// the round keys of the API key are only computed once.
     /// @param data pointer to the message to be decrypted.
     /// @param output pointer to buffer where decrypted bytes will be written.
     /// @param key 128-bit encryption key.
@@ -74,6 +91,9 @@ public:
                         unsigned int count);
 
     /// Use Tiny Encryption Algorithm to encrypt data.
+    ///
+    /// Runs on a Tea engine, so blocks are processed several at a time and
+    /// the round keys of the API key are only computed once.
     /// @param data pointer to the message to be encrypted.
     /// @param output pointer to buffer where encrypted bytes will be written.
     /// @param key 128-bit encryption key.
@@ -91,6 +111,20 @@ public:
     /// @return current connection state of this Vehicle.
     VehicleState getState() const { return state; }
 
+    /// Check whether a device can be read until read() returns 0.
+    ///
+    /// True for a serial port with non-waiting, low latency tty settings,
+    /// see QextSerialPort::isNonBlocking(), which is then read with one
+    /// read() per chunk rather than asking bytesAvailable() first. Writes
+    /// to it still block.
+    static bool isNonBlocking(QIODevice *device);
+
+    /// Open a serial port with the settings used by XBee modules, 57600 8N1
+    /// without flow control.
+    /// @return the open port, owned by the caller, or null on failure.
+    /// @param port name of the serial port.
+    static QIODevice *openXBee(QString port);
+
 signals:
     /// Results of parsing the bypass-mode sensor message.
     ///
@@ -103,9 +137,21 @@ signals:
                     int16_t accY,
                     int16_t accZ);
 
+    /// Will be emitted whenever link quality changes the amount of control
+    /// traffic sent, see RateController.
+    /// @param level new RateController::Level.
+    /// @param loss smoothed packet loss reported by the vehicle.
+    /// @param rssi signal strength reported by the vehicle.
+    void linkLevelChanged(int level,
+                          double loss,
+                          int rssi);
+
     /// Will be emitted for every outgoing message and every valid incoming
     /// message.
     ///
+    /// Outgoing messages are composed in place and only copied into a
+    /// QByteArray for this signal while something other than the Vehicle
+    /// itself is connected to it.<BR>
     /// Incoming messages will be subjected to basic validity tests before
     /// emitting this signal.<BR>
     /// Incoming bytes that are not part of a message will not be emitted.<BR>
@@ -120,13 +166,26 @@ signals:
     void message(QByteArray message,
                  bool incoming);
 
+    /// Time from bytes arriving at the serial port to the frames they
+    /// complete being emitted through message().
+    ///
+    /// Arrival is taken as the read notification. Emitted about once a
+    /// second while frames are coming in.
+    /// @param latency mean latency over the last second, in ms.
+    /// @param maxLatency worst latency over the last second, in ms.
+    /// @param frames number of frames received over the last second.
+    void rxLatencyChanged(double latency,
+                          double maxLatency,
+                          quint64 frames);
+
     /// Will be emitted for every Vehicle::state transition.
     /// @param state current connection state of this Vehicle.
     void stateChanged(Vehicle::VehicleState state);
 
     /// Results of parsing the bit-packed telemetry message #22.
     ///
-    /// Emitted at 5Hz while telemetry streaming is active.
+    /// Compatibility signal for consumers of individual values, prefer
+    /// telemetry1Received. Only emitted while something is connected to it.
     void telemetry1Changed(float roll,
                            float pitch,
                            float yaw,
@@ -152,7 +211,8 @@ signals:
 
     /// Results of parsing the bit-packed telemetry message #23.
     ///
-    /// Emitted at 5Hz while telemetry streaming is active.
+    /// Compatibility signal for consumers of individual values, prefer
+    /// telemetry2Received. Only emitted while something is connected to it.
     void telemetry2Changed(float roll,
                            float pitch,
                            float yaw,
@@ -170,6 +230,21 @@ signals:
                            float temperature,
                            unsigned int tilt);
 
+    /// Results of parsing the bit-packed telemetry message #22.
+    ///
+    /// Emitted at 5Hz while telemetry streaming is active.
+    void telemetry1Received(Telemetry1Frame const &frame);
+
+    /// Results of parsing the bit-packed telemetry message #23.
+    ///
+    /// Emitted at 5Hz while telemetry streaming is active.
+    void telemetry2Received(Telemetry2Frame const &frame);
+
+    /// Queue depth and latency per traffic class, see TxQueue.
+    ///
+    /// Emitted once a second while a port is open.
+    void txStatsChanged(TxQueue::Stats const &stats);
+
     /// Will be emitted during enumeration, once for every response received.
     /// @param vehicleMac MAC address of the vehicle discovered.
     /// @param channel ZigBee channel the vehicle is using.
@@ -199,6 +274,23 @@ public slots:
     /// Caller must make sure this port is not already in use.
     void enumerate(QString port);
 
+    /// Send identification requests on a list of channels through a device
+    /// already open which speaks XBee API frames.
+    ///
+    /// Two requests are sent on each of the first known channels, which is
+    /// where vehicles were last seen, and on any channel which answers. The
+    /// other channels get a single request, so a silent channel is left
+    /// after 200 ms rather than 300 ms.<BR>
+    /// Enumeration ends, and the Vehicle returns to IDLE, once the last
+    /// channel has been tried. See VehicleEnumerator for scanning the
+    /// channels with several modules at once.
+    /// @param device open device to use, adopted and deleted on close().
+    /// @param channels ZigBee channels to try in order, 0x0C to 0x17.
+    /// @param known number of leading channels vehicles were last seen on.
+    void enumerate(QIODevice *device,
+                   QList<uint8_t> channels,
+                   int known);
+
     /// Leave bypass-mode.
     void leaveBypass();
 
@@ -220,12 +312,52 @@ public slots:
               uint8_t channel,
               bool config = false);
 
+    /// Establish wireless communication with a vehicle through a device
+    /// already open which speaks XBee API frames.
+    ///
+    /// The device is adopted and deleted on close(), e.g. a FleetPort
+    /// sharing one XBee module between several vehicles.<BR>
+    /// Each step of the handshake is taken as soon as the module or vehicle
+    /// answers the one before, the timer only repeats what was lost. The
+    /// local module's MAC address is remembered per serial port, so that
+    /// reconnecting through the same port sends the acquire straight away.
+    /// @param device open device to use.
+    /// @param vehicleMac MAC address of the target remote vehicle.
+    /// @param channel ZigBee channel to use, 0x0C to 0x17 are valid.
+    /// @param config connect to vehicle in 'config' mode where controls are
+    /// disabled.
+    void open(QIODevice *device,
+              uint64_t vehicleMac,
+              uint8_t channel,
+              bool config = false);
+
     /// Establish communication with a vehicle via an instance of Dragan View.
     /// @param hostAddress Address of host running Dragan View.
     /// @param hostPort UDP port on host to use.
     void open(QHostAddress hostAddress,
               quint16 hostUdp);
 
+    /// Export the control tick lateness histogram.
+    /// @return false if the file could not be written.
+    /// @param fileName CSV file to write, see ControlScheduler::writeHistogram.
+    bool saveControlLateness(QString fileName);
+
+    /// Run the thread this Vehicle lives in with real-time priority.
+    ///
+    /// Only sensible when the Vehicle has a thread of its own.
+    /// @return false if the priority could not be set.
+    /// @param priority SCHED_FIFO priority, or 0 for normal scheduling.
+    bool setControlPriority(int priority);
+
+    /// Set the rate at which controls are sent, 50 Hz by default.
+    ///
+    /// One tick in five is always left free for the vehicle to transmit on.
+    /// <BR>
+    /// On a poor XBee link the rate actually used may be lower, see
+    /// RateController.
+    /// @param hz control ticks per second.
+    void setControlRate(int hz);
+
     /// Set commanded control values.
     ///
     /// In zigbee and wired+non-bypass modes these are taken to be roll, pitch,
@@ -241,6 +373,15 @@ public slots:
                      uint8_t c6,
                      uint8_t c7);
 
+    /// Allow the four channel control layout on a poor XBee link, off by
+    /// default.
+    ///
+    /// The vehicle firmware has not yet been checked to accept that layout,
+    /// so until then every tick carries the auxiliary channels as before and
+    /// RateController::Reduced leaves controls unchanged.
+    /// @param enable true to use the reduced cycle of ControlPacket.
+    void setReducedControls(bool enable);
+
     /// Enable or disable the bit-packed telemetry stream.
     ///
     /// @param enable if true telemetry stream will be enabled.
@@ -248,12 +389,17 @@ public slots:
     void streamTelemetry(bool enable = true);
 
 protected:
+    /// Acquires sent since the connection was opened.
+    ///
+    /// Queries wait for several, see onTimer().
+    unsigned int acquires;
+
     /// Where a message spans multiple read requests this holds the incomplete
     /// remainder.
-    QByteArray buffer;
+    FrameBuffer buffer;
 
-    /// Must be held for all accesses of buffer.
-    QMutex bufferMutex;
+    /// Every outgoing frame is composed in here.
+    FrameBuilder builder;
 
     /// Current bypass-mode state.
     bool bypassMode;
@@ -274,6 +420,12 @@ protected:
     /// Used to decide when to give up on connecting to a vehicle.
     unsigned int connAttempt;
 
+    /// Zigbee control messages, patched as the commanded values change.
+    ControlPacket controlPacket;
+
+    /// Control rate on a clean link, as set by setControlRate().
+    int controlRate;
+
     /// Commanded control channel values.
     int16_t controls[16];
 
@@ -282,14 +434,23 @@ protected:
     /// Constrained to [0 -> 4] and incremented on every control tick.
     unsigned int controlsInterval;
 
-    /// This timer is used to pulse controls and coordinate the skip interval.
-    QTimer *controlsTimer;
+    /// Paces control output and coordinates the skip interval.
+    ControlScheduler *controlScheduler;
+
+    /// True if a vehicle answered on the channel being enumerated.
+    bool enumAnswered;
 
     /// Enumeration attempt counter.
     ///
     /// Used to decide when to move on to another channel.
     unsigned int enumAttempt;
 
+    /// Channels still to try while enumerating, in order.
+    QList<uint8_t> enumChannels;
+
+    /// Number of known channels, including the current one, left to try.
+    int enumKnown;
+
     /// True if we've received the lower 4 bytes of the local XBee module MAC.
     ///
     /// To ensure a complete local MAC is obtained the low bytes are requested
@@ -299,15 +460,14 @@ protected:
 
     /// Counter incremented per invokation of Vehicle::timer.
     ///
-    /// Used to alternate between sending acquire and query messages during
-    /// connection, and to request telemetry messages at 1Hz from inside the
-    /// 10Hz timer.
+    /// Used to request telemetry messages at 1Hz from inside the 10Hz timer.
     int iter;
 
     /// In zigbee mode this is the MAC address of the local device.
     ///
     /// Used only in the acquire message to tell the vehicle which device is
-    /// requesting connection.
+    /// requesting connection. Taken from the cache of the serial port if it
+    /// is known, and confirmed by asking the module in any case.
     uint64_t localMac;
 
     /// Temporary storing the lower 4 bytes of the local MAC address.
@@ -318,11 +478,33 @@ protected:
     /// Commanded motor speeds
     uint16_t motors[8];
 
+    /// Adapts control traffic to the packet loss reported in telemetry.
+    RateController *rateController;
+
+    /// Use the reduced control cycle on a poor link, see
+    /// setReducedControls().
+    bool reducedControls;
+
     /// In zigbee mode this is the MAC address of the vehicle connected to.
     uint64_t remoteMac;
 
-    /// Mutex protecting access to Vehicle::serialPort.
-    QMutex serialMutex;
+    /// When the bytes being scanned arrived, in ns since rxClock start.
+    qint64 rxArrival;
+
+    /// Clock for receive latency.
+    QElapsedTimer rxClock;
+
+    /// Frames received in the current latency window.
+    quint64 rxFrames;
+
+    /// Sum of receive latencies in the current window, in ns.
+    qint64 rxLatencySum;
+
+    /// Worst receive latency in the current window, in ns.
+    qint64 rxLatencyWorst;
+
+    /// Start of the current latency window, in ns since rxClock start.
+    qint64 rxWindowStart;
 
     /// VCP device used to send/receive message to/from a vehicle.
     ///
@@ -353,6 +535,9 @@ protected:
     /// This timer is used to drive the enumeration and connection procedures.
     QTimer *timer;
 
+    /// Orders and paces everything written to serialPort.
+    TxQueue *txQueue;
+
     /// Enable wireless communication through a XBee module.
     ///
     /// If true, enumeration is possible, a connection procedure is used to
@@ -367,6 +552,11 @@ protected slots:
     /// requested.
     void getLocalMac(bool highBytes);
 
+    /// Invoked by the txQueue as a frame goes out, reports it through
+    /// message().
+    void onFrameWritten(unsigned char const *frame,
+                        unsigned int length);
+
     /// Handle a few connection and enum related messages which are not config
     /// messages.
     /// @param message message to parse
@@ -374,6 +564,10 @@ protected slots:
     void onMessage(QByteArray message,
                    bool incoming);
 
+    /// Invoked by the rateController, applies the new level to the control
+    /// packet layouts and the control rate.
+    void onLinkLevelChanged();
+
     /// Invoked by the serialPort when data has been received.
     void onReadyRead();
 
@@ -390,15 +584,11 @@ protected slots:
     /// Interpret config messages, decrypt, CRC, act.
     bool parseConfigMessage(QByteArray message);
 
-    /// Wrap message in a ZigBee packet (if applicable) and write it to the
-    /// serial port.
+    /// Extract and emit every complete message at the front of buffer.
     ///
-    /// If zigbee == false message is written verbatim to serial port.<BR>
-    /// destination defaults to the broadcast address.
-    /// @param data data to be sent.
-    /// @param destination MAC address of recipient (if applicable).
-    void send(QByteArray data,
-              uint64_t destination = 0xFFFFULL);
+    /// Bytes which cannot start a valid message are skipped, an incomplete
+    /// message is left in the buffer until the remainder arrives.
+    void scanBuffer();
 
     /// Construct an acquire message and send it to the broadcast address on
     /// the current channel.
@@ -406,9 +596,11 @@ protected slots:
     /// This message is only meaningful when Vehicle::zigbee == true.
     void sendAcquire();
 
-    /// Invoked by the controlTimer and sends either control channels or motor
-    /// speeds as appropriate.
-    void sendControl();
+    /// Invoked by the controlScheduler and sends either control channels or
+    /// motor speeds as appropriate.
+    /// @param skipped number of control ticks missed since the last one, these
+    /// still advance the skip interval so it stays in step with the vehicle.
+    void sendControl(int skipped = 0);
 
     /// Send an identify request to broadcast on the current channel.
     void sendEnumRequest();
@@ -446,4 +638,46 @@ protected slots:
     /// In zigbee mode send a channel set message to the zigbee module.
     /// @param channel ZigBee channel to set the XBee module to.
     void setChannel(uint8_t channel);
+
+protected:
+    /// Account the receive latency of a frame about to be emitted, and close
+    /// the latency window once a second.
+    void noteRxFrame();
+
+    /// Wrap the message composed in builder in ZigBee packets (if applicable)
+    /// and write it to the serial port.
+    ///
+    /// If zigbee == false the message is written verbatim to serial port.<BR>
+    /// Messages longer than one XBee packet are split over several, each
+    /// queued separately so that controls can go in between.<BR>
+    /// destination defaults to the broadcast address.
+    /// @param length length of the message, which must be valid, CRC'd and if
+    /// necessary encrypted.
+    /// @param destination MAC address of recipient (if applicable).
+    /// @param priority traffic class of the message.
+    void send(unsigned int length,
+              uint64_t destination = 0xFFFFULL,
+              TxQueue::Class priority = TxQueue::Command);
+
+    /// Send any 0xFF / 'config' type message.
+    ///
+    /// As the slot of the same name, for payloads not held in a QByteArray.
+    /// Motor speeds and config-mode controls are queued as controls, other
+    /// bypass-mode messages as commands and everything else as bulk.
+    /// @param payload payload bytes, may be null if length is 0.
+    /// @param length number of payload bytes.
+    void sendMessage(uint8_t type,
+                     uint8_t subtype,
+                     uint8_t mode,
+                     unsigned char const *payload,
+                     unsigned int length);
+
+    /// Queue one complete frame for the serial port, it is reported through
+    /// message() once it is written.
+    /// @param frame first byte of the frame.
+    /// @param length length of the frame.
+    /// @param priority traffic class of the frame.
+    void write(unsigned char const *frame,
+               unsigned int length,
+               TxQueue::Class priority = TxQueue::Command);
 };
@@ -0,0 +1,107 @@
+#include "vehicleenumerator.h"
+#include <QIODevice>
+#include "com/serial/qextserialenumerator.h"
+
+VehicleEnumerator::VehicleEnumerator(QObject *parent) :
+    QObject(parent), cache(), found(), scanners(), wanted()
+{
+}
+
+void VehicleEnumerator::discard(Vehicle *scanner)
+{
+    scanner->disconnect(this);
+    scanner->close();
+    scanner->deleteLater();
+}
+
+void VehicleEnumerator::onStateChanged(Vehicle::VehicleState state)
+{
+    Vehicle *scanner = qobject_cast<Vehicle *>(sender());
+    if (state != Vehicle::IDLE || !scanners.contains(scanner))
+        return;
+    scanners.removeAll(scanner);
+    scanner->disconnect(this);
+    scanner->deleteLater();
+    if (scanners.isEmpty())
+        emit finished();
+}
+
+void VehicleEnumerator::onVehicleFound(uint64_t vehicleMac, uint8_t channel)
+{
+    if (found.contains(vehicleMac))
+        return;
+    found.insert(vehicleMac);
+    cache.record(vehicleMac, channel);
+    emit vehicleFound(vehicleMac, channel);
+    if (!wanted.isEmpty() && found.contains(wanted))
+        stop();
+}
+
+int VehicleEnumerator::start(QStringList ports, QList<quint64> wanted)
+{
+    stop();
+    found.clear();
+    this->wanted = wanted.toSet();
+    if (ports.isEmpty())
+        ports = xbeePorts();
+    // Open every port first so the channels are only shared between those
+    // which can actually be used.
+    QList<QIODevice *> devices;
+    foreach (QString port, ports) {
+        QIODevice *device = Vehicle::openXBee(port);
+        if (device)
+            devices.append(device);
+    }
+    // Deal the channels out in turn so every port starts on a channel
+    // where vehicles were last seen, if there are enough of them.
+    int known;
+    QList<uint8_t> channels = cache.order(wanted, &known);
+    int shards = qMin(devices.length(), channels.length());
+    for (int i = 0; i < devices.length(); i++) {
+        if (i >= shards) {
+            delete devices[i];
+            continue;
+        }
+        QList<uint8_t> shard;
+        int shardKnown = 0;
+        for (int j = i; j < channels.length(); j += shards) {
+            shard.append(channels[j]);
+            if (j < known)
+                shardKnown++;
+        }
+        Vehicle *scanner = new Vehicle(this);
+        connect(scanner, SIGNAL(stateChanged(Vehicle::VehicleState)),
+                this, SLOT(onStateChanged(Vehicle::VehicleState)));
+        connect(scanner, SIGNAL(vehicleFound(uint64_t,uint8_t)),
+                this, SLOT(onVehicleFound(uint64_t,uint8_t)));
+        scanners.append(scanner);
+        scanner->enumerate(devices[i], shard, shardKnown);
+    }
+    return scanners.length();
+}
+
+void VehicleEnumerator::stop()
+{
+    if (scanners.isEmpty())
+        return;
+    foreach (Vehicle *scanner, scanners)
+        discard(scanner);
+    scanners.clear();
+    emit finished();
+}
+
+QStringList VehicleEnumerator::xbeePorts()
+{
+    QStringList ports;
+    foreach (QextPortInfo info, QextSerialEnumerator::getPorts()) {
+        if (!(info.physName + info.friendName).contains(
+                    "USB", Qt::CaseInsensitive))
+            continue;
+#ifdef Q_OS_WIN
+        ports.append(info.portName);
+#else
+        ports.append(info.physName);
+#endif
+    }
+    return ports;
+}
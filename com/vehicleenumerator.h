@@ -0,0 +1,95 @@
+#pragma once
+#include <stdint.h>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include "channelcache.h"
+#include "vehicle.h"
+
+/// Enumerates vehicles with every XBee module available at once.
+///
+/// The channels are dealt out to the ports in turn, and a Vehicle per port
+/// scans its share concurrently.<BR>
+/// The channel each vehicle was found on is kept in a ChannelCache, and
+/// channels where vehicles were last seen are scanned first, with the
+/// usual two requests each. Other channels get a single request unless they
+/// answer. A scan for particular vehicles stops as soon as all of them have
+/// answered, which for a known vehicle that has not changed channel takes
+/// one channel change and one request, about 200 ms.<BR>
+/// Results from all ports are merged and each vehicle is reported once,
+/// whichever channel and port it answered on first.
+class VehicleEnumerator : public QObject
+{
+    Q_OBJECT
+public:
+    /// Constructor.
+    explicit VehicleEnumerator(QObject *parent = 0);
+
+    /// Get the channels vehicles were last found on, shared with whoever
+    /// connects to them.
+    ChannelCache &channelCache() { return cache; }
+
+    /// Check whether a scan is in progress.
+    /// @return true between start() and finished().
+    bool isActive() const { return !scanners.isEmpty(); }
+
+    /// Find the serial ports which look like XBee modules.
+    ///
+    /// USB serial adapters as listed by QextSerialEnumerator::getPorts(), as
+    /// XBee modules are connected through one.
+    /// @return port names suitable for Vehicle::enumerate().
+    static QStringList xbeePorts();
+
+signals:
+    /// Emitted once the last port has finished its shard, or stop() was
+    /// called.
+    void finished();
+
+    /// Emitted once per vehicle discovered.
+    /// @param vehicleMac MAC address of the vehicle discovered.
+    /// @param channel ZigBee channel the vehicle is using.
+    void vehicleFound(uint64_t vehicleMac,
+                      uint8_t channel);
+
+public slots:
+    /// Start a scan, abandoning any scan in progress.
+    ///
+    /// Every port is opened first, ports which cannot be opened are left out
+    /// and the channels shared between the rest.
+    /// @return number of ports scanning, 0 if none could be opened, in which
+    /// case finished() is not emitted.
+    /// @param ports names of the ports to use, xbeePorts() if empty. Caller
+    /// must make sure these are not already in use.
+    /// @param wanted MAC addresses of the vehicles being looked for. If not
+    /// empty the scan stops once all of them have been found.
+    int start(QStringList ports = QStringList(),
+              QList<quint64> wanted = QList<quint64>());
+
+    /// Abandon the scan in progress.
+    void stop();
+
+protected:
+    /// Stop and delete one scanning Vehicle without reporting its end.
+    void discard(Vehicle *scanner);
+
+    /// Channels vehicles were last found on.
+    ChannelCache cache;
+
+    /// MAC addresses reported during this scan.
+    QSet<quint64> found;
+
+    /// One Vehicle per port scanning.
+    QList<Vehicle *> scanners;
+
+    /// MAC addresses which end the scan once all are found, may be empty.
+    QSet<quint64> wanted;
+
+protected slots:
+    /// Invoked by a scanning Vehicle on state change, IDLE ends its shard.
+    void onStateChanged(Vehicle::VehicleState state);
+
+    /// Invoked by a scanning Vehicle for every response.
+    void onVehicleFound(uint64_t vehicleMac,
+                        uint8_t channel);
+};
@@ -0,0 +1,348 @@
+#include "vehiclefleet.h"
+#include <string.h>
+#include <QTimer>
+#include <QtEndian>
+#include "com/vehicle.h"
+
+namespace {
+/// Mean length of a control frame as written to the radio: the five tick
+/// cycle sends two six channel and two seven channel messages, each wrapped
+/// in 15 bytes of XBee framing.
+double const controlFrameBytes = (2 * (16 + 15) + 2 * (18 + 15)) / 4.0;
+
+/// Share of the budget control messages may take, the remainder is kept for
+/// connection, telemetry requests and config traffic.
+double const controlShare = 0.75;
+
+/// Most bytes which may be written back to back after the link was idle.
+double const maxCredit = 2 * (FrameBuilder::Header + FrameBuilder::Fragment
+                              + 1);
+}
+
+FleetPort::FleetPort(VehicleFleet *fleet, uint64_t vehicleMac) :
+    QIODevice(fleet), fleet(fleet), inbox(), vehicleMac(vehicleMac)
+{
+    open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+qint64 FleetPort::bytesAvailable() const
+{
+    return inbox.length() + QIODevice::bytesAvailable();
+}
+
+void FleetPort::deliver(unsigned char const *frame, int length)
+{
+    inbox.append((char const *)frame, length);
+    emit readyRead();
+}
+
+qint64 FleetPort::readData(char *data, qint64 maxlen)
+{
+    int count = qMin<qint64>(maxlen, inbox.length());
+    memcpy(data, inbox.data(), count);
+    inbox.consume(count);
+    return count;
+}
+
+qint64 FleetPort::writeData(const char *data, qint64 len)
+{
+    // The Vehicle writes exactly one frame per call.
+    if (fleet)
+        fleet->enqueue(this, data, len);
+    return len;
+}
+
+VehicleFleet::VehicleFleet(QObject *parent) :
+    QObject(parent), buffer(), bytesPerSecond(LinkRate * 4 / 5), channel(0),
+    clock(), credit(0), lastPace(0), members(), next(0),
+    paceTimer(new QTimer(this)), serialPort(0), statsTimer(new QTimer(this)),
+    windowStart(0)
+{
+    clock.start();
+    connect(paceTimer, SIGNAL(timeout()), this, SLOT(pace()));
+    connect(statsTimer, SIGNAL(timeout()), this, SLOT(updateStats()));
+}
+
+VehicleFleet::~VehicleFleet()
+{
+    close();
+    // Vehicles are deleted with the fleet, make sure nothing they write on
+    // the way out reaches it.
+    for (int i = 0; i < members.length(); i++)
+        if (members[i].port)
+            members[i].port->fleet = 0;
+}
+
+Vehicle *VehicleFleet::add(uint64_t mac, bool config)
+{
+    if (!serialPort)
+        return 0;
+    int index = 0;
+    while (index < members.length() && members[index].stats.mac != mac)
+        index++;
+    if (index < members.length() &&
+            members[index].vehicle->getState() != Vehicle::IDLE)
+        return members[index].vehicle;
+    if (index == members.length()) {
+        Member member;
+        member.controlLength = 0;
+        member.controlQueued = 0;
+        member.controlsSent = 0;
+        member.latencySum = 0;
+        member.latencyWorst = 0;
+        member.port = 0;
+        memset(&member.stats, 0, sizeof(member.stats));
+        member.stats.mac = mac;
+        member.superseded = 0;
+        member.vehicle = new Vehicle(this);
+        members.append(member);
+        rebalance();
+    }
+    Member &member = members[index];
+    member.port = new FleetPort(this, mac);
+    connect(member.port, SIGNAL(destroyed(QObject*)),
+            this, SLOT(onPortDestroyed(QObject*)));
+    member.vehicle->open(member.port, mac, channel, config);
+    return member.vehicle;
+}
+
+void VehicleFleet::close()
+{
+    for (int i = 0; i < members.length(); i++)
+        members[i].vehicle->close();
+    paceTimer->stop();
+    statsTimer->stop();
+    if (serialPort)
+        serialPort->deleteLater();
+    serialPort = 0;
+    buffer.clear();
+}
+
+void VehicleFleet::enqueue(FleetPort *port, char const *data, int length)
+{
+    int index = indexOf(port);
+    if (index < 0 || length <= 0)
+        return;
+    Member &member = members[index];
+    unsigned char const *frame = (unsigned char const *)data;
+    // Control messages are XBee transmit frames carrying a type 0x07
+    // message, only the newest one matters.
+    if (length > 14 && length <= (int)sizeof(member.control) &&
+            frame[3] == 0x00 && frame[14] == 0x07) {
+        if (member.controlLength)
+            member.superseded++;
+        member.controlQueued = clock.nsecsElapsed();
+        memcpy(member.control, frame, length);
+        member.controlLength = length;
+    } else {
+        member.pending.append(QByteArray(data, length));
+    }
+    pace();
+}
+
+int VehicleFleet::indexOf(FleetPort const *port) const
+{
+    for (int i = 0; i < members.length(); i++)
+        if (members[i].port == port)
+            return i;
+    return -1;
+}
+
+void VehicleFleet::onPortDestroyed(QObject *port)
+{
+    for (int i = 0; i < members.length(); i++) {
+        if (members[i].port == port) {
+            members[i].controlLength = 0;
+            members[i].pending.clear();
+            members[i].port = 0;
+        }
+    }
+}
+
+void VehicleFleet::onReadyRead()
+{
+    if (serialPort == 0)
+        return;
+    char chunk[1024];
+    bool drain = Vehicle::isNonBlocking(serialPort);
+    qint64 available = drain? (qint64)sizeof(chunk) :
+                              serialPort->bytesAvailable();
+    while (available > 0) {
+        qint64 count = serialPort->read(
+                    chunk, qMin<qint64>(available, sizeof(chunk)));
+        if (count <= 0)
+            break;
+        if (!drain)
+            available -= count;
+        buffer.append(chunk, count);
+        scanBuffer();
+        if (serialPort == 0)
+            return;
+    }
+}
+
+bool VehicleFleet::open(QString port, uint8_t channel)
+{
+    if (serialPort)
+        return false;
+    serialPort = Vehicle::openXBee(port);
+    if (!serialPort)
+        return false;
+    connect(serialPort, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    this->channel = channel;
+    credit = 0;
+    lastPace = clock.nsecsElapsed();
+    windowStart = lastPace;
+    paceTimer->start(2);
+    statsTimer->start(1000);
+    return true;
+}
+
+void VehicleFleet::pace()
+{
+    if (!serialPort)
+        return;
+    qint64 now = clock.nsecsElapsed();
+    credit = qMin(maxCredit,
+                  credit + (now - lastPace) * 1e-9 * bytesPerSecond);
+    lastPace = now;
+    // Offer the link to each member in turn, one frame at a time, control
+    // messages first. A member which cannot be afforded yet keeps its turn.
+    int idle = 0;
+    while (!members.isEmpty() && idle < members.length()) {
+        next %= members.length();
+        Member &member = members[next];
+        if (member.controlLength) {
+            if (credit < member.controlLength)
+                return;
+            serialPort->write((char const *)member.control,
+                              member.controlLength);
+            credit -= member.controlLength;
+            member.controlLength = 0;
+            member.controlsSent++;
+            qint64 latency = clock.nsecsElapsed() - member.controlQueued;
+            member.latencySum += latency;
+            member.latencyWorst = qMax(member.latencyWorst, latency);
+            idle = 0;
+        } else if (!member.pending.isEmpty()) {
+            if (credit < member.pending.first().length())
+                return;
+            credit -= member.pending.first().length();
+            serialPort->write(member.pending.takeFirst());
+            idle = 0;
+        } else {
+            idle++;
+        }
+        next++;
+    }
+}
+
+void VehicleFleet::rebalance()
+{
+    if (members.isEmpty())
+        return;
+    // Four of every five ticks carry a control message.
+    int rate = bytesPerSecond * controlShare /
+            (members.length() * controlFrameBytes * 4 / 5);
+    rate = qBound(1, rate, 50);
+    for (int i = 0; i < members.length(); i++)
+        members[i].vehicle->setControlRate(rate);
+}
+
+void VehicleFleet::remove(uint64_t mac)
+{
+    for (int i = 0; i < members.length(); i++) {
+        if (members[i].stats.mac == mac) {
+            Member member = members.takeAt(i);
+            if (member.port)
+                member.port->fleet = 0;
+            member.vehicle->close();
+            member.vehicle->deleteLater();
+            rebalance();
+            return;
+        }
+    }
+}
+
+void VehicleFleet::scanBuffer()
+{
+    while (buffer.length() >= 5) {
+        unsigned char const *data = buffer.data();
+        if (data[0] != 0x7E) {
+            int delim = buffer.indexOf(0x7E, 1);
+            if (delim > 0)
+                buffer.consume(delim);
+            else
+                buffer.clear();
+            continue;
+        }
+        uint16_t length = qFromBigEndian<uint16_t>(data + 1);
+        if (length == 0 || length > 95) {
+            buffer.consume(1);
+            continue;
+        }
+        if (length + 4 > buffer.length())
+            return;
+        if (Vehicle::checksum(data + 3, length + 1)) {
+            buffer.consume(1);
+            continue;
+        }
+        if (data[3] == 0x80 && length >= 11) {
+            // 64-bit addressed receive, only for the vehicle it came from.
+            uint64_t source = qFromBigEndian<quint64>(data + 4);
+            for (int i = 0; i < members.length(); i++)
+                if (members[i].stats.mac == source && members[i].port)
+                    members[i].port->deliver(data, length + 4);
+        } else {
+            // Radio status and AT command responses concern everyone.
+            for (int i = 0; i < members.length(); i++)
+                if (members[i].port)
+                    members[i].port->deliver(data, length + 4);
+        }
+        buffer.consume(length + 4);
+    }
+}
+
+void VehicleFleet::setBudget(int bytesPerSecond)
+{
+    this->bytesPerSecond = qBound(1, bytesPerSecond, (int)LinkRate);
+    rebalance();
+}
+
+QList<VehicleFleet::Stats> VehicleFleet::stats() const
+{
+    QList<Stats> result;
+    for (int i = 0; i < members.length(); i++)
+        result.append(members[i].stats);
+    return result;
+}
+
+void VehicleFleet::updateStats()
+{
+    qint64 now = clock.nsecsElapsed();
+    double seconds = (now - windowStart) * 1e-9;
+    windowStart = now;
+    if (seconds <= 0)
+        return;
+    for (int i = 0; i < members.length(); i++) {
+        Member &member = members[i];
+        member.stats.controlRate = member.controlsSent / seconds;
+        member.stats.latency = member.controlsSent?
+                    member.latencySum * 1e-6 / member.controlsSent : 0;
+        member.stats.maxLatency = member.latencyWorst * 1e-6;
+        member.stats.superseded = member.superseded;
+        member.controlsSent = 0;
+        member.latencySum = 0;
+        member.latencyWorst = 0;
+        member.superseded = 0;
+    }
+    emit statsChanged();
+}
+
+Vehicle *VehicleFleet::vehicle(uint64_t mac) const
+{
+    for (int i = 0; i < members.length(); i++)
+        if (members[i].stats.mac == mac)
+            return members[i].vehicle;
+    return 0;
+}
@@ -0,0 +1,262 @@
+#pragma once
+#include <stdint.h>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QList>
+#include <QObject>
+#include "framebuffer.h"
+#include "framebuilder.h"
+
+class QTimer;
+class Vehicle;
+class VehicleFleet;
+
+/// Virtual serial port connecting one Vehicle of a VehicleFleet to the
+/// fleet's shared XBee radio.
+///
+/// Frames the Vehicle writes are handed to the fleet to be scheduled, frames
+/// the fleet routes to this Vehicle are read back as if they came straight
+/// from the radio.
+class FleetPort : public QIODevice
+{
+    Q_OBJECT
+public:
+    /// Constructor.
+    /// @param fleet fleet owning the radio.
+    /// @param vehicleMac MAC address of the vehicle served.
+    FleetPort(VehicleFleet *fleet,
+              uint64_t vehicleMac);
+
+    /// Get number of bytes ready to be read.
+    /// @return bytes routed to this port and not yet read.
+    qint64 bytesAvailable() const;
+
+    /// Hand a frame from the radio to the Vehicle.
+    /// @param frame complete XBee API frame.
+    /// @param length length of the frame.
+    void deliver(unsigned char const *frame,
+                 int length);
+
+    /// This QIODevice is sequential.
+    /// @return true
+    bool isSequential() const { return true; }
+
+    /// Get MAC address of the vehicle served.
+    /// @return 64-bit MAC.
+    uint64_t mac() const { return vehicleMac; }
+
+protected:
+    /// Read frames routed to this port.
+    qint64 readData(char *data,
+                    qint64 maxlen);
+
+    /// Pass one frame written by the Vehicle to the fleet.
+    qint64 writeData(const char *data,
+                     qint64 len);
+
+    /// Fleet owning the radio, null once it has gone.
+    VehicleFleet *fleet;
+
+    /// Frames routed to this port and not yet read.
+    FrameBuffer inbox;
+
+    /// MAC address of the vehicle served.
+    uint64_t vehicleMac;
+
+    friend class VehicleFleet;
+};
+
+/// Several vehicles controlled over a single XBee radio.
+///
+/// The fleet owns the serial port and a Vehicle per aircraft, each Vehicle
+/// talking to the radio through its own FleetPort. Incoming 64-bit receive
+/// frames are routed by source MAC, everything else the radio says (AT
+/// command responses, modem status) goes to every Vehicle.<BR>
+/// Outgoing frames are paced so that the serial link to the radio is never
+/// asked for more than its airtime budget. Control messages are never
+/// queued behind each other: a newer one replaces one still waiting, so a
+/// saturated link lowers the control rate rather than adding latency. Each
+/// Vehicle's control rate is also lowered up front so that the fleet's
+/// control traffic fits the budget.
+class VehicleFleet : public QObject
+{
+    Q_OBJECT
+public:
+    /// Control link figures for one vehicle, over the last second.
+    struct Stats
+    {
+        double controlRate;  ///< Control messages written per second.
+        double latency;      ///< Mean ms from Vehicle to radio.
+        quint64 mac;         ///< MAC address of the vehicle.
+        double maxLatency;   ///< Worst ms from Vehicle to radio.
+        quint64 superseded;  ///< Control messages replaced while waiting.
+    };
+
+    /// Serial bytes per second the radio link carries at 57600 baud 8N1.
+    enum { LinkRate = 57600 / 10 };
+
+    /// Constructor.
+    explicit VehicleFleet(QObject *parent = 0);
+
+    /// Destructor.
+    ~VehicleFleet();
+
+    /// Get the outgoing airtime budget.
+    /// @return bytes per second.
+    int budget() const { return bytesPerSecond; }
+
+    /// Get control link figures for every vehicle, updated once a second.
+    /// @return one entry per vehicle, in the order they were added.
+    QList<Stats> stats() const;
+
+    /// Get the Vehicle controlling an aircraft.
+    /// @return the Vehicle, or null if mac is not part of the fleet.
+    /// @param mac MAC address of the aircraft.
+    Vehicle *vehicle(uint64_t mac) const;
+
+signals:
+    /// Emitted once a second while the radio is open, see stats().
+    void statsChanged();
+
+public slots:
+    /// Add an aircraft to the fleet and start connecting to it.
+    ///
+    /// The radio must already be open. Adding an aircraft already in the
+    /// fleet reconnects its Vehicle if that has given up.
+    /// @return the Vehicle controlling it, owned by the fleet, or null if
+    /// the radio is not open.
+    /// @param mac MAC address of the aircraft.
+    /// @param config connect in 'config' mode where controls are disabled.
+    Vehicle *add(uint64_t mac,
+                 bool config = false);
+
+    /// Disconnect every vehicle and close the radio.
+    void close();
+
+    /// Open the shared radio.
+    /// @return false if the port could not be opened.
+    /// @param port name of the serial port the XBee module is on.
+    /// @param channel ZigBee channel all vehicles use, 0x0C to 0x17.
+    bool open(QString port,
+              uint8_t channel);
+
+    /// Disconnect an aircraft and remove it from the fleet.
+    /// @param mac MAC address of the aircraft.
+    void remove(uint64_t mac);
+
+    /// Set the outgoing airtime budget.
+    ///
+    /// Defaults to 80% of LinkRate, leaving headroom for the radio's own
+    /// framing and for other traffic sharing the link.
+    /// @param bytesPerSecond serial bytes per second.
+    void setBudget(int bytesPerSecond);
+
+protected:
+    /// A vehicle of the fleet and its outgoing traffic.
+    struct Member
+    {
+        /// Latest control message not yet written, valid if controlLength.
+        unsigned char control[FrameBuilder::Header + FrameBuilder::Fragment
+                              + 1];
+
+        /// Length of the waiting control message, 0 if none.
+        int controlLength;
+
+        /// When the waiting control message was written by the Vehicle.
+        qint64 controlQueued;
+
+        /// Control messages written in the current stats window.
+        quint64 controlsSent;
+
+        /// Sum of control latencies in the current stats window, in ns.
+        qint64 latencySum;
+
+        /// Worst control latency in the current stats window, in ns.
+        qint64 latencyWorst;
+
+        /// Other frames waiting to be written, oldest first.
+        QList<QByteArray> pending;
+
+        /// Port the Vehicle talks through, null once the Vehicle closed it.
+        FleetPort *port;
+
+        /// Figures from the last complete stats window.
+        Stats stats;
+
+        /// Control messages replaced in the current stats window.
+        quint64 superseded;
+
+        /// Vehicle controlling the aircraft.
+        Vehicle *vehicle;
+    };
+
+    /// Queue a frame written by a Vehicle.
+    /// @param port port it was written to.
+    /// @param data the frame.
+    /// @param length length of the frame.
+    void enqueue(FleetPort *port,
+                 char const *data,
+                 int length);
+
+    /// Find the member a port belongs to.
+    /// @return index in members, or -1.
+    int indexOf(FleetPort const *port) const;
+
+    /// Spread the control budget over the members.
+    void rebalance();
+
+    /// Route every complete frame at the front of buffer.
+    void scanBuffer();
+
+    /// Incoming bytes not yet routed.
+    FrameBuffer buffer;
+
+    /// Outgoing airtime budget, serial bytes per second.
+    int bytesPerSecond;
+
+    /// ZigBee channel of the radio.
+    uint8_t channel;
+
+    /// Clock for control latency and pacing.
+    QElapsedTimer clock;
+
+    /// Bytes which may be written right now.
+    double credit;
+
+    /// Time credit was last topped up, in ns since clock started.
+    qint64 lastPace;
+
+    /// Every vehicle in the fleet.
+    QList<Member> members;
+
+    /// Member to be offered the link first on the next pace.
+    int next;
+
+    /// Drives writing queued frames.
+    QTimer *paceTimer;
+
+    /// The shared radio.
+    QIODevice *serialPort;
+
+    /// Publishes stats once a second.
+    QTimer *statsTimer;
+
+    /// Start of the current stats window, in ns since clock started.
+    qint64 windowStart;
+
+    friend class FleetPort;
+
+protected slots:
+    /// Forget the port of a member whose Vehicle has closed it.
+    void onPortDestroyed(QObject *port);
+
+    /// Route data from the radio.
+    void onReadyRead();
+
+    /// Write queued frames as the budget allows.
+    void pace();
+
+    /// Close the current stats window.
+    void updateStats();
+};
@@ -0,0 +1,99 @@
+#include "vehiclerelay.h"
+#include "vehicle.h"
+
+VehicleRelay::VehicleRelay(QObject *parent) :
+    QObject(parent), dropped(0), queue(), wakePending(0)
+{
+}
+
+void VehicleRelay::attach(Vehicle *vehicle)
+{
+    connect(vehicle, SIGNAL(imuChanged(int16_t,int16_t,int16_t,
+                                       int16_t,int16_t,int16_t)),
+            this, SLOT(onImu(int16_t,int16_t,int16_t,
+                             int16_t,int16_t,int16_t)),
+            Qt::DirectConnection);
+    connect(vehicle, SIGNAL(message(QByteArray,bool)),
+            this, SLOT(onMessage(QByteArray,bool)),
+            Qt::DirectConnection);
+    connect(vehicle, SIGNAL(telemetry1Received(Telemetry1Frame)),
+            this, SLOT(onTelemetry1(Telemetry1Frame)),
+            Qt::DirectConnection);
+    connect(vehicle, SIGNAL(telemetry2Received(Telemetry2Frame)),
+            this, SLOT(onTelemetry2(Telemetry2Frame)),
+            Qt::DirectConnection);
+}
+
+void VehicleRelay::drain()
+{
+    // Clear the flag first, anything posted from here on schedules another
+    // drain, anything posted before is picked up by this one.
+    wakePending.fetchAndStoreOrdered(0);
+    Event event;
+    while (queue.pop(&event)) {
+        switch (event.type) {
+        case Event::Imu:
+            emit imuChanged(event.imu[0], event.imu[1], event.imu[2],
+                            event.imu[3], event.imu[4], event.imu[5]);
+            break;
+        case Event::Message:
+            emit message(event.bytes, event.incoming);
+            break;
+        case Event::Telemetry1:
+            emit telemetry1Received(event.telemetry1);
+            break;
+        case Event::Telemetry2:
+            emit telemetry2Received(event.telemetry2);
+            break;
+        }
+    }
+}
+
+void VehicleRelay::onImu(int16_t gyroX, int16_t gyroY, int16_t gyroZ,
+                         int16_t accX, int16_t accY, int16_t accZ)
+{
+    Event event;
+    event.type = Event::Imu;
+    event.imu[0] = gyroX;
+    event.imu[1] = gyroY;
+    event.imu[2] = gyroZ;
+    event.imu[3] = accX;
+    event.imu[4] = accY;
+    event.imu[5] = accZ;
+    post(event);
+}
+
+void VehicleRelay::onMessage(QByteArray message, bool incoming)
+{
+    Event event;
+    event.type = Event::Message;
+    event.bytes = message;
+    event.incoming = incoming;
+    post(event);
+}
+
+void VehicleRelay::onTelemetry1(Telemetry1Frame const &frame)
+{
+    Event event;
+    event.type = Event::Telemetry1;
+    event.telemetry1 = frame;
+    post(event);
+}
+
+void VehicleRelay::onTelemetry2(Telemetry2Frame const &frame)
+{
+    Event event;
+    event.type = Event::Telemetry2;
+    event.telemetry2 = frame;
+    post(event);
+}
+
+void VehicleRelay::post(Event const &event)
+{
+    if (!queue.push(event)) {
+        dropped.fetchAndAddRelaxed(1);
+        return;
+    }
+    if (wakePending.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+}
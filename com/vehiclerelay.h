@@ -0,0 +1,113 @@
+#pragma once
+#include <stdint.h>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QObject>
+#include "spscqueue.h"
+#include "telemetry.h"
+
+class Vehicle;
+
+/// Carries the high-rate output of a Vehicle running on its own thread to
+/// the thread this relay lives in (normally the GUI thread).
+///
+/// The relay listens to the Vehicle with direct connections, so it is fed on
+/// the Vehicle's thread, and hands everything over through one lock-free
+/// SpscQueue. At most one queued wake-up is outstanding at a time however
+/// many frames arrive, and the relay re-emits every frame with the same
+/// signals the Vehicle has.<BR>
+/// Low-rate signals (state changes, enumeration results) are not relayed,
+/// ordinary queued connections to the Vehicle serve those.
+class VehicleRelay : public QObject
+{
+    Q_OBJECT
+public:
+    /// Constructor.
+    explicit VehicleRelay(QObject *parent = 0);
+
+    /// Start relaying the output of vehicle.
+    ///
+    /// Must be called before vehicle is moved to its own thread.
+    /// @param vehicle source of frames.
+    void attach(Vehicle *vehicle);
+
+    /// Number of frames lost because the queue was full.
+    /// @return total since construction.
+    int droppedCount() { return dropped.fetchAndAddRelaxed(0); }
+
+    /// Number of frames waiting to be re-emitted.
+    /// @return current queue depth.
+    int queueDepth() { return queue.size(); }
+
+signals:
+    /// Relayed Vehicle::imuChanged.
+    void imuChanged(int16_t gyroX,
+                    int16_t gyroY,
+                    int16_t gyroZ,
+                    int16_t accX,
+                    int16_t accY,
+                    int16_t accZ);
+
+    /// Relayed Vehicle::message.
+    void message(QByteArray message,
+                 bool incoming);
+
+    /// Relayed Vehicle::telemetry1Received.
+    void telemetry1Received(Telemetry1Frame const &frame);
+
+    /// Relayed Vehicle::telemetry2Received.
+    void telemetry2Received(Telemetry2Frame const &frame);
+
+protected:
+    /// One relayed signal.
+    struct Event
+    {
+        /// Which signal this is.
+        enum Type {
+            Imu,
+            Message,
+            Telemetry1,
+            Telemetry2
+        } type;
+
+        /// Arguments of Vehicle::message.
+        QByteArray bytes;
+        bool incoming;
+
+        /// Arguments of the other signals, selected by type.
+        union {
+            int16_t imu[6];
+            Telemetry1Frame telemetry1;
+            Telemetry2Frame telemetry2;
+        };
+    };
+
+    /// Queue an event and make sure a drain is scheduled.
+    void post(Event const &event);
+
+    /// Frames lost to a full queue.
+    QAtomicInt dropped;
+
+    /// Frames in flight from the Vehicle's thread to this one.
+    SpscQueue<Event, 1024> queue;
+
+    /// Set while a drain() invocation is pending.
+    QAtomicInt wakePending;
+
+protected slots:
+    /// Re-emit everything queued, runs in the relay's thread.
+    void drain();
+
+    /// Feed from Vehicle::imuChanged, runs in the Vehicle's thread.
+    void onImu(int16_t gyroX, int16_t gyroY, int16_t gyroZ,
+               int16_t accX, int16_t accY, int16_t accZ);
+
+    /// Feed from Vehicle::message, runs in the Vehicle's thread.
+    void onMessage(QByteArray message, bool incoming);
+
+    /// Feed from Vehicle::telemetry1Received, runs in the Vehicle's thread.
+    void onTelemetry1(Telemetry1Frame const &frame);
+
+    /// Feed from Vehicle::telemetry2Received, runs in the Vehicle's thread.
+    void onTelemetry2(Telemetry2Frame const &frame);
+};
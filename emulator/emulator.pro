@@ -0,0 +1,24 @@
+TEMPLATE = app
+TARGET = vehicleemulator
+DESTDIR = ../bin/
+CONFIG += console
+CONFIG -= app_bundle
+QT -= gui
+QT += network
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    vehicleemulator.cpp \
+    ../com/crc16.cpp \
+    ../com/framebuffer.cpp \
+    ../com/tea.cpp \
+    ../com/telemetry.cpp
+
+HEADERS += \
+    vehicleemulator.h \
+    ../com/crc16.h \
+    ../com/framebuffer.h \
+    ../com/tea.h \
+    ../com/telemetry.h
+
+QMAKE_CXXFLAGS += -pedantic -Werror -Wextra -Wno-long-long
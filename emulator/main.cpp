@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QStringList>
+#include "vehicleemulator.h"
+
+/// Headless vehicle emulator.
+///
+/// Options:
+/// -w           wired framing at 115200 baud (default XBee at 57600)
+/// -l path      symlink to create for the slave device
+/// -m mac       vehicle MAC in hex
+/// -c channel   XBee channel in hex (0xC to 0x17)
+/// -b baud      pace output to this baud rate, 0 for unpaced
+/// -t hz        telemetry rate, 0 to saturate the line
+/// -i hz        bypass IMU rate, 0 to saturate the line
+/// -n p         probability of noise before each message
+/// -x p         probability of a corrupt checksum on each message
+/// -f p         probability of fragmenting each write
+/// -s seed      seed for synthetic values and fault injection
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    VehicleEmulator emulator;
+    bool wired = args.contains("-w");
+    emulator.setWired(wired);
+    emulator.setBaudRate(wired? 115200 : 57600);
+    for (int i = 1; i < args.length() - 1; i++) {
+        QString value = args.value(i + 1);
+        if (args[i] == "-m")
+            emulator.setMac(value.toULongLong(0, 16));
+        else if (args[i] == "-c")
+            emulator.setChannel(value.toUInt(0, 16));
+        else if (args[i] == "-b")
+            emulator.setBaudRate(value.toInt());
+        else if (args[i] == "-t")
+            emulator.setTelemetryRate(value.toInt());
+        else if (args[i] == "-i")
+            emulator.setImuRate(value.toInt());
+        else if (args[i] == "-n")
+            emulator.setNoise(value.toDouble());
+        else if (args[i] == "-x")
+            emulator.setCorruption(value.toDouble());
+        else if (args[i] == "-f")
+            emulator.setFragmentation(value.toDouble());
+        else if (args[i] == "-s")
+            emulator.setSeed(value.toUInt());
+    }
+    int link = args.indexOf("-l");
+    if (!emulator.open(link > 0? args.value(link + 1) : QString())) {
+        fprintf(stderr, "Could not create pseudo-terminal\n");
+        return 1;
+    }
+    printf("%s\n", emulator.portName().toLocal8Bit().constData());
+    fflush(stdout);
+    return a.exec();
+}
@@ -0,0 +1,497 @@
+#include "vehicleemulator.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <QFile>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QtEndian>
+#include "com/crc16.h"
+#include "com/tea.h"
+#include "com/telemetry.h"
+#include "com/vehicle.h" // teaKey
+
+namespace {
+/// MAC reported for the local XBee module by SL / SH.
+uint64_t const localMac = 0x0013A20040000001ULL;
+
+/// Size the transmit queue may reach before new messages are dropped, only
+/// reached when nothing is reading the slave side.
+int const maxQueued = 65536;
+
+/// Queue depth below which a saturating stream adds another message.
+int const lowWater = 256;
+
+/// Streaming stops if telemetry is not re-requested within this time, ns.
+int64_t const telemetryTimeout = 3000000000LL;
+
+/// TEA engine for the API key.
+Tea const &apiTea()
+{
+    static Tea const tea(teaKey);
+    return tea;
+}
+
+/// XBee API checksum, as Vehicle::checksum().
+unsigned char checksum(unsigned char const *data, int length)
+{
+    unsigned char sum = 0;
+    for (int i = 0; i < length; i++)
+        sum += data[i];
+    return 0xFFU - sum;
+}
+
+/// Wrap a body in an XBee API frame.
+QByteArray xbeeFrame(uint8_t type, QByteArray const &body)
+{
+    QByteArray frame(4, 0);
+    frame[0] = 0x7E;
+    qToBigEndian<uint16_t>(body.length() + 1, (uchar *)frame.data() + 1);
+    frame[3] = type;
+    frame.append(body);
+    frame.append(checksum((unsigned char const *)frame.constData() + 3,
+                          frame.length() - 3));
+    return frame;
+}
+}
+
+VehicleEmulator::VehicleEmulator(QObject *parent) :
+    QObject(parent), allowance(0), baud(57600), bypass(false), clock(),
+    configBuffer(), controlCount(0), corruption(0), fragmentation(0),
+    imuRate(100), lastTick(0), master(-1), noise(0), notifier(0),
+    random(1), rejectCount(0), reportedBytes(0), reporting(true), rxCount(0),
+    rxBuffer(), slave(-1), slaveName(), telemetryRequested(-1),
+    telemetryRate(10), throttleMode(1), timer(new QTimer(this)), txBytes(0),
+    txQueue(), vehicleChannel(0xC), vehicleMac(0x0013A20040A1B2C3ULL),
+    wired(false), xbeeChannel(0)
+{
+    imuStream.next = 0;
+    imuStream.sent = 0;
+    telemetryStream.next = 0;
+    telemetryStream.sent = 0;
+    connect(timer, SIGNAL(timeout()),
+            this, SLOT(onTick()));
+}
+
+VehicleEmulator::~VehicleEmulator()
+{
+    if (slave >= 0)
+        close(slave);
+    if (master >= 0)
+        close(master);
+}
+
+void VehicleEmulator::atResponse(uint8_t frameId, char const *command,
+                                 QByteArray const &value)
+{
+    QByteArray body(4, 0);
+    body[0] = frameId;
+    body[1] = command[0];
+    body[2] = command[1];
+    body[3] = 0; // Status OK
+    body.append(value);
+    post(xbeeFrame(0x88, body));
+}
+
+bool VehicleEmulator::chance(double probability)
+{
+    return probability > 0 && next() < probability * 4294967295.0;
+}
+
+QByteArray VehicleEmulator::configMessage(uint8_t type, uint8_t subType,
+                                          QByteArray const &body)
+{
+    uint16_t length = body.length() + 1;
+    length = ((length % 8) == 0)? length : ((length >> 3) + 1) << 3;
+    QByteArray message(length + 6, 0);
+    unsigned char *bytes = (unsigned char *)message.data();
+    bytes[0] = 0xFF;
+    bytes[1] = type;
+    qToBigEndian<uint16_t>(length, bytes + 2);
+    bytes[4] = subType;
+    memcpy(bytes + 5, body.constData(), body.length());
+    qToLittleEndian(Crc16::compute(bytes + 1, length + 3), bytes + length + 4);
+    if (type != 6)
+        apiTea().encrypt(bytes, bytes, 4, length);
+    return message;
+}
+
+void VehicleEmulator::handleConfig(unsigned char const *data, int length)
+{
+    Q_UNUSED(length);
+    uint8_t type = data[1];
+    uint8_t subType = data[4];
+    uint8_t mode = data[5];
+    if (type == 1 && subType == 22) { // Telemetry stream request
+        if (mode) {
+            if (telemetryRequested < 0)
+                telemetryStream.next = now();
+            telemetryRequested = now();
+        } else {
+            telemetryRequested = -1;
+        }
+    } else if (type == 2 && subType == 16) { // EEPROM throttle-mode read
+        post(configMessage(2, 16, QByteArray(1, (char)throttleMode)));
+    } else if (type == 5) { // Controls
+        controlCount++;
+    } else if (type == 6 && subType == 0) { // Bypass-mode
+        if (mode && !bypass)
+            imuStream.next = now();
+        bypass = mode;
+    } else if (type == 6 && subType == 1) { // Motor speeds
+        controlCount++;
+    }
+}
+
+void VehicleEmulator::handlePayload(uint64_t destination,
+                                    QByteArray const &payload)
+{
+    // The vehicle only hears what is sent on its own channel to it or to
+    // broadcast.
+    if (xbeeChannel != vehicleChannel ||
+            (destination != vehicleMac && destination != 0xFFFFULL))
+        return;
+    unsigned char const *data = (unsigned char const *)payload.constData();
+    if (!configBuffer.isEmpty() || data[0] == 0xFF) {
+        // Config messages longer than one frame arrive in 85 byte pieces.
+        configBuffer.append(payload);
+        if (configBuffer.length() < 4)
+            return;
+        unsigned char *bytes = (unsigned char *)configBuffer.data();
+        uint16_t length = qFromBigEndian<uint16_t>(bytes + 2);
+        if (length > 200) {
+            rejectCount++;
+            configBuffer.clear();
+            return;
+        }
+        if (configBuffer.length() < length + 6)
+            return;
+        if (bytes[1] != 0x6 && bytes[1] != 0xA)
+            apiTea().decrypt(bytes, bytes, 4, length);
+        if (Crc16::compute(bytes + 1, length + 5) == 0)
+            handleConfig(bytes, length + 6);
+        else
+            rejectCount++;
+        configBuffer.clear();
+        return;
+    }
+    if (Crc16::compute(data, payload.length()) != 0) {
+        rejectCount++;
+        return;
+    }
+    QByteArray response;
+    switch (data[0]) {
+    case 0xF8: // Identify request
+        response = QByteArray(18, 0);
+        response[0] = (char)0xF8;
+        response[17] = vehicleChannel - 0xC;
+        break;
+    case 0x01: // Query
+        response = QByteArray(1, 0x01);
+        break;
+    case 0x07: // Controls
+        controlCount++;
+        break;
+    default: // Acquire, alarm acknowledgement
+        break;
+    }
+    if (response.isEmpty())
+        return;
+    response.resize(response.length() + 2);
+    qToLittleEndian(Crc16::compute((unsigned char const *)
+                                   response.constData(),
+                                   response.length() - 2),
+                    (unsigned char *)response.data() + response.length() - 2);
+    post(response);
+}
+
+QByteArray VehicleEmulator::imuMessage()
+{
+    double t = now() / 1e9;
+    unsigned char body[12];
+    qToLittleEndian<int16_t>(200 * sin(t), body);
+    qToLittleEndian<int16_t>(200 * cos(t), body + 2);
+    qToLittleEndian<int16_t>(50 * sin(3 * t), body + 4);
+    qToLittleEndian<int16_t>(next() % 32, body + 6);
+    qToLittleEndian<int16_t>(next() % 32, body + 8);
+    qToLittleEndian<int16_t>(1000 + next() % 32, body + 10);
+    imuStream.sent++;
+    return configMessage(6, 0, QByteArray((char const *)body, 12));
+}
+
+uint32_t VehicleEmulator::next()
+{
+    // xorshift32
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    return random;
+}
+
+void VehicleEmulator::onReadable()
+{
+    char chunk[1024];
+    for (;;) {
+        ssize_t count = read(master, chunk, sizeof(chunk));
+        if (count <= 0)
+            break;
+        rxBuffer.append(chunk, count);
+        scan();
+    }
+}
+
+void VehicleEmulator::onReport()
+{
+    fprintf(stderr, "tx %llu B/s, queued %d, rx %llu, rejected %llu, "
+            "controls %llu, telemetry %llu, imu %llu\n",
+            (unsigned long long)(txBytes - reportedBytes), txQueue.length(),
+            (unsigned long long)rxCount, (unsigned long long)rejectCount,
+            (unsigned long long)controlCount,
+            (unsigned long long)telemetryStream.sent,
+            (unsigned long long)imuStream.sent);
+    reportedBytes = txBytes;
+}
+
+void VehicleEmulator::onTick()
+{
+    int64_t t = now();
+    if (baud) {
+        // Allow bursts of up to 20 ms worth of bytes.
+        double perNs = baud / 10.0 / 1e9;
+        allowance = qMin(allowance + (t - lastTick) * perNs,
+                         qMax(128.0, 20000000 * perNs));
+    }
+    lastTick = t;
+
+    bool telemetry = telemetryRequested >= 0 &&
+            t - telemetryRequested < telemetryTimeout &&
+            (wired || xbeeChannel == vehicleChannel);
+    bool imu = wired && bypass;
+    Stream *streams[2] = { telemetry? &telemetryStream : 0,
+                           imu? &imuStream : 0 };
+    int rates[2] = { telemetryRate, imuRate };
+    for (int i = 0; i < 2; i++) {
+        if (!streams[i])
+            continue;
+        if (rates[i] > 0) {
+            // Catch up at most one second, beyond that start afresh.
+            if (t - streams[i]->next > 1000000000)
+                streams[i]->next = t;
+            while (t >= streams[i]->next) {
+                post(i? imuMessage() : telemetryMessage(
+                         22 + telemetryStream.sent % 2));
+                streams[i]->next += 1000000000 / rates[i];
+            }
+        } else {
+            while (txQueue.length() < lowWater)
+                post(i? imuMessage() : telemetryMessage(
+                         22 + telemetryStream.sent % 2));
+        }
+    }
+    transmit();
+}
+
+bool VehicleEmulator::open(QString const &link)
+{
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master))
+        return false;
+    slaveName = QString::fromLocal8Bit(ptsname(master));
+    slave = ::open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (slave < 0)
+        return false;
+    termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    if (!link.isEmpty()) {
+        QFile::remove(link);
+        QFile::link(slaveName, link);
+    }
+    notifier = new QSocketNotifier(master, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)),
+            this, SLOT(onReadable()));
+    if (reporting) {
+        QTimer *report = new QTimer(this);
+        connect(report, SIGNAL(timeout()),
+                this, SLOT(onReport()));
+        report->start(1000);
+    }
+    clock.start();
+    lastTick = now();
+    timer->start(1);
+    return true;
+}
+
+void VehicleEmulator::post(QByteArray const &message)
+{
+    QByteArray frame = message;
+    if (!wired && (uchar)message[0] != 0x7E) {
+        // Deliver as received from the vehicle's XBee module.
+        QByteArray body(10, 0);
+        qToBigEndian<quint64>(vehicleMac, (uchar *)body.data());
+        body[8] = 0x28; // RSSI
+        body[9] = 0x00; // Options
+        frame = xbeeFrame(0x80, body + message);
+    }
+    if (chance(corruption))
+        frame[frame.length() - 1] = frame[frame.length() - 1] ^
+                (1 << (next() % 8));
+    if (chance(noise)) {
+        QByteArray garbage(1 + next() % 8, 0);
+        for (int i = 0; i < garbage.length(); i++)
+            garbage[i] = next();
+        // Sometimes include a false delimiter to test resynchronisation.
+        if (next() % 2)
+            garbage[next() % garbage.length()] = wired? (char)0xFF : 0x7E;
+        frame.prepend(garbage);
+    }
+    if (txQueue.length() + frame.length() <= maxQueued)
+        txQueue.append(frame);
+}
+
+void VehicleEmulator::scan()
+{
+    while (rxBuffer.length() >= (wired? 6 : 5)) {
+        unsigned char const *data = rxBuffer.data();
+        if (data[0] != (wired? 0xFF : 0x7E)) {
+            int delim = rxBuffer.indexOf(wired? 0xFF : 0x7E, 1);
+            if (delim > 0)
+                rxBuffer.consume(delim);
+            else
+                rxBuffer.clear();
+            continue;
+        }
+        uint16_t length = qFromBigEndian<uint16_t>(data + (wired? 2 : 1));
+        if (wired) {
+            if (length > 200) {
+                rxBuffer.consume(1);
+                continue;
+            }
+            if (length + 6 > rxBuffer.length())
+                return;
+            QByteArray message((char const *)data, length + 6);
+            unsigned char *bytes = (unsigned char *)message.data();
+            if (bytes[1] != 0x6 && bytes[1] != 0xA)
+                apiTea().decrypt(bytes, bytes, 4, length);
+            if (Crc16::compute(bytes + 1, length + 5) != 0) {
+                rejectCount++;
+                rxBuffer.consume(1);
+                continue;
+            }
+            rxBuffer.consume(length + 6);
+            rxCount++;
+            handleConfig(bytes, length + 6);
+            continue;
+        }
+        if (length == 0 || length > 100) {
+            rxBuffer.consume(1);
+            continue;
+        }
+        if (length + 4 > rxBuffer.length())
+            return;
+        if (checksum(data + 3, length + 1)) {
+            rejectCount++;
+            rxBuffer.consume(1);
+            continue;
+        }
+        rxCount++;
+        QByteArray frame((char const *)data, length + 4);
+        rxBuffer.consume(length + 4);
+        data = (unsigned char const *)frame.constData();
+        if (data[3] == 0x08 && length >= 4) { // AT command
+            if (data[5] == 'C' && data[6] == 'H' && length >= 5) {
+                xbeeChannel = data[7];
+                atResponse(data[4], "CH");
+            } else if (data[5] == 'S' && (data[6] == 'L' || data[6] == 'H')) {
+                QByteArray value(4, 0);
+                qToBigEndian<uint32_t>(data[6] == 'L'? localMac :
+                                       localMac >> 32,
+                                       (uchar *)value.data());
+                atResponse(data[4], data[6] == 'L'? "SL" : "SH", value);
+            }
+        } else if (data[3] == 0x00 && length > 11) { // 64-bit transmit
+            handlePayload(qFromBigEndian<quint64>(data + 5),
+                          frame.mid(14, length - 11));
+        }
+    }
+}
+
+QByteArray VehicleEmulator::telemetryMessage(int type)
+{
+    double t = now() / 1e9;
+    unsigned char message[6 + Telemetry1Frame::Length] = { 0 };
+    if (type == 22) {
+        Telemetry1Frame frame;
+        frame.roll = 20 * sin(t);
+        frame.pitch = 15 * cos(0.7 * t);
+        frame.yaw = fmod(10 * t, 360) - 180;
+        frame.packetLoss = next() % 4;
+        frame.rssi = 60 + next() % 20;
+        frame.throttle = 500;
+        frame.altPre = 10 + sin(0.1 * t);
+        frame.magX = 200;
+        frame.magY = -150;
+        frame.magZ = 400;
+        frame.velN = cos(0.1 * t);
+        frame.velE = sin(0.1 * t);
+        frame.velD = 0;
+        frame.errN = 0.5;
+        frame.errE = -0.5;
+        frame.errD = 0.2;
+        frame.battHeli = 14.8 - t / 3600;
+        frame.flightTime = (unsigned int)t;
+        frame.svs = 9;
+        frame.holdMode = 1;
+        frame.picture = 0;
+        frame.current = 12.5;
+        frame.encode(message);
+    } else {
+        Telemetry2Frame frame;
+        frame.roll = 20 * sin(t);
+        frame.pitch = 15 * cos(0.7 * t);
+        frame.yaw = fmod(10 * t, 360) - 180;
+        frame.packetLoss = next() % 4;
+        frame.rssi = 60 + next() % 20;
+        frame.throttle = 500;
+        frame.altPre = 10 + sin(0.1 * t);
+        frame.altGps = 1050;
+        frame.lat = 52.13 + 0.0001 * sin(0.1 * t);
+        frame.lng = -106.63 + 0.0001 * cos(0.1 * t);
+        frame.pdop = 1.2;
+        frame.hacc = 1.5;
+        frame.vacc = 2.5;
+        frame.gpsTime = (int)(t * 1000);
+        frame.temperature = 21.5;
+        frame.tilt = 0;
+        frame.encode(message);
+    }
+    telemetryStream.sent++;
+    return configMessage(1, type, QByteArray((char const *)message + 5,
+                                             Telemetry1Frame::Length - 1));
+}
+
+void VehicleEmulator::transmit()
+{
+    if (txQueue.isEmpty())
+        return;
+    int count = txQueue.length();
+    if (baud)
+        count = qMin(count, (int)allowance);
+    if (count > 0 && chance(fragmentation))
+        count = 1 + next() % count;
+    if (count <= 0)
+        return;
+    ssize_t written = write(master, txQueue.constData(), count);
+    if (written <= 0)
+        return; // EAGAIN, Vehicle is not keeping up
+    txQueue.remove(0, written);
+    txBytes += written;
+    if (baud)
+        allowance -= written;
+}
@@ -0,0 +1,254 @@
+#pragma once
+#include <stdint.h>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include "com/framebuffer.h"
+
+class QSocketNotifier;
+class QTimer;
+
+/// Headless stand-in for a Draganflyer vehicle (and its XBee module) on the
+/// far side of a pseudo-terminal.
+///
+/// Vehicle opens the slave side of the PTY exactly as it would a real serial
+/// port. In XBee mode the emulator answers AT commands (CH, SL, SH),
+/// enumeration requests, acquire and query, and EEPROM throttle-mode reads.
+/// In wired mode it answers EEPROM reads and bypass-mode requests. Once
+/// requested it streams telemetry #22 / #23 and, in wired bypass-mode, IMU
+/// messages at the configured rates.<BR>
+/// Output is paced to the configured baud rate. A rate of 0 keeps the line
+/// saturated. Noise, corrupted checksums and fragmented writes can be
+/// injected to exercise resynchronisation in the parser.
+class VehicleEmulator : public QObject
+{
+    Q_OBJECT
+public:
+    /// Constructor.
+    explicit VehicleEmulator(QObject *parent = 0);
+
+    /// Destructor.
+    ~VehicleEmulator();
+
+    /// Create the pseudo-terminal and start serving it.
+    /// @return false if the pseudo-terminal could not be created.
+    /// @param link if not empty, a symlink to the slave device created here.
+    bool open(QString const &link = QString());
+
+    /// Get the device Vehicle should open.
+    /// @return path of the slave side of the pseudo-terminal.
+    QString portName() const { return slaveName; }
+
+    /// Set line speed used to pace output, 57600 (XBee) or 115200 (wired).
+    /// @param baud bits per second at 10 bits per byte, 0 for unpaced.
+    void setBaudRate(int baud) { this->baud = baud; }
+
+    /// Set the XBee channel the emulated vehicle listens on.
+    /// @param channel 0x0C to 0x17.
+    void setChannel(uint8_t channel) { vehicleChannel = channel; }
+
+    /// Set probability of corrupting the checksum of each outgoing message.
+    /// @param probability 0 to 1.
+    void setCorruption(double probability) { corruption = probability; }
+
+    /// Set probability of splitting each write at a random point, with the
+    /// remainder following on a later write.
+    /// @param probability 0 to 1.
+    void setFragmentation(double probability) { fragmentation = probability; }
+
+    /// Set IMU message rate while in wired bypass-mode.
+    /// @param hz messages per second, 0 to saturate the line.
+    void setImuRate(int hz) { imuRate = hz; }
+
+    /// Set MAC address of the emulated XBee module on the vehicle.
+    /// @param mac 64-bit address.
+    void setMac(uint64_t mac) { vehicleMac = mac; }
+
+    /// Set probability of injecting random bytes before each message.
+    /// @param probability 0 to 1.
+    void setNoise(double probability) { noise = probability; }
+
+    /// Enable the once a second report of counters on stderr.
+    /// @param enabled true by default, takes effect on open().
+    void setReporting(bool enabled) { reporting = enabled; }
+
+    /// Seed the generator behind synthetic values and fault injection.
+    /// @param seed any value, runs with equal seeds are repeatable.
+    void setSeed(unsigned int seed) { random = seed? seed : 1; }
+
+    /// Set telemetry message rate, #22 and #23 alternate.
+    /// @param hz messages per second, 0 to saturate the line.
+    void setTelemetryRate(int hz) { telemetryRate = hz; }
+
+    /// Set throttle mode reported by EEPROM reads.
+    /// @param mode 0 or 1.
+    void setThrottleMode(int mode) { throttleMode = mode; }
+
+    /// Select wired (0xFF messages) or XBee (0x7E API frames) framing.
+    /// @param wired true for wired.
+    void setWired(bool wired) { this->wired = wired; }
+
+protected:
+    /// Stream bookkeeping.
+    struct Stream
+    {
+        int64_t next;      ///< Deadline of the next message, ns.
+        quint64 sent;      ///< Messages sent.
+    };
+
+    /// Queue an AT command response.
+    void atResponse(uint8_t frameId, char const *command,
+                    QByteArray const &value = QByteArray());
+
+    /// Check whether a fault with the given probability should be injected.
+    bool chance(double probability);
+
+    /// Build a config message as the vehicle would.
+    /// @return padded, CRC'd and (for all types but 6) encrypted message.
+    /// @param type message type.
+    /// @param subType message subtype.
+    /// @param body bytes from offset 5 onwards (mode and payload).
+    QByteArray configMessage(uint8_t type, uint8_t subType,
+                             QByteArray const &body);
+
+    /// Handle a complete, decrypted config message from Vehicle.
+    void handleConfig(unsigned char const *data, int length);
+
+    /// Handle the payload of an XBee transmit request from Vehicle.
+    void handlePayload(uint64_t destination, QByteArray const &payload);
+
+    /// Build the next IMU message.
+    QByteArray imuMessage();
+
+    /// Current time on the monotonic clock.
+    /// @return nanoseconds since open().
+    int64_t now() const { return clock.nsecsElapsed(); }
+
+    /// Generate the next pseudo-random number.
+    uint32_t next();
+
+    /// Queue a message for the line, wrapping it as the framing requires and
+    /// applying noise and corruption.
+    /// @param message config message or, in XBee mode, a raw payload.
+    void post(QByteArray const &message);
+
+    /// Parse frames received from Vehicle.
+    void scan();
+
+    /// Build the next telemetry message.
+    /// @param type 22 or 23.
+    QByteArray telemetryMessage(int type);
+
+    /// Move bytes from the transmit queue to the line within the baud budget.
+    void transmit();
+
+    /// Bytes which may be written before the baud budget is exhausted.
+    double allowance;
+
+    /// Line speed in bits per second, 0 for unpaced.
+    int baud;
+
+    /// True while Vehicle has requested bypass-mode.
+    bool bypass;
+
+    /// Time base for pacing and stream deadlines.
+    QElapsedTimer clock;
+
+    /// Config message being reassembled from consecutive XBee payloads.
+    QByteArray configBuffer;
+
+    /// Control messages received.
+    quint64 controlCount;
+
+    /// Probability of corrupting an outgoing checksum.
+    double corruption;
+
+    /// Probability of fragmenting a write.
+    double fragmentation;
+
+    /// Rate of IMU messages, 0 to saturate.
+    int imuRate;
+
+    /// IMU stream state.
+    Stream imuStream;
+
+    /// Time of the last pacing tick, ns.
+    int64_t lastTick;
+
+    /// Master side of the pseudo-terminal, or -1.
+    int master;
+
+    /// Probability of injecting noise.
+    double noise;
+
+    /// Watches master for bytes from Vehicle.
+    QSocketNotifier *notifier;
+
+    /// Current state of the pseudo-random generator.
+    uint32_t random;
+
+    /// Messages from Vehicle discarded for bad checksum or CRC.
+    quint64 rejectCount;
+
+    /// Value of txBytes at the last report.
+    quint64 reportedBytes;
+
+    /// Report counters once a second, see setReporting().
+    bool reporting;
+
+    /// Messages received from Vehicle.
+    quint64 rxCount;
+
+    /// Bytes received from Vehicle, not yet parsed.
+    FrameBuffer rxBuffer;
+
+    /// Slave side held open so that the master never sees a hang-up while
+    /// Vehicle has the port closed.
+    int slave;
+
+    /// Path of the slave side.
+    QString slaveName;
+
+    /// Time telemetry was last requested, streaming stops 3 s after.
+    int64_t telemetryRequested;
+
+    /// Rate of telemetry messages, 0 to saturate.
+    int telemetryRate;
+
+    /// Telemetry stream state.
+    Stream telemetryStream;
+
+    /// Throttle mode reported by EEPROM reads.
+    int throttleMode;
+
+    /// Drives pacing and streams.
+    QTimer *timer;
+
+    /// Bytes written to the line.
+    quint64 txBytes;
+
+    /// Bytes waiting for the line.
+    QByteArray txQueue;
+
+    /// Channel the vehicle listens on.
+    uint8_t vehicleChannel;
+
+    /// MAC of the emulated vehicle's XBee module.
+    uint64_t vehicleMac;
+
+    /// Framing, see setWired().
+    bool wired;
+
+    /// Channel last set with CH.
+    uint8_t xbeeChannel;
+
+protected slots:
+    /// Read everything Vehicle has written.
+    void onReadable();
+
+    /// Report counters on stderr.
+    void onReport();
+
+    /// Pace output and generate streamed messages.
+    void onTick();
+};
@@ -6,25 +6,32 @@
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QPushButton>
+#include <QThread>
 #include <QVBoxLayout>
 
+#include "com/channelcache.h"
 #include "com/serial/qextserialenumerator.h"
+#include "com/vehicleenumerator.h"
+#include "com/vehiclerelay.h"
 #include "controlwidget.h"
 #include "monitorwidget.h"
 #include "telemetrywidget.h"
 
-ConfigWidget::ConfigWidget(QHostAddress hostAddress, quint16 hostUdp, QWidget *parent) :
+ConfigWidget::ConfigWidget(QHostAddress hostAddress, quint16 hostUdp, bool threaded, QWidget *parent) :
     QWidget(parent),
     acquire(new QPushButton("Connect", this)),
     config(new QCheckBox("Config", this)),
+    connectClock(),
     controlWidget(new ControlWidget(this)),
     enterBypass(new QPushButton("Bypass-On", this)),
+    enumerator(new VehicleEnumerator(this)),
     hostAddress(hostAddress),
     hostUdp(hostUdp),
     joystick(new QCheckBox("Joystick", this)),
     leaveBypass(new QPushButton("Bypass-Off", this)),
     monitorWidget(new MonitorWidget(this)),
     portList(new QComboBox(this)),
+    relay(threaded? new VehicleRelay(this) : 0),
     scanPorts(new QPushButton(
             style()->standardIcon(QStyle::SP_BrowserReload), "", this)),
     scanVehicles(new QPushButton(
@@ -32,8 +39,10 @@ ConfigWidget::ConfigWidget(QHostAddress hostAddress, quint16 hostUdp, QWidget *p
     status(new QLabel("IDLE", this)),
     telemetry(new QCheckBox("Telemetry", this)),
     telemetryWidget(new TelemetryWidget(this)),
-    vehicle(new Vehicle(this)),
+    vehicle(new Vehicle(threaded? 0 : this)),
     vehicleList(new QComboBox(this)),
+    vehicleState(Vehicle::IDLE),
+    vehicleThread(threaded? new QThread(this) : 0),
     zigbee(new QCheckBox("Zigbee", this))
 
 {
@@ -46,6 +55,19 @@ ConfigWidget::ConfigWidget(QHostAddress hostAddress, quint16 hostUdp, QWidget *p
     enterBypass->setEnabled(false);
     leaveBypass->setEnabled(false);
 
+    // High-rate output either comes straight from the Vehicle or, when it
+    // runs on its own thread, through the relay.
+    QObject *source = vehicle;
+    if (vehicleThread) {
+        relay->attach(vehicle);
+        source = relay;
+        vehicle->moveToThread(vehicleThread);
+        // Deleted in its own thread as that finishes, with its timers.
+        connect(vehicleThread, SIGNAL(finished()),
+                vehicle, SLOT(deleteLater()));
+        vehicleThread->start();
+    }
+
     connect(acquire, SIGNAL(clicked()),
             this, SLOT(connectClicked()));
     connect(controlWidget,
@@ -60,29 +82,22 @@ ConfigWidget::ConfigWidget(QHostAddress hostAddress, quint16 hostUdp, QWidget *p
             this, SLOT(enumerate()));
     connect(telemetry, SIGNAL(toggled(bool)),
             vehicle, SLOT(streamTelemetry(bool)));
-    connect(vehicle, SIGNAL(message(QByteArray,bool)),
+    connect(source, SIGNAL(message(QByteArray,bool)),
             monitorWidget, SLOT(onMessage(QByteArray,bool)));
-    connect(vehicle,
-            SIGNAL(telemetry1Changed(float,float,float,int,int,uint,float,int,
-                                     int,int,float,float,float,float,float,
-                                     float,float,uint,int,int,int,float)),
-            telemetryWidget,
-            SLOT(telemetry1(float,float,float,int,int,uint,float,int,int,int,
-                            float,float,float,float,float,float,float,uint,int,
-                            int,int,float)));
-    connect(vehicle,
-            SIGNAL(telemetry2Changed(float,float,float,int,int,uint,float,int,
-                                     double,double,float,float,float,int,float,
-                                     uint)),
-            telemetryWidget,
-            SLOT(telemetry2(float,float,float,int,int,uint,float,int,double,
-                            double,float,float,float,int,float,uint)));
-    connect(vehicle, SIGNAL(imuChanged(int16_t,int16_t,int16_t,
+    connect(source, SIGNAL(telemetry1Received(Telemetry1Frame)),
+            telemetryWidget, SLOT(telemetry1(Telemetry1Frame)));
+    connect(source, SIGNAL(telemetry2Received(Telemetry2Frame)),
+            telemetryWidget, SLOT(telemetry2(Telemetry2Frame)));
+    connect(source, SIGNAL(imuChanged(int16_t,int16_t,int16_t,
                                        int16_t,int16_t,int16_t)),
             telemetryWidget, SLOT(bypassImu(int16_t,int16_t,int16_t,
                                             int16_t,int16_t,int16_t)));
     connect(vehicle, SIGNAL(vehicleFound(uint64_t,uint8_t)),
             this, SLOT(onVehicleFound(uint64_t,uint8_t)));
+    connect(enumerator, SIGNAL(vehicleFound(uint64_t,uint8_t)),
+            this, SLOT(onVehicleFound(uint64_t,uint8_t)));
+    connect(enumerator, SIGNAL(finished()),
+            this, SLOT(enumerationFinished()));
     connect(vehicle, SIGNAL(stateChanged(Vehicle::VehicleState)),
             this, SLOT(onVehicleStateChanged(Vehicle::VehicleState)));
     connect(joystick, SIGNAL(toggled(bool)),
@@ -138,11 +153,23 @@ ConfigWidget::ConfigWidget(QHostAddress hostAddress, quint16 hostUdp, QWidget *p
         zigbee->setVisible(false);
         vehicleList->setVisible(false);
         scanVehicles->setVisible(false);
-    } else
+    } else {
         checkPorts();
+        listKnownVehicles();
+    }
     checkBypass();
 }
 
+ConfigWidget::~ConfigWidget()
+{
+    if (vehicleThread) {
+        QMetaObject::invokeMethod(vehicle, "close",
+                                  Qt::BlockingQueuedConnection);
+        vehicleThread->quit();
+        vehicleThread->wait();
+    }
+}
+
 void ConfigWidget::checkPorts()
 {
     portList->clear();
@@ -165,24 +192,39 @@ void ConfigWidget::checkPorts()
 void ConfigWidget::connectClicked()
 {
     qDebug()<<hostAddress<<hostUdp;
-    switch (vehicle->getState()) {
+    switch (vehicleState) {
     case Vehicle::IDLE:
+    {
         // If idle we can try to connect.
+        connectClock.start();
+        uint64_t mac = vehicleList->currentText().toULongLong(0, 16);
+        uint8_t channel = vehicleList->itemData(
+                    vehicleList->currentIndex()).toUInt();
+        if (channel == 0)
+            channel = enumerator->channelCache().channel(mac);
+        // Invoked rather than called so that this works whichever thread the
+        // Vehicle lives in.
         if (zigbee->isChecked())
-            vehicle->open(portList->currentText(),
-                          vehicleList->currentText().toULongLong(0, 16),
-                          vehicleList->itemData(
-                              vehicleList->currentIndex()).toUInt(),
-                          config->isChecked());
+            QMetaObject::invokeMethod(
+                        vehicle, "open",
+                        Q_ARG(QString, portList->currentText()),
+                        Q_ARG(uint64_t, mac),
+                        Q_ARG(uint8_t, channel),
+                        Q_ARG(bool, config->isChecked()));
         else if (!hostAddress.isNull() && hostUdp > 0)
-            vehicle->open(hostAddress, hostUdp);
+            QMetaObject::invokeMethod(vehicle, "open",
+                                      Q_ARG(QHostAddress, hostAddress),
+                                      Q_ARG(quint16, hostUdp));
         else
-            vehicle->open(portList->currentText(), config->isChecked());
+            QMetaObject::invokeMethod(vehicle, "open",
+                                      Q_ARG(QString, portList->currentText()),
+                                      Q_ARG(bool, config->isChecked()));
+    }
         break;
     case Vehicle::CONNECTED:
     case Vehicle::CONNECTING:
         // Otherwise we should disconnect / cancel connection attempt.
-        vehicle->close();
+        QMetaObject::invokeMethod(vehicle, "close");
         break;
     default:
         break;
@@ -192,10 +234,29 @@ void ConfigWidget::connectClicked()
 
 void ConfigWidget::enumerate()
 {
+    // Stop as soon as the selected vehicle answers again.
+    QList<quint64> wanted;
+    if (vehicleList->count() > 0)
+        wanted.append(vehicleList->currentText().toULongLong(0, 16));
     // Clear entries between enumerations, even if the Vehicles available are
-    // the same their channels may be different.
+    // the same their channels may be different. The known ones are listed
+    // again at their last channel and updated as they answer.
     vehicleList->clear();
-    vehicle->enumerate(portList->currentText());
+    listKnownVehicles();
+    // The selected port is used even if it does not look like a XBee module.
+    QStringList ports = VehicleEnumerator::xbeePorts();
+    if (!ports.contains(portList->currentText()))
+        ports.append(portList->currentText());
+    if (enumerator->start(ports, wanted))
+        onVehicleStateChanged(Vehicle::ENUM);
+    else
+        QMetaObject::invokeMethod(vehicle, "enumerate",
+                                  Q_ARG(QString, portList->currentText()));
+}
+
+void ConfigWidget::enumerationFinished()
+{
+    onVehicleStateChanged(Vehicle::IDLE);
 }
 
 void ConfigWidget::joystickToggled(bool toggled)
@@ -216,14 +277,25 @@ void ConfigWidget::onVehicleFound(uint64_t vehicleMac, uint8_t channel)
     // for the display text and the ZigBee channel for data, unless that
     // vehicle already exists.
     QString mac = QString::number(vehicleMac, 16).toUpper();
-    for (int i = 0; i < vehicleList->count(); i++)
-        if (vehicleList->itemText(i) == mac)
+    for (int i = 0; i < vehicleList->count(); i++) {
+        if (vehicleList->itemText(i) == mac) {
+            vehicleList->setItemData(i, channel);
             return;
+        }
+    }
     vehicleList->addItem(mac, channel);
 }
 
+void ConfigWidget::listKnownVehicles()
+{
+    ChannelCache &cache = enumerator->channelCache();
+    foreach (quint64 mac, cache.vehicles())
+        onVehicleFound(mac, cache.channel(mac));
+}
+
 void ConfigWidget::onVehicleStateChanged(Vehicle::VehicleState state)
 {
+    vehicleState = state;
     // Config-only and ZigBee mode cannot be altered if connecting/connected.
     config->setEnabled(!joystick->isChecked() &&
                        (state == Vehicle::IDLE || state == Vehicle::ENUM));
@@ -255,7 +327,16 @@ void ConfigWidget::onVehicleStateChanged(Vehicle::VehicleState state)
         status->setText("CONNECTING");
     } else {
         acquire->setText("Disconnect");
-        status->setText("CONNECTED");
+        // Reconnecting to a known vehicle should take well under 500 ms.
+        status->setText(QString("CONNECTED in %1 ms")
+                        .arg(connectClock.elapsed()));
+        qDebug() << "Connected in" << connectClock.elapsed() << "ms";
+        // Remember where the vehicle was found for the next connection.
+        if (zigbee->isChecked() && vehicleList->count() > 0)
+            enumerator->channelCache().record(
+                        vehicleList->currentText().toULongLong(0, 16),
+                        vehicleList->itemData(
+                            vehicleList->currentIndex()).toUInt());
     }
     emit connected(state == Vehicle::CONNECTED);
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <QElapsedTimer>
 #include <QHostAddress>
 #include <QWidget>
 #include "com/vehicle.h"
@@ -7,9 +8,12 @@ class QCheckBox;
 class QComboBox;
 class QLabel;
 class QPushButton;
+class QThread;
 class ControlWidget;
 class MonitorWidget;
 class TelemetryWidget;
+class VehicleEnumerator;
+class VehicleRelay;
 
 /// GUI element to allow selection of serial port, initiate vehicle
 /// enumeration, select target vehicle, configure connection and
@@ -24,7 +28,14 @@ class ConfigWidget : public QWidget
     Q_OBJECT
 public:
     /// Constructor.
-    explicit ConfigWidget(QHostAddress hostAddress = QHostAddress::Null, quint16 hostUdp = 0, QWidget *parent = 0);
+    /// @param hostAddress Address of host running Dragan View, if any.
+    /// @param hostUdp UDP port on host to use.
+    /// @param threaded if true the Vehicle runs on its own thread.
+    /// @param parent Owning widget.
+    explicit ConfigWidget(QHostAddress hostAddress = QHostAddress::Null, quint16 hostUdp = 0, bool threaded = false, QWidget *parent = 0);
+
+    /// Destructor.
+    ~ConfigWidget();
 
 signals:
     /// Emitted for changes to connection state.
@@ -37,6 +48,9 @@ protected:
     /// Determines whether to connect in config-only mode.
     QCheckBox *config;
 
+    /// Started when a connection is requested, to report how long it took.
+    QElapsedTimer connectClock;
+
     /// Enabled once CONNECTED and not at all in config-only mode.
     /// Except when joystick is enabled this is always enabled to allow
     /// selection and mapping joystick before connection.
@@ -45,6 +59,9 @@ protected:
     /// Instruct Vehicle class to send command to enter bypass-mode.
     QPushButton *enterBypass;
 
+    /// Scans for vehicles with every XBee module attached at once.
+    VehicleEnumerator *enumerator;
+
     /// Address of network host when connecting through Dragan View.
     QHostAddress hostAddress;
 
@@ -63,6 +80,9 @@ protected:
     /// Stores and displays a list of all available serial ports.
     QComboBox *portList;
 
+    /// Hands Vehicle output over to the GUI thread when threaded, else null.
+    VehicleRelay *relay;
+
     /// Refresh the list of available serial ports.
     QPushButton *scanPorts;
 
@@ -85,6 +105,16 @@ protected:
     /// Stores and displays a list of all discovered vehicles.
     QComboBox *vehicleList;
 
+    /// Last state reported by Vehicle::stateChanged().
+    ///
+    /// Kept here rather than asking the Vehicle, which may live on another
+    /// thread.
+    Vehicle::VehicleState vehicleState;
+
+    /// Thread the Vehicle runs on when threaded, else null. The Vehicle is
+    /// deleted there when the thread finishes.
+    QThread *vehicleThread;
+
     /// Checkbox which when checked enables communication over a XBee module.
     QCheckBox *zigbee;
 
@@ -100,15 +130,25 @@ protected slots:
     /// Invoked by the 'Connect' button.
     void connectClicked();
 
-    /// Invoked by the 'refresh vehicles' button. Requests enumeration by
-    /// Vehicle using the currently selected serial port.
+    /// Invoked by the 'refresh vehicles' button. Enumerates with every XBee
+    /// module attached, falling back to enumeration by Vehicle using the
+    /// currently selected serial port if none of them can be opened.
     void enumerate();
 
+    /// Invoked by VehicleEnumerator::finished(), restores the controls
+    /// disabled while enumerating.
+    void enumerationFinished();
+
     /// Invoked on change of joystick enabled.
     void joystickToggled(bool toggled);
 
+    /// Add the vehicles in the enumerator's ChannelCache to the list of
+    /// vehicles, at the channel each was last found on, so that a known
+    /// vehicle can be connected to without scanning first.
+    void listKnownVehicles();
+
     /// Invoked by Vehicle::vehicleFound for every response. If the vehicle
-    /// doesn't exist already it is added.
+    /// doesn't exist already it is added, else its channel is updated.
     void onVehicleFound(uint64_t vehicleMac, uint8_t channel);
 
     /// Invoked by Vehicle::stateChanged() for every state change. Used to
@@ -0,0 +1,182 @@
+#include "framecache.h"
+#include <QtEndian>
+#include "com/vehicle.h"
+
+namespace {
+/// Append a field to a frame's breakdown, if there is room and it is not
+/// empty.
+void addField(FrameCache::Frame &frame, char const *name, int offset,
+              int length)
+{
+    if (length <= 0 || frame.fieldCount >= FrameCache::MaxFields)
+        return;
+    FrameCache::Field &field = frame.fields[frame.fieldCount++];
+    field.name = name;
+    field.offset = offset;
+    field.length = length;
+}
+}
+
+QByteArray FrameCache::Frame::bytes(bool decrypting, bool stripping) const
+{
+    int length = 0;
+    unsigned char const *first = data(decrypting, stripping, &length);
+    return QByteArray((char const *)first, length);
+}
+
+unsigned char const *FrameCache::Frame::data(bool decrypting, bool stripping,
+                                             int *length) const
+{
+    QByteArray const &frame = decrypting? decrypted : raw;
+    *length = stripping? stripLength : frame.length();
+    return (unsigned char const *)frame.constData() +
+            (stripping? stripStart : 0);
+}
+
+FrameCache::FrameCache() :
+    frames(Capacity)
+{
+    for (int i = 0; i < Capacity; i++) {
+        frames[i].fieldCount = 0;
+        frames[i].index = -1;
+        frames[i].stripLength = 0;
+        frames[i].stripStart = 0;
+    }
+}
+
+void FrameCache::decode(QByteArray const &message, Frame &frame)
+{
+    frame.raw = message;
+    frame.decrypted = decryptMessage(message);
+    frame.stripLength = message.length();
+    frame.stripStart = strip((unsigned char const *)message.constData(),
+                             frame.stripLength);
+    frame.types[0] = typeOf(message, false);
+    frame.types[1] = typeOf(frame.decrypted, true);
+    parse(frame);
+}
+
+QByteArray FrameCache::decryptMessage(QByteArray message)
+{
+    int configStart = message.indexOf((char)0xFFU);
+    if (configStart >= 0 && message.length() - configStart >= 6) {
+        quint16 length = qFromBigEndian<quint16>(
+                    (unsigned char const *)message.constData() +
+                    configStart + 2);
+        if (configStart + length + 6 <= message.length() &&
+                message.at(configStart + 1) != 0x6) {
+            Vehicle::decrypt((unsigned char const *)message.constData(),
+                             (unsigned char *)message.data(),
+                             teaKey, configStart + 4, length);
+        }
+    }
+    return message;
+}
+
+FrameCache::Frame const *FrameCache::find(qint64 index) const
+{
+    Frame const &frame = frames[index % Capacity];
+    return frame.index == index? &frame : 0;
+}
+
+FrameCache::Frame const &FrameCache::insert(qint64 index,
+                                            QByteArray const &message)
+{
+    Frame &frame = frames[index % Capacity];
+    frame.index = index;
+    decode(message, frame);
+    return frame;
+}
+
+void FrameCache::parse(Frame &frame)
+{
+    unsigned char const *data =
+            (unsigned char const *)frame.decrypted.constData();
+    int length = frame.decrypted.length();
+    int end = length;
+    int next = 0;
+    frame.fieldCount = 0;
+    if (length > 4 && data[0] == 0x7EU) {
+        addField(frame, "Delimiter", 0, 1);
+        addField(frame, "Length", 1, 2);
+        addField(frame, "API ID", 3, 1);
+        end = length - 1;
+        next = 4;
+        if (end >= 14 && data[3] == 0x80U) { // Receive, 64-bit address
+            addField(frame, "Source", 4, 8);
+            addField(frame, "RSSI", 12, 1);
+            addField(frame, "Options", 13, 1);
+            next = 14;
+        } else if (end >= 14 && data[3] == 0x0U) { // Transmit, 64-bit
+            addField(frame, "Frame ID", 4, 1);
+            addField(frame, "Destination", 5, 8);
+            addField(frame, "Options", 13, 1);
+            next = 14;
+        }
+    }
+    if (next + 6 <= end && data[next] == 0xFFU) {
+        int configLength = qFromBigEndian<quint16>(data + next + 2);
+        if (configLength >= 2 && next + configLength + 6 <= end) {
+            addField(frame, "Marker", next, 1);
+            addField(frame, "Type", next + 1, 1);
+            addField(frame, "Length", next + 2, 2);
+            addField(frame, "Sub type", next + 4, 1);
+            addField(frame, "Mode", next + 5, 1);
+            addField(frame, "Payload", next + 6, configLength - 2);
+            addField(frame, "CRC", next + configLength + 4, 2);
+            next += configLength + 6;
+        }
+    }
+    addField(frame, "Data", next, end - next);
+    if (end < length)
+        addField(frame, "Checksum", end, 1);
+}
+
+int FrameCache::strip(unsigned char const *data, int &length)
+{
+    int start = 0;
+    if (length > 4 && data[start] == 0x7EU) {
+        start += 3;
+        length -= 4;
+    }
+    if (length > 11 && (data[start] == 0x0U || data[start] == 0x80U)) {
+        start += 11;
+        length -= 11;
+    }
+    if (length > 3 && data[start] == 0xFFU) {
+        start += 1;
+        length -= 3;
+    }
+    return start;
+}
+
+QByteArray FrameCache::stripMessage(QByteArray message)
+{
+    int length = message.length();
+    int start = strip((unsigned char const *)message.constData(), length);
+    return message.mid(start, length);
+}
+
+QString FrameCache::typeOf(QByteArray const &message, bool decrypted)
+{
+    unsigned char const *data = (unsigned char const *)message.constData();
+    int length = message.length();
+    QString type;
+    int configStart = 0;
+    if (length > 3 && data[0] == 0x7EU) {
+        type = "XBee " + QString::number(data[3], 16).rightJustified(2, '0')
+                .toUpper();
+        configStart = (data[3] == 0x0U || data[3] == 0x80U)? 14 : length;
+    }
+    if (configStart + 4 < length && data[configStart] == 0xFFU) {
+        if (!type.isEmpty())
+            type += ' ';
+        type += QString::number(data[configStart + 1]);
+        // Sub types are encrypted along with the payload, except for 6.
+        if (decrypted || data[configStart + 1] == 6)
+            type += '.' + QString::number(data[configStart + 4]);
+    } else if (type.isEmpty() && length > 0) {
+        type = QString::number(data[0]);
+    }
+    return type;
+}
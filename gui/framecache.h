@@ -0,0 +1,119 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/// Decoded views of recently displayed messages, keyed by message index.
+///
+/// Decoding a message decrypts it once and works out where its wrappers
+/// end, its type and a breakdown of its fields, so that every combination
+/// of the monitor's Decrypt and Strip wrappers options can be shown without
+/// decoding or copying it again.<BR>
+/// Direct mapped: a message goes in slot index % Capacity, replacing
+/// whatever was there. Frames are decoded when first asked for, as a view
+/// only asks for the few rows it shows.<BR>
+/// Not thread safe, the caller serializes access.
+class FrameCache
+{
+public:
+    /// Sizes.
+    enum {
+        Capacity = 1 << 14,  ///< Frames kept.
+        MaxFields = 12       ///< Most fields broken down per frame.
+    };
+
+    /// A field of a frame.
+    struct Field
+    {
+        char const *name;  ///< What the field holds.
+        quint16 offset;    ///< First byte of the field in the frame.
+        quint16 length;    ///< Bytes in the field.
+    };
+
+    /// A decoded frame.
+    struct Frame
+    {
+        /// Get a copy of the bytes to display.
+        /// @param decrypting true for the decrypted frame.
+        /// @param stripping true to leave out the zigbee and config headers.
+        QByteArray bytes(bool decrypting,
+                         bool stripping) const;
+
+        /// Get the bytes to display without copying them.
+        /// @return first byte, valid as long as the frame is.
+        /// @param decrypting true for the decrypted frame.
+        /// @param stripping true to leave out the zigbee and config headers.
+        /// @param length set to the number of bytes.
+        unsigned char const *data(bool decrypting,
+                                  bool stripping,
+                                  int *length) const;
+
+        QByteArray decrypted;     ///< Frame with any encrypted portion
+                                  ///< decrypted.
+        int fieldCount;           ///< Valid entries of fields.
+        Field fields[MaxFields];  ///< Fields, in frame order.
+        qint64 index;             ///< Message index, -1 if empty.
+        QByteArray raw;           ///< Frame as sent or received.
+        int stripLength;          ///< Length with wrappers stripped.
+        int stripStart;           ///< Start with wrappers stripped.
+        QString types[2];         ///< typeOf() the raw and decrypted frame.
+    };
+
+    /// Constructor.
+    FrameCache();
+
+    /// Decode a frame, see decryptMessage(), stripMessage() and typeOf().
+    /// @param message frame to decode.
+    /// @param frame receives the decoded frame, its index is left as is.
+    static void decode(QByteArray const &message,
+                       Frame &frame);
+
+    /// Decrypt the encrypted portion of a message.
+    ///
+    /// If message is not recognized as an encrypted type the original message
+    /// will be returned.
+    /// @return message with any present encrypted portion decrypted.
+    /// @param message Message to decrypt.
+    static QByteArray decryptMessage(QByteArray message);
+
+    /// Find a decoded frame.
+    /// @return the frame, valid until the next insert(), null if not
+    /// cached.
+    /// @param index message index.
+    Frame const *find(qint64 index) const;
+
+    /// Decode a frame and keep it.
+    /// @return the frame, valid until the next insert().
+    /// @param index message index.
+    /// @param message frame to decode.
+    Frame const &insert(qint64 index,
+                        QByteArray const &message);
+
+    /// Strip zigbee and config message headers
+    /// @return message with any wrappers stripped.
+    /// @param message Message to strip.
+    static QByteArray stripMessage(QByteArray message);
+
+    /// Describe the kind of a message.
+    /// @return XBee API frame type and config message type, with the sub
+    /// type if it can be read.
+    /// @param message Message to describe, unstripped.
+    /// @param decrypted true if message has been decrypted.
+    static QString typeOf(QByteArray const &message,
+                          bool decrypted);
+
+protected:
+    /// Break a frame down into fields.
+    static void parse(Frame &frame);
+
+    /// Find where the zigbee and config message headers end.
+    /// @return offset of the first byte after the wrappers.
+    /// @param data first byte of the frame.
+    /// @param length length of the frame, set to the length without
+    /// wrappers.
+    static int strip(unsigned char const *data,
+                     int &length);
+
+    /// Capacity slots.
+    QVector<Frame> frames;
+};
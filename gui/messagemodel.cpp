@@ -0,0 +1,248 @@
+#include "messagemodel.h"
+#include <QFont>
+#include <QMutexLocker>
+#include "com/hexformat.h"
+
+MessageModel::MessageModel(QObject *parent) :
+    QAbstractTableModel(parent), appended(0), cache(), clock(),
+    decrypting(false), history(), mutex(), refreshed(0), rows(Rows),
+    shown(0), started(QDateTime::currentDateTime()), stripping(false)
+{
+    clock.start();
+}
+
+void MessageModel::append(QByteArray const &message, bool incoming)
+{
+    QMutexLocker locker(&mutex);
+    Row &row = rows[appended % Rows];
+    row.index = history.count(incoming);
+    row.incoming = incoming;
+    row.time = clock.elapsed();
+    history.append(message, incoming);
+    appended++;
+}
+
+int MessageModel::columnCount(QModelIndex const &parent) const
+{
+    return parent.isValid()? 0 : Columns;
+}
+
+int MessageModel::count(bool incoming) const
+{
+    QMutexLocker locker(&mutex);
+    return history.count(incoming);
+}
+
+QVariant MessageModel::data(QModelIndex const &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+    if (role == Qt::TextAlignmentRole && index.column() == Length)
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+    if (role == Qt::FontRole && index.column() == Summary)
+        return QFont("Courier");
+    if (role != Qt::DisplayRole)
+        return QVariant();
+    if (index.column() < Type) {
+        QMutexLocker locker(&mutex);
+        int slot = slotOf(index.row());
+        if (slot < 0)
+            return QVariant();
+        Row const &row = rows[slot];
+        if (index.column() == Direction)
+            return QString(row.incoming? "In" : "Out");
+        return started.addMSecs(row.time).time().toString("hh:mm:ss.zzz");
+    }
+    FrameCache::Frame const *decoded = frame(index.row());
+    if (!decoded)
+        return QVariant();
+    if (index.column() == Length)
+        return decoded->raw.length();
+    if (index.column() == Type)
+        return decoded->types[decrypting];
+    int length = 0;
+    unsigned char const *data = decoded->data(decrypting, stripping, &length);
+    int bytes = qMin<int>(length, SummaryBytes);
+    QByteArray hex(HexFormat::length(bytes, true), 0);
+    HexFormat::format(data, bytes, hex.data(), true);
+    if (bytes < length)
+        hex.append(" ...");
+    return QString::fromLatin1(hex.constData(), hex.length());
+}
+
+void MessageModel::decodeBlock(int first) const
+{
+    int last = qMin(first + Block, shown);
+    QByteArray messages[Block];
+    Row wanted[Block];
+    bool logged[Block];
+    MessageHistory::Run runs[2];
+    {
+        QMutexLocker locker(&mutex);
+        int lowest[2] = { -1, -1 };
+        int highest[2] = { -1, -1 };
+        for (int row = first; row < last; row++) {
+            int slot = slotOf(row);
+            logged[row - first] = false;
+            if (slot < 0 || cache.find(refreshed - shown + row))
+                continue;
+            Row const &entry = rows[slot];
+            wanted[row - first] = entry;
+            if (history.isInMemory(entry.index, entry.incoming)) {
+                messages[row - first] = history.at(entry.index,
+                                                   entry.incoming);
+                continue;
+            }
+            logged[row - first] = true;
+            int &low = lowest[entry.incoming];
+            if (low < 0 || (int)entry.index < low)
+                low = entry.index;
+            highest[entry.incoming] = qMax<int>(highest[entry.incoming],
+                                                entry.index);
+        }
+        for (int incoming = 0; incoming < 2; incoming++)
+            if (lowest[incoming] >= 0)
+                runs[incoming] = history.locate(
+                            lowest[incoming],
+                            highest[incoming] - lowest[incoming] + 1,
+                            incoming);
+    }
+    // The log is read without the lock, so that append() need not wait.
+    QVector<QByteArray> old[2];
+    for (int incoming = 0; incoming < 2; incoming++) {
+        old[incoming].resize(runs[incoming].count);
+        if (runs[incoming].count > 0)
+            history.read(runs[incoming], old[incoming].data());
+    }
+    for (int row = first; row < last; row++) {
+        Row const &entry = wanted[row - first];
+        if (logged[row - first]) {
+            MessageHistory::Run const &run = runs[entry.incoming];
+            messages[row - first] = old[entry.incoming].value(
+                        entry.index - run.first);
+        }
+        if (!messages[row - first].isNull())
+            cache.insert(refreshed - shown + row, messages[row - first]);
+    }
+}
+
+FrameCache::Frame const *MessageModel::frame(int row) const
+{
+    qint64 message = refreshed - shown + row;
+    {
+        QMutexLocker locker(&mutex);
+        if (slotOf(row) < 0)
+            return 0;
+    }
+    if (FrameCache::Frame const *cached = cache.find(message))
+        return cached;
+    decodeBlock(row - row % Block);
+    return cache.find(message);
+}
+
+QVariant MessageModel::headerData(int section, Qt::Orientation orientation,
+                                  int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+    switch (section) {
+    case Time:
+        return QString("Time");
+    case Direction:
+        return QString("Dir");
+    case Type:
+        return QString("Type");
+    case Length:
+        return QString("Length");
+    case Summary:
+        return QString("Data");
+    default:
+        return QVariant();
+    }
+}
+
+QByteArray MessageModel::message(int index, bool incoming) const
+{
+    MessageHistory::Run run;
+    {
+        QMutexLocker locker(&mutex);
+        if (index < 0 || index >= history.count(incoming))
+            return QByteArray();
+        if (history.isInMemory(index, incoming))
+            return history.at(index, incoming);
+        run = history.locate(index, 1, incoming);
+    }
+    QByteArray message;
+    history.read(run, &message);
+    return message;
+}
+
+bool MessageModel::open(QString const &path)
+{
+    QMutexLocker locker(&mutex);
+    return history.open(path);
+}
+
+bool MessageModel::refresh()
+{
+    qint64 total;
+    {
+        QMutexLocker locker(&mutex);
+        total = appended;
+    }
+    qint64 added = total - refreshed;
+    if (added == 0)
+        return false;
+    if (added >= Rows) {
+        beginResetModel();
+        refreshed = total;
+        shown = Rows;
+        endResetModel();
+        return true;
+    }
+    // Drop what the ring is about to overwrite before listing the new rows.
+    int removed = qMax<qint64>(shown + added - Rows, 0);
+    if (removed > 0) {
+        beginRemoveRows(QModelIndex(), 0, removed - 1);
+        shown -= removed;
+        endRemoveRows();
+    }
+    beginInsertRows(QModelIndex(), shown, shown + added - 1);
+    refreshed = total;
+    shown += added;
+    endInsertRows();
+    return true;
+}
+
+int MessageModel::rowCount(QModelIndex const &parent) const
+{
+    return parent.isValid()? 0 : shown;
+}
+
+void MessageModel::setDecrypt(bool decrypt)
+{
+    if (decrypting == decrypt)
+        return;
+    decrypting = decrypt;
+    if (shown > 0)
+        emit dataChanged(index(0, Type), index(shown - 1, Summary));
+}
+
+void MessageModel::setStrip(bool strip)
+{
+    if (stripping == strip)
+        return;
+    stripping = strip;
+    if (shown > 0)
+        emit dataChanged(index(0, Summary), index(shown - 1, Summary));
+}
+
+int MessageModel::slotOf(int row) const
+{
+    if (row < 0 || row >= shown)
+        return -1;
+    qint64 absolute = refreshed - shown + row;
+    if (absolute < appended - Rows)
+        return -1;
+    return absolute % Rows;
+}
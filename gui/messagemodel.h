@@ -0,0 +1,165 @@
+#pragma once
+#include <QAbstractTableModel>
+#include <QByteArray>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVector>
+#include "com/messagehistory.h"
+#include "framecache.h"
+
+/// Table of the messages sent and received, one row per frame, for a view
+/// which only asks for the rows it shows.
+///
+/// append() only records the message, from any thread. The rows appear in
+/// the model when refresh() is called, which the view's owner does at about
+/// display rate, so a burst of frames costs one insertion rather than one
+/// per frame. Messages are decoded when the view first asks for them and
+/// kept in a FrameCache, so toggling the display options or scrolling back
+/// does not decode them again. A miss decodes the whole Block of rows
+/// around it, reading those no longer in memory back from the log in one
+/// pass per direction, without holding up append().<BR>
+/// The most recent Rows frames are listed, older ones drop off the top but
+/// remain in the log, see MessageHistory, and can still be fetched by their
+/// index in a direction with message().
+class MessageModel : public QAbstractTableModel
+{
+public:
+    /// Columns.
+    enum Column {
+        Time,       ///< Wall-clock time the message was seen.
+        Direction,  ///< In or Out.
+        Type,       ///< XBee API frame and config message type.
+        Length,     ///< Bytes on the wire.
+        Summary,    ///< Leading bytes in hex, after decrypt and strip.
+        Columns     ///< Number of columns.
+    };
+
+    /// Sizes.
+    enum {
+        Block = 256,      ///< Rows decoded together on a cache miss.
+        Rows = 1 << 18,   ///< Most recent frames listed.
+        SummaryBytes = 24 ///< Bytes shown in the Summary column.
+    };
+
+    /// Constructor.
+    explicit MessageModel(QObject *parent = 0);
+
+    /// Record a message, from any thread. It is listed from the next
+    /// refresh() on.
+    /// @param message message sent or received.
+    /// @param incoming true if the message was received.
+    void append(QByteArray const &message,
+                bool incoming);
+
+    /// Reimplemented from QAbstractItemModel.
+    int columnCount(QModelIndex const &parent = QModelIndex()) const;
+
+    /// Get the number of messages recorded.
+    /// @param incoming true for received messages.
+    int count(bool incoming) const;
+
+    /// Reimplemented from QAbstractItemModel.
+    QVariant data(QModelIndex const &index,
+                  int role = Qt::DisplayRole) const;
+
+    /// Get the decoded message of a row, decoding it if not cached.
+    ///
+    /// Show it with isDecrypting() and isStripping(), see
+    /// FrameCache::Frame::data().
+    /// @return the frame, valid until the model decodes another, null if
+    /// no longer available.
+    /// @param row row of the message.
+    FrameCache::Frame const *frame(int row) const;
+
+    /// Reimplemented from QAbstractItemModel.
+    QVariant headerData(int section,
+                        Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const;
+
+    /// Check whether messages are shown decrypted.
+    bool isDecrypting() const { return decrypting; }
+
+    /// Check whether messages are shown stripped.
+    bool isStripping() const { return stripping; }
+
+    /// Get a message by its index in a direction, listed or not.
+    ///
+    /// Reads it back from the log if it is no longer in memory, without
+    /// holding up append().
+    /// @return the message, null if out of range or not available, see
+    /// MessageHistory.
+    /// @param index 0 for the first message of the session in this
+    /// direction.
+    /// @param incoming true for received messages.
+    QByteArray message(int index,
+                       bool incoming) const;
+
+    /// Start logging to a file, see MessageHistory::open().
+    bool open(QString const &path);
+
+    /// List the messages recorded since the last call, in the GUI thread.
+    /// @return true if rows were added.
+    bool refresh();
+
+    /// Reimplemented from QAbstractItemModel.
+    int rowCount(QModelIndex const &parent = QModelIndex()) const;
+
+    /// Show messages decrypted.
+    void setDecrypt(bool decrypt);
+
+    /// Show messages with zigbee and config headers stripped.
+    void setStrip(bool strip);
+
+protected:
+    /// A listed message.
+    struct Row
+    {
+        quint32 index;  ///< Index in MessageHistory.
+        bool incoming;  ///< Direction.
+        quint32 time;   ///< When it was appended, in ms since construction.
+    };
+
+    /// Decode the rows of a Block which are not cached yet.
+    /// @param first first row of the block.
+    void decodeBlock(int first) const;
+
+    /// Find the message of a row.
+    /// @return slot in rows, -1 if it has since been overwritten.
+    /// Called with mutex held.
+    int slotOf(int row) const;
+
+    /// Messages recorded so far.
+    qint64 appended;
+
+    /// Decoded messages by index, filled as the view asks for them.
+    mutable FrameCache cache;
+
+    /// Monotonic clock started at construction.
+    QElapsedTimer clock;
+
+    /// Show messages decrypted.
+    bool decrypting;
+
+    /// All messages, recent ones in memory and the rest in the log.
+    /// Mutable as MessageHistory::at() may read back from the log.
+    mutable MessageHistory history;
+
+    /// Guards appended, history and rows from append() in other threads.
+    mutable QMutex mutex;
+
+    /// Value of appended at the last refresh().
+    qint64 refreshed;
+
+    /// The last Rows messages, by appended modulo Rows.
+    QVector<Row> rows;
+
+    /// Number of rows listed.
+    int shown;
+
+    /// Wall-clock time at construction.
+    QDateTime started;
+
+    /// Show messages stripped.
+    bool stripping;
+};
@@ -1,35 +1,39 @@
 #include "monitorwidget.h"
-#include <QtCore>
-#include <QtEndian>
 #include <QCheckBox>
+#include <QComboBox>
 #include <QDateTime>
 #include <QDesktopServices>
 #include <QDir>
-#include <QFile>
-#include <QGridLayout>
 #include <QHBoxLayout>
+#include <QHeaderView>
+#include <QItemSelectionModel>
 #include <QLabel>
+#include <QPushButton>
+#include <QScrollBar>
 #include <QSpinBox>
+#include <QTableView>
 #include <QTextEdit>
-#include "com/vehicle.h"
+#include <QTimer>
+#include <QVBoxLayout>
+#include "com/hexformat.h"
+#include "messagemodel.h"
+
+QByteArray MonitorWidget::hexText;
 
 MonitorWidget::MonitorWidget(QWidget *parent) :
     QWidget(parent),
+    counts(new QLabel("In 0, out 0", this)),
     decrypt(new QCheckBox("Decrypt", this)),
-    incomingCount(0),
-    incomingCountL(new QLabel("/ 0", this)),
-    incomingData(new QTextEdit(this)),
-    incomingIndex(new QSpinBox(this)),
-    incomingMessages(),
-    infile(new QFile(this)),
-    mutex(),
-    outfile(new QFile(this)),
-    outgoingCount(0),
-    outgoingCountL(new QLabel("/ 0", this)),
-    outgoingData(new QTextEdit(this)),
-    outgoingIndex(new QSpinBox(this)),
-    outgoingMessages(),
-    stripWrappers(new QCheckBox("Strip wrappers", this))
+    detail(new QTextEdit(this)),
+    model(new MessageModel(this)),
+    older(),
+    olderButton(new QPushButton("Show", this)),
+    olderDirection(new QComboBox(this)),
+    olderIndex(new QSpinBox(this)),
+    olderShown(false),
+    refreshTimer(new QTimer(this)),
+    stripWrappers(new QCheckBox("Strip wrappers", this)),
+    table(new QTableView(this))
 {
     QDir logFolder(QDesktopServices::storageLocation(
                         QDesktopServices::DocumentsLocation));
@@ -38,164 +42,142 @@ MonitorWidget::MonitorWidget(QWidget *parent) :
     logFolder.cd("logs");
     QString timestamp = QString::number(
                 QDateTime::currentDateTime().toTime_t());
-    infile->setFileName(logFolder.absoluteFilePath(
-                            "incoming_" + timestamp + ".log"));
-    outfile->setFileName(logFolder.absoluteFilePath(
-                             "outgoing_" + timestamp + ".log"));
-    if (!infile->open(QFile::ReadWrite | QFile::Truncate)) {
-        delete infile;
-        infile = 0;
-    }
-    if (!outfile->open(QFile::ReadWrite | QFile::Truncate)) {
-        delete outfile;
-        outfile = 0;
-    }
+    // logconvert turns this into the incoming_ and outgoing_ text logs
+    // written by earlier versions.
+    model->open(logFolder.absoluteFilePath("traffic_" + timestamp + ".dftl"));
 
-    incomingIndex->setRange(0, 0);
-    outgoingIndex->setRange(0, 0);
-    incomingCountL->setFixedWidth(100);
-    outgoingCountL->setFixedWidth(100);
-    incomingData->setReadOnly(true);
-    outgoingData->setReadOnly(true);
-    incomingData->setFontFamily("Courier");
-    outgoingData->setFontFamily("Courier");
+    table->setModel(model);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setSelectionMode(QAbstractItemView::SingleSelection);
+    table->setShowGrid(false);
+    table->setWordWrap(false);
+    // Fixed row heights let the view place any row without measuring the
+    // ones before it.
+    table->verticalHeader()->hide();
+    table->verticalHeader()->setResizeMode(QHeaderView::Fixed);
+    table->verticalHeader()->setDefaultSectionSize(
+                table->fontMetrics().height() + 4);
+    table->horizontalHeader()->setStretchLastSection(true);
+    int digit = table->fontMetrics().width('0');
+    table->setColumnWidth(MessageModel::Time, 14 * digit);
+    table->setColumnWidth(MessageModel::Direction, 5 * digit);
+    table->setColumnWidth(MessageModel::Type, 12 * digit);
+    table->setColumnWidth(MessageModel::Length, 7 * digit);
+    detail->setReadOnly(true);
+    detail->setFontFamily("Courier");
+    detail->setMaximumHeight(10 * detail->fontMetrics().lineSpacing());
+    olderDirection->addItem("In");
+    olderDirection->addItem("Out");
+    olderIndex->setPrefix("#");
+    olderIndex->setMaximum(0);
 
-    QGridLayout *layout = new QGridLayout(this);
-    layout->setColumnStretch(0, 1);
-    layout->setColumnStretch(4, 1);
-    layout->addWidget(new QLabel("Incoming", this), 0, 0);
-    layout->addWidget(incomingIndex, 0, 1);
-    layout->addWidget(incomingCountL, 0, 2);
-    layout->addWidget(incomingData, 1, 0, 1, 3);
-    layout->addWidget(new QLabel("Outgoing", this), 0, 4);
-    layout->addWidget(outgoingIndex, 0, 5);
-    layout->addWidget(outgoingCountL, 0, 6);
-    layout->addWidget(outgoingData, 1, 4, 1, 3);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(table, 1);
+    layout->addWidget(detail);
     QHBoxLayout *options = new QHBoxLayout();
-    layout->addLayout(options, 2, 0, 1, 7);
+    layout->addLayout(options);
     options->addWidget(decrypt);
     options->addWidget(stripWrappers);
+    options->addStretch(1);
+    options->addWidget(olderDirection);
+    options->addWidget(olderIndex);
+    options->addWidget(olderButton);
+    options->addWidget(counts);
 
-    connect(incomingIndex, SIGNAL(valueChanged(int)),
-            this, SLOT(incomingChanged(int)));
-    connect(outgoingIndex, SIGNAL(valueChanged(int)),
-            this, SLOT(outgoingChanged(int)));
+    connect(table->selectionModel(),
+            SIGNAL(currentRowChanged(QModelIndex,QModelIndex)),
+            this, SLOT(selectionChanged(QModelIndex)));
     connect(decrypt, SIGNAL(toggled(bool)),
             this, SLOT(decryptChanged(bool)));
     connect(stripWrappers, SIGNAL(toggled(bool)),
             this, SLOT(decryptChanged(bool)));
+    connect(olderButton, SIGNAL(clicked()),
+            this, SLOT(olderRequested()));
+    connect(refreshTimer, SIGNAL(timeout()),
+            this, SLOT(refresh()));
+    refreshTimer->start(Refresh);
 }
 
 void MonitorWidget::decryptChanged(bool decrypt)
 {
-    (void)decrypt;
-    incomingChanged(incomingIndex->value());
-    outgoingChanged(outgoingIndex->value());
+    Q_UNUSED(decrypt)
+    model->setDecrypt(this->decrypt->isChecked());
+    model->setStrip(stripWrappers->isChecked());
+    if (olderShown)
+        showFrame(&older);
+    else
+        selectionChanged(table->currentIndex());
 }
 
-QByteArray MonitorWidget::decryptMessage(QByteArray message)
+void MonitorWidget::olderRequested()
 {
-    int configStart = message.indexOf((char)0xFFU);
-    if (configStart >= 0 && message.length() - configStart >= 6) {
-        quint16 length = qFromBigEndian<quint16>(
-                    (unsigned char const *)message.constData() +
-                    configStart + 2);
-        if (configStart + length + 6 <= message.length() &&
-                message.at(configStart + 1) != 0x6) {
-            Vehicle::decrypt((unsigned char const *)message.constData(),
-                             (unsigned char *)message.data(),
-                             teaKey, configStart + 4, length);
-        }
+    bool incoming = olderDirection->currentIndex() == 0;
+    QByteArray message = model->message(olderIndex->value(), incoming);
+    // Leaves the table without a current row, so that selecting any row
+    // shows it again.
+    table->setCurrentIndex(QModelIndex());
+    if (message.isNull()) {
+        detail->setPlainText(QString("%1 #%2 is not available")
+                             .arg(olderDirection->currentText())
+                             .arg(olderIndex->value()));
+        return;
     }
-    return message;
+    FrameCache::decode(message, older);
+    olderShown = true;
+    showFrame(&older);
 }
 
-void MonitorWidget::incomingChanged(int index)
+void MonitorWidget::onMessage(QByteArray message, bool incoming)
 {
-    QByteArray message = incomingMessages.value(index - 1);
-    if (decrypt->isChecked())
-        message = decryptMessage(message);
-    if (stripWrappers->isChecked())
-        message = stripMessage(message);
-    QString temp = convertToHex(message);
-    if (incomingData->toPlainText() != temp) {
-        incomingData->setPlainText(temp);
-        incomingData->update();
-    }
+    model->append(message, incoming);
 }
 
-void MonitorWidget::onMessage(QByteArray message, bool incoming)
+void MonitorWidget::refresh()
 {
-    QMutexLocker locker(&mutex);
-    QDateTime current = QDateTime::currentDateTime();
-    QString timestamp = QString::number(current.toTime_t() * 1000 +
-            current.time().msec());
-    timestamp.append(":");
-    if (incoming) {
-        if (infile)
-            infile->write(timestamp.toAscii() +
-                          message.toHex().toUpper() + '\n');
-        incomingCount++;
-        incomingIndex->setMaximum(incomingCount);
-        incomingCountL->setText("/ " + QString::number(incomingCount));
-        incomingMessages.append(message);
-        if (incomingIndex->value() == incomingCount - 1)
-            incomingIndex->setValue(incomingCount);
-    } else {
-        if (outfile)
-            outfile->write(timestamp.toAscii() +
-                           message.toHex().toUpper() + '\n');
-        outgoingCount++;
-        outgoingIndex->setMaximum(outgoingCount);
-        outgoingCountL->setText("/ " + QString::number(outgoingCount));
-        outgoingMessages.append(message);
-        if (outgoingIndex->value() == outgoingCount - 1)
-            outgoingIndex->setValue(outgoingCount);
-    }
+    QScrollBar *scrollBar = table->verticalScrollBar();
+    bool following = scrollBar->value() == scrollBar->maximum();
+    if (!model->refresh())
+        return;
+    counts->setText(QString("In %1, out %2").arg(model->count(true))
+                    .arg(model->count(false)));
+    olderIndex->setMaximum(qMax(model->count(true), model->count(false)) - 1);
+    if (following)
+        table->scrollToBottom();
 }
 
-void MonitorWidget::outgoingChanged(int index)
+void MonitorWidget::selectionChanged(QModelIndex const &current)
 {
-    QByteArray message = outgoingMessages.value(index - 1);
-    if (decrypt->isChecked())
-        message = decryptMessage(message);
-    if (stripWrappers->isChecked())
-        message = stripMessage(message);
-    QString temp = convertToHex(message);
-    if (outgoingData->toPlainText() != temp) {
-        outgoingData->setPlainText(temp);
-        outgoingData->update();
-    }
+    olderShown = false;
+    showFrame(current.isValid()? model->frame(current.row()) : 0);
 }
 
-QByteArray MonitorWidget::stripMessage(QByteArray message)
+void MonitorWidget::showFrame(FrameCache::Frame const *frame)
 {
-    unsigned char const *data = (unsigned char const *)message.constData();
-    int length = message.length();
-    if (data[0] == 0x7EU) {
-        data += 3;
-        length -= 4;
-    }
-    if (data[0] == 0x0U || data[0] == 0x80U) {
-        data += 11;
-        length -= 11;
-    }
-    if (data[0] == 0xFFU) {
-        data += 1;
-        length -= 3;
+    QString text;
+    if (frame) {
+        bool decrypting = model->isDecrypting();
+        int length = 0;
+        unsigned char const *shown = frame->data(decrypting,
+                                                 model->isStripping(),
+                                                 &length);
+        text = convertToHex(shown, length);
+        // The breakdown always covers the whole frame.
+        unsigned char const *bytes = frame->data(decrypting, false, &length);
+        for (int i = 0; i < frame->fieldCount; i++) {
+            FrameCache::Field const &field = frame->fields[i];
+            text += QString("\n%1: ").arg(field.name, -12) +
+                    convertToHex(bytes + field.offset, field.length);
+        }
     }
-    return QByteArray((char const *)data, length);
+    if (detail->toPlainText() != text)
+        detail->setPlainText(text);
 }
 
-QString MonitorWidget::convertToHex(QByteArray message)
+QString MonitorWidget::convertToHex(unsigned char const *data, int length)
 {
-    QByteArray hexBytes = message.toHex().toUpper();
-    QByteArray paddedBytes(qCeil(1.5 * hexBytes.length()) - 1, ' ');
-    char const *src = hexBytes.constData();
-    char *dst = paddedBytes.data();
-    for (int i = 0; i < hexBytes.length() / 2; ++i) {
-        dst[3 * i] = src[2 * i];
-        dst[3 * i + 1] = src[2 * i + 1];
-    }
-    return paddedBytes;
+    int digits = HexFormat::length(length, true);
+    if (hexText.length() < digits)
+        hexText.resize(digits);
+    HexFormat::format(data, length, hexText.data(), true);
+    return QString::fromLatin1(hexText.constData(), digits);
 }
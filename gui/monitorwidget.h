@@ -1,23 +1,41 @@
 #pragma once
 #include <QByteArray>
-#include <QList>
-#include <QMutex>
 #include <QWidget>
+#include "framecache.h"
 
+class MessageModel;
 class QCheckBox;
-class QFile;
+class QComboBox;
 class QLabel;
+class QModelIndex;
+class QPushButton;
 class QSpinBox;
+class QTableView;
 class QTextEdit;
+class QTimer;
 
 /// GUI element to allow inspection of individual messages and history.
 ///
-/// Stores all messages sent and received in a timestamped log file in the
-/// working directory.
+/// Lists every message sent and received in a table, see MessageModel,
+/// and shows the one selected in full below it, followed by a breakdown of
+/// its fields. New messages are added every Refresh ms, and the table
+/// follows them while scrolled to the bottom.<BR>
+/// Stores all messages sent and received in a timestamped binary log, see
+/// TrafficLog, in the logs folder under the user's documents. Only recent
+/// messages are held in memory, older ones are read back from the log when
+/// selected, see MessageHistory.<BR>
+/// The table lists the last MessageModel::Rows messages. Any older message
+/// still indexed by MessageHistory can be shown by its direction and number
+/// instead, the rest only remain in the log file, see logconvert.
 class MonitorWidget : public QWidget
 {
     Q_OBJECT
 public:
+    /// Intervals.
+    enum {
+        Refresh = 16  ///< ms between listing new messages, a display frame.
+    };
+
     /// Constructor.
     explicit MonitorWidget(QWidget *parent = 0);
 
@@ -26,79 +44,70 @@ public slots:
     void onMessage(QByteArray message, bool incoming);
 
 protected:
-    /// Decrypt the encrypted portion of a message.
-    ///
-    /// If message is not recognized as an encrypted type the original message
-    /// will be returned.
-    /// @return message with any present encrypted portion decrypted.
-    /// @param message Message to decrypt.
-    static QByteArray decryptMessage(QByteArray message);
-
-    /// Strip zigbee and config message headers
-    /// @return message with any wrappers stripped.
-    /// @param message Message to strip.
-    static QByteArray stripMessage(QByteArray message);
-
-    /// Convert a QByteArray into a hex QString.
+    /// Convert bytes into a hex QString.
     ///
-    /// @return Hex bytes from message with separator character every spacing bytes.
-    /// @param message Message to convert and pad.
-    /// @param separator Character to use as separator.
-    /// @param spacing Number of bytes that should be grouped together.
-    static QString convertToHex(QByteArray message);
-
-    /// Messages which are encrypted should be decrypted before displaying.
-    QCheckBox *decrypt;
+    /// Formats into hexText, so only the returned string is allocated.
+    /// @return Uppercase hex bytes separated by spaces, see HexFormat.
+    /// @param data first byte to convert.
+    /// @param length number of bytes.
+    static QString convertToHex(unsigned char const *data,
+                                int length);
 
-    /// Keep track of number of messages received.
-    int incomingCount;
+    /// Show a message and the breakdown of its fields in detail.
+    /// @param frame message to show, null to clear.
+    void showFrame(FrameCache::Frame const *frame);
 
-    /// Display incoming message count.
-    QLabel *incomingCountL;
+    /// Display message counts.
+    QLabel *counts;
 
-    /// Display selected incoming message.
-    QTextEdit *incomingData;
-
-    /// Display and allow changing of currently selected incoming message.
-    QSpinBox *incomingIndex;
+    /// Messages which are encrypted should be decrypted before displaying.
+    QCheckBox *decrypt;
 
-    /// The raw data of all incoming messages.
-    QList<QByteArray> incomingMessages;
+    /// Display selected message.
+    QTextEdit *detail;
 
-    /// Incoming message log.
-    QFile *infile;
+    /// Output of convertToHex(), only ever grown. GUI thread only.
+    static QByteArray hexText;
 
-    /// Protect onMessage(...) in case threading is enabled.
-    QMutex mutex;
+    /// All messages sent and received.
+    MessageModel *model;
 
-    /// Outgoing message log.
-    QFile *outfile;
+    /// Message shown by olderRequested().
+    FrameCache::Frame older;
 
-    /// Keep track of number of messages sent.
-    int outgoingCount;
+    /// Shows the message chosen by olderDirection and olderIndex.
+    QPushButton *olderButton;
 
-    /// Display outgoing message count.
-    QLabel *outgoingCountL;
+    /// Direction of the message to show, In or Out.
+    QComboBox *olderDirection;
 
-    /// Display selected outgoing message.
-    QTextEdit *outgoingData;
+    /// Number of the message to show in its direction, from 0.
+    QSpinBox *olderIndex;
 
-    /// Display and allow changing of currently selected outgoing message.
-    QSpinBox *outgoingIndex;
+    /// True while older rather than the selected row is shown.
+    bool olderShown;
 
-    /// The raw data of all outgoing messages.
-    QList<QByteArray> outgoingMessages;
+    /// Lists new messages every Refresh ms.
+    QTimer *refreshTimer;
 
     /// Strip wrappers from messages
     QCheckBox *stripWrappers;
 
+    /// Lists messages, only the visible rows are rendered.
+    QTableView *table;
+
 protected slots:
-    /// Decryption enabled or disabled. Reload currently displayed message.
+    /// Decryption or stripping enabled or disabled. Reload displayed
+    /// messages.
     void decryptChanged(bool decrypt);
 
-    /// Selected incoming message index changed.
-    void incomingChanged(int index);
+    /// Show the message chosen by olderDirection and olderIndex, read back
+    /// from the log if need be.
+    void olderRequested();
+
+    /// List messages received since the last refresh.
+    void refresh();
 
-    /// Selected outgoing message index changed.
-    void outgoingChanged(int index);
+    /// Selected message changed.
+    void selectionChanged(QModelIndex const &current);
 };
@@ -75,61 +75,28 @@ void TelemetryWidget::bypassImu(qint16 gyroX, qint16 gyroY, qint16 gyroZ,
     this->accZ->setNum(accZ);
 }
 
-void TelemetryWidget::telemetry1(float roll, float pitch, float yaw,
-                                 int packetLoss, int rssi,
-                                 unsigned int throttle, float altPre, int magX,
-                                 int magY, int magZ, float velN, float velE,
-                                 float velD, float errN, float errE,
-                                 float errD, float battHeli,
-                                 unsigned int flightTime, int svs,
-                                 int holdMode, int picture, float current)
+void TelemetryWidget::telemetry1(Telemetry1Frame const &frame)
 {
-    (void)packetLoss;
-    (void)rssi;
-    (void)throttle;
-    (void)errN;
-    (void)errE;
-    (void)errD;
-    (void)battHeli;
-    (void)flightTime;
-    (void)svs;
-    (void)holdMode;
-    (void)picture;
-    (void)current;
-    this->roll->setText(QString::number(roll, 'f', 1));
-    this->pitch->setText(QString::number(pitch, 'f', 1));
-    this->heading->setText(QString::number(yaw, 'f', 1));
-    this->alt2->setText(QString::number(altPre, 'f', 1));
-    this->velE->setText(QString::number(velE, 'f', 1));
-    this->velN->setText(QString::number(velN, 'f', 1));
-    this->velD->setText(QString::number(velD, 'f', 1));
-    this->magX->setText(QString::number(magX, 'f', 1));
-    this->magY->setText(QString::number(magY, 'f', 1));
-    this->magZ->setText(QString::number(magZ, 'f', 1));
+    this->roll->setText(QString::number(frame.roll, 'f', 1));
+    this->pitch->setText(QString::number(frame.pitch, 'f', 1));
+    this->heading->setText(QString::number(frame.yaw, 'f', 1));
+    this->alt2->setText(QString::number(frame.altPre, 'f', 1));
+    this->velE->setText(QString::number(frame.velE, 'f', 1));
+    this->velN->setText(QString::number(frame.velN, 'f', 1));
+    this->velD->setText(QString::number(frame.velD, 'f', 1));
+    this->magX->setText(QString::number(frame.magX, 'f', 1));
+    this->magY->setText(QString::number(frame.magY, 'f', 1));
+    this->magZ->setText(QString::number(frame.magZ, 'f', 1));
 }
 
-void TelemetryWidget::telemetry2(float roll, float pitch, float yaw,
-                                 int packetLoss, int rssi,
-                                 unsigned int throttle, float altPre,
-                                 int altGps, double lat, double lng,
-                                 float pdop, float hacc, float vacc,
-                                 int gpsTime, float temperature,
-                                 unsigned int tilt)
+void TelemetryWidget::telemetry2(Telemetry2Frame const &frame)
 {
-    (void)packetLoss;
-    (void)rssi;
-    (void)throttle;
-    (void)hacc;
-    (void)vacc;
-    (void)gpsTime;
-    (void)temperature;
-    (void)tilt;
-    this->roll->setText(QString::number(roll, 'f', 1));
-    this->pitch->setText(QString::number(pitch, 'f', 1));
-    this->heading->setText(QString::number(yaw, 'f', 1));
-    this->alt2->setText(QString::number(altPre, 'f', 1));
-    this->alt->setText(QString::number(altGps, 'f', 1));
-    this->lat->setText(QString::number(lat, 'f', 6));
-    this->lng->setText(QString::number(lng, 'f', 6));
-    this->pdop->setText(QString::number(pdop, 'f', 1));
+    this->roll->setText(QString::number(frame.roll, 'f', 1));
+    this->pitch->setText(QString::number(frame.pitch, 'f', 1));
+    this->heading->setText(QString::number(frame.yaw, 'f', 1));
+    this->alt2->setText(QString::number(frame.altPre, 'f', 1));
+    this->alt->setText(QString::number(frame.altGps, 'f', 1));
+    this->lat->setText(QString::number(frame.lat, 'f', 6));
+    this->lng->setText(QString::number(frame.lng, 'f', 6));
+    this->pdop->setText(QString::number(frame.pdop, 'f', 1));
 }
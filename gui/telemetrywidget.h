@@ -1,5 +1,6 @@
 #pragma once
 #include <QWidget>
+#include "com/telemetry.h"
 
 class QLabel;
 
@@ -18,18 +19,10 @@ public slots:
                    int16_t accX, int16_t accY, int16_t accZ);
 
     /// Bit-packed telemetry message 22.
-    void telemetry1(float roll, float pitch, float yaw, int packetLoss,
-                    int rssi, unsigned int throttle, float altPre, int magX,
-                    int magY, int magZ, float velN, float velE, float velD,
-                    float errN, float errE, float errD, float battHeli,
-                    unsigned int flightTime, int svs, int holdMode,
-                    int picture, float current);
+    void telemetry1(Telemetry1Frame const &frame);
 
     /// Bit-packed telemetry message 23.
-    void telemetry2(float roll, float pitch, float yaw, int packetLoss,
-                    int rssi, unsigned int throttle, float altPre, int altGps,
-                    double lat, double lng, float pdop, float hacc, float vacc,
-                    int gpsTime, float temperature, unsigned int tilt);
+    void telemetry2(Telemetry2Frame const &frame);
 
 protected:
     /// Acceleration in vehicle frame.
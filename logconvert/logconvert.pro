@@ -0,0 +1,17 @@
+TEMPLATE = app
+TARGET = logconvert
+DESTDIR = ../bin/
+CONFIG += console
+CONFIG -= app_bundle
+QT -= gui
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    ../com/hexformat.cpp \
+    ../com/trafficlog.cpp
+
+HEADERS += \
+    ../com/hexformat.h \
+    ../com/trafficlog.h
+
+QMAKE_CXXFLAGS += -pedantic -Werror -Wextra -Wno-long-long
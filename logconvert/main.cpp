@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include "com/trafficlog.h"
+
+/// Convert binary traffic logs to the text logs of earlier versions.
+///
+/// For every traffic_<time>.dftl given, writes incoming_<time>.log and
+/// outgoing_<time>.log next to it.
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    if (args.length() < 2) {
+        fprintf(stderr, "Usage: logconvert traffic_<time>.dftl...\n");
+        return 1;
+    }
+    int status = 0;
+    for (int i = 1; i < args.length(); i++) {
+        QFileInfo log(args[i]);
+        QString time = log.completeBaseName();
+        if (time.startsWith("traffic_"))
+            time.remove(0, 8);
+        QString incoming = log.dir().absoluteFilePath(
+                    "incoming_" + time + ".log");
+        QString outgoing = log.dir().absoluteFilePath(
+                    "outgoing_" + time + ".log");
+        if (!TrafficLog::convert(log.filePath(), incoming, outgoing)) {
+            fprintf(stderr, "Could not convert %s\n",
+                    log.filePath().toLocal8Bit().constData());
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -63,7 +63,8 @@ int main(int argc, char *argv[])
         }
         RemoteClient *c = new RemoteClient();
         c->connect(c, SIGNAL(disconnected()), SLOT(close()));
-        c->setChild(new ConfigWidget(hostAddress, hostUdp));
+        c->setChild(new ConfigWidget(hostAddress, hostUdp,
+                                     args.contains("-t")));
         w = c;
         w->setWindowTitle("Draganflyer API Example");
         qRegisterMetaType<QHostAddress>("QHostAddress");
@@ -87,10 +88,10 @@ int main(int argc, char *argv[])
             if (ok)
                 hostPort = tempPort;
         }
-        w = new ConfigWidget(hostAddress, hostPort);
+        w = new ConfigWidget(hostAddress, hostPort, args.contains("-t"));
     } else {
-        // Default local-only mode.
-        w = new ConfigWidget();
+        // Default local-only mode, -t runs the vehicle on its own thread.
+        w = new ConfigWidget(QHostAddress::Null, 0, args.contains("-t"));
         w->setWindowTitle("Draganflyer API Example");
     }
     w->setAttribute(Qt::WA_DeleteOnClose);